@@ -0,0 +1,87 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <new>
+#include <cstdlib>
+
+#include "lexer.hpp"
+#include "parser/tokenParser.hpp"
+
+/**
+  \file
+  \brief Counts allocations and times walking a large AST, through spans and through Links
+
+  Usage: ast_walk_bench [repetitions]. The code is a few statements repeated (20000 times by
+  default). Exits with 1 if the span walk allocates anything.
+*/
+
+static std::size_t allocations = 0;
+
+void* operator new(std::size_t size) {
+  allocations++;
+  if (void* ptr = std::malloc(size)) return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+static std::string generateCode(int repetitions) {
+  std::string code;
+  for (int i = 0; i < repetitions; i++) {
+    code += "define a" + std::to_string(i) + " = 1 + 2 * (3 - b);\n"
+      "if a do c = d + 1; else do e = f(1, 2); end\n"
+      "for define x = 1; x < 2; x++ do g = h; end\n";
+  }
+  return code;
+}
+
+static void report(const char* name, std::size_t nodes, std::size_t allocs, double seconds) {
+  std::cout << name << ": " << nodes << " nodes, " << allocs << " allocations, "
+    << seconds * 1000 << " ms" << std::endl;
+}
+
+int main(int argc, char** argv) {
+  int repetitions = argc > 1 ? std::stoi(argv[1]) : 20000;
+  AST ast = TokenParser::parse(Lexer::tokenize(generateCode(repetitions), "<ast-walk-bench>")
+    ->getTokenStore());
+
+  std::vector<ASTNode*> stack;
+  stack.reserve(1 << 22);
+  stack.push_back(ast.getRoot().get());
+  std::size_t spanNodes = 0;
+  std::size_t before = allocations;
+  auto start = std::chrono::steady_clock::now();
+  while (!stack.empty()) {
+    ASTNode* node = stack.back();
+    stack.pop_back();
+    spanNodes++;
+    for (auto child : node->getChildSpan()) if (child != nullptr) stack.push_back(child);
+  }
+  std::chrono::duration<double> spanTime = std::chrono::steady_clock::now() - start;
+  std::size_t spanAllocations = allocations - before;
+  report("getChildSpan", spanNodes, spanAllocations, spanTime.count());
+
+  std::vector<ASTNode::Link> linkStack;
+  linkStack.reserve(1 << 22);
+  linkStack.push_back(ast.getRoot());
+  std::size_t linkNodes = 0;
+  before = allocations;
+  start = std::chrono::steady_clock::now();
+  while (!linkStack.empty()) {
+    ASTNode::Link node = linkStack.back();
+    linkStack.pop_back();
+    linkNodes++;
+    for (auto& child : node->getChildren()) if (child != nullptr) linkStack.push_back(child);
+  }
+  std::chrono::duration<double> linkTime = std::chrono::steady_clock::now() - start;
+  report("getChildren", linkNodes, allocations - before, linkTime.count());
+
+  return spanAllocations == 0 ? 0 : 1;
+}
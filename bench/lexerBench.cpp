@@ -0,0 +1,46 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <algorithm>
+
+#include "lexer.hpp"
+
+/**
+  \file
+  \brief Times Lexer::tokenize on generated, operator-dense code
+
+  Usage: lexer_bench [megabytes] [runs] [chunks]. The input is the same line repeated until it
+  is at least that large (8 MB by default). The best of the runs (5 by default) is reported.
+  With more than 1 chunk, the input is lexed in that many parallel chunks.
+*/
+
+static const std::string line =
+  "a += b <<= c >> d != e && !f || g++ - --h * (i / j) % k ^ l | m & ~n <= o;\n";
+
+static std::string generateCode(std::size_t size) {
+  std::string code;
+  code.reserve(size + line.size());
+  while (code.size() < size) code += line;
+  return code;
+}
+
+int main(int argc, char** argv) {
+  std::size_t megabytes = argc > 1 ? std::stoul(argv[1]) : 8;
+  int runs = argc > 2 ? std::stoi(argv[2]) : 5;
+  unsigned chunks = argc > 3 ? static_cast<unsigned>(std::stoul(argv[3])) : 1;
+  std::string code = generateCode(megabytes * 1000 * 1000);
+  double best = 0;
+  std::size_t tokenCount = 0;
+  for (int i = 0; i < runs; i++) {
+    auto start = std::chrono::steady_clock::now();
+    auto lx = chunks > 1 ?
+      Lexer::tokenize(code, "<lexer-bench>", chunks) : Lexer::tokenize(code, "<lexer-bench>");
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    tokenCount = lx->getTokenStore().size();
+    best = i == 0 ? elapsed.count() : std::min(best, elapsed.count());
+  }
+  std::cout << code.size() << " bytes, " << tokenCount << " tokens" << std::endl;
+  std::cout << "best of " << runs << ": " << best * 1000 << " ms, "
+    << static_cast<double>(code.size()) / best / 1e6 << " MB/s" << std::endl;
+  return 0;
+}
@@ -4,8 +4,10 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <new>
 #include <typeinfo>
 #include <unordered_set>
+#include <unordered_map>
 
 #include <variant.hpp>
 
@@ -23,6 +25,7 @@ namespace llvm {
 class TypeData;
 class ValueWrapper;
 class FunctionWrapper;
+struct NameBinding;
 
 class ASTVisitor;
 using ASTVisitorLink = PtrUtil<ASTVisitor>::Link;
@@ -30,18 +33,76 @@ using ASTVisitorLink = PtrUtil<ASTVisitor>::Link;
 class ASTNode;
 using ASTNodeLink = std::shared_ptr<ASTNode>;
 
+/**
+  \brief Memory for the nodes of ASTs
+  
+  Nodes are constructed next to each other in big chunks, and they are all destroyed along
+  with their arena, instead of one by one. Links to nodes share the reference count of the
+  arena, so as long as any Link to a node exists, every node in its arena does too. Inside
+  the tree, nodes refer to each other with plain pointers.
+  
+  Node::make uses the arena of the current thread, which lasts until nothing uses it
+  anymore, or until a Scope replaces it.
+*/
+class ASTArena: public std::enable_shared_from_this<ASTArena> {
+private:
+  static constexpr std::size_t minChunkSize = 1024;
+  static constexpr std::size_t maxChunkSize = 64 * 1024;
+  
+  std::vector<std::unique_ptr<char[]>> chunks {};
+  std::size_t chunkSize = 0;
+  /// Free space in the last chunk
+  char* next = nullptr;
+  std::size_t available = 0;
+  /// Every node in the arena, in the order they were made
+  std::vector<ASTNode*> nodes {};
+  
+  void* allocate(std::size_t size, std::size_t alignment);
+  /// The arena that Node::make uses on this thread
+  static std::weak_ptr<ASTArena>& current() noexcept;
+  
+public:
+  ASTArena() = default;
+  ASTArena(const ASTArena&) = delete;
+  ASTArena& operator=(const ASTArena&) = delete;
+  ~ASTArena();
+  
+  /// How many nodes are in this arena
+  inline std::size_t size() const noexcept {
+    return nodes.size();
+  }
+  
+  /// Get the current arena of this thread, or a new one if there isn't any
+  static std::shared_ptr<ASTArena> forThread();
+  
+  /// Construct a node in the current arena of this thread
+  template<typename T, typename... Args>
+  static std::shared_ptr<T> make(Args&&... args);
+  
+  /// Makes a new arena current for this thread, until the scope ends
+  class Scope {
+  private:
+    std::shared_ptr<ASTArena> arena;
+    std::weak_ptr<ASTArena> previous;
+  public:
+    Scope();
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+    ~Scope();
+  };
+};
+
 /**
   \brief Utility class for managing smart pointers of ASTNode subclasses
 */
 template<typename T, typename std::enable_if<std::is_base_of<ASTNode, T>::value>::type* = nullptr>
 struct Node: public PtrUtil<T> {
   typedef typename PtrUtil<T>::Link Link;
-  typedef typename PtrUtil<T>::WeakLink WeakLink;
   
-  /// Create a shared ptr that holds a node
+  /// Create a node in the current arena \see ASTArena
   template<typename... Args>
-  static Link make(Args... args) {
-    return std::make_shared<T>(args...);
+  static Link make(Args&&... args) {
+    return ASTArena::make<T>(std::forward<Args>(args)...);
   }
   
   /// Technically overrides PtrUtil<T>::dynPtrCast
@@ -50,28 +111,122 @@ struct Node: public PtrUtil<T> {
   }
 };
 
+/**
+  \brief The class of a node, so it can be switched on without virtual calls or casts
+  
+  Each concrete ASTNode subclass has its own kind. \see StaticASTVisitor
+*/
+enum class NodeKind: uint8_t {
+  BLOCK,
+  EXPRESSION,
+  DECLARATION,
+  BRANCH,
+  LOOP,
+  RETURN,
+  BREAK_LOOP,
+  FUNCTION,
+  TYPE,
+  CONSTRUCTOR,
+  METHOD,
+  MEMBER
+};
+
+/**
+  \brief View of some children of a node, as pointers to T
+  
+  It doesn't own the nodes and doesn't copy anything, and it is only valid until the
+  children of the node change. Missing optional children are nullptr.
+*/
+template<typename T>
+class NodeSpan {
+private:
+  ASTNode* const* first;
+  ASTNode* const* last;
+public:
+  class iterator {
+  private:
+    ASTNode* const* at;
+  public:
+    explicit iterator(ASTNode* const* at) noexcept: at(at) {}
+    inline T* operator*() const noexcept {
+      return static_cast<T*>(*at);
+    }
+    inline iterator& operator++() noexcept {
+      ++at;
+      return *this;
+    }
+    inline bool operator==(const iterator& rhs) const noexcept {
+      return at == rhs.at;
+    }
+    inline bool operator!=(const iterator& rhs) const noexcept {
+      return at != rhs.at;
+    }
+  };
+  
+  NodeSpan(ASTNode* const* first, ASTNode* const* last) noexcept: first(first), last(last) {}
+  
+  inline iterator begin() const noexcept {
+    return iterator(first);
+  }
+  inline iterator end() const noexcept {
+    return iterator(last);
+  }
+  inline std::size_t size() const noexcept {
+    return static_cast<std::size_t>(last - first);
+  }
+  inline bool empty() const noexcept {
+    return first == last;
+  }
+  inline T* operator[](std::size_t pos) const noexcept {
+    return static_cast<T*>(first[pos]);
+  }
+};
+
 /**
   \brief A node in an AST
   
   This is the abstract superclass for all the nodes in an AST.
 */
-class ASTNode: public std::enable_shared_from_this<ASTNode> {
+class ASTNode {
+  friend class ASTArena;
 public:
   using Link = std::shared_ptr<ASTNode>;
-  using WeakLink = std::weak_ptr<ASTNode>;
   using Children = std::vector<Link>;
+  
+  /// Get a Link to a node, or nullptr
+  template<typename T>
+  static std::shared_ptr<T> linkTo(T* node) {
+    if (node == nullptr) return nullptr;
+    return std::shared_ptr<T>(static_cast<ASTNode*>(node)->arena->shared_from_this(), node);
+  }
+private:
+  /// The arena that holds this node
+  ASTArena* arena = nullptr;
+  const NodeKind kind;
 protected:
-  WeakLink parent = WeakLink(); ///< Parent in the tree
-  Children children {}; ///< Branches/Leaves in the tree
+  /// Parent in the tree, possibly from another arena
+  ASTNode* parent = nullptr;
+  /**
+    \brief Branches/Leaves in the tree
+    
+    Nodes with a fixed layout keep their children in known positions here.
+  */
+  std::vector<ASTNode*> children {};
   Trace trace = defaultTrace; ///< Where in the source was this found
   
+  /// Get a view of the children in [begin, end)
+  template<typename T>
+  inline NodeSpan<T> spanOf(std::size_t begin, std::size_t end) const noexcept {
+    return NodeSpan<T>(children.data() + begin, children.data() + end);
+  }
+  
   template<typename ReturnType = std::size_t>
   ReturnType transformArrayIndex(int64_t idx) const {
     ReturnType res;
     if (idx < 0) {
       // Negative indices count from the end of the vector
-      int64_t transPos = static_cast<int64_t>(getChildren().size()) + idx;
-      if (transPos < 0 || transPos > static_cast<int64_t>(getChildren().size())) {
+      int64_t transPos = static_cast<int64_t>(children.size()) + idx;
+      if (transPos < 0 || transPos > static_cast<int64_t>(children.size())) {
         throw InternalError("Index out of array bounds", {
           METADATA_PAIRS,
           {"index", std::to_string(idx)},
@@ -86,12 +241,19 @@ protected:
   }
   
 public:
-  ASTNode() = default;
-  ASTNode(const ASTNode&) = default;
+  explicit ASTNode(NodeKind kind) noexcept: kind(kind) {}
+  ASTNode(const ASTNode&) = delete;
   virtual ~ASTNode() = default;
   
+  inline NodeKind getKind() const noexcept {
+    return kind;
+  }
+  
   /**
     \brief Add a new child to this node.
+    
+    If the child is from another arena, this node doesn't keep it alive; it must be removed
+    before that arena is gone.
   */
   virtual void addChild(Link child);
   
@@ -102,13 +264,16 @@ public:
   virtual Link removeChild(int64_t pos);
   
   /**
-    \brief Get list of children
+    \brief Get a view of the children, in order
     
-    This method is not guaranteed to return the private member 'children'.
+    Iterating it doesn't allocate or touch reference counts, so traversals should use this
+    instead of getChildren.
   */
-  virtual inline Children getChildren() const noexcept {
-    return children;
+  inline NodeSpan<ASTNode> getChildSpan() const noexcept {
+    return spanOf<ASTNode>(0, children.size());
   }
+  /// Get Links to all the children
+  Children getChildren() const;
   /**
     \brief Get child at position
     \param pos which child. Supports negative positions that count from the end
@@ -117,11 +282,11 @@ public:
   /// \copydoc at(int64)
   Link at(std::size_t pos) const;
   
-  inline void setParent(WeakLink newParent) noexcept {
+  inline void setParent(ASTNode* newParent) noexcept {
     parent = newParent;
   }
-  inline WeakLink getParent() const noexcept {
-    return parent;
+  inline Link getParent() const {
+    return linkTo(parent);
   }
   
   inline void setTrace(Trace newTrace) noexcept {
@@ -144,11 +309,10 @@ public:
   */
   template<typename T>
   typename Node<T>::Link findAbove() const {
-    return Node<T>::staticPtrCast(
-      findAbove([](ASTNode::Link lk) {
-        return Node<T>::dynPtrCast(lk) != nullptr;
-      })
-    );
+    for (ASTNode* node = parent; node != nullptr; node = node->parent) {
+      if (auto found = dynamic_cast<T*>(node)) return linkTo(found);
+    }
+    return nullptr;
   }
     
   virtual bool operator==(const ASTNode& rhs) const;
@@ -157,6 +321,19 @@ public:
   virtual void visit(ASTVisitorLink visitor) = 0;
 };
 
+template<typename T, typename... Args>
+std::shared_ptr<T> ASTArena::make(Args&&... args) {
+  auto arena = forThread();
+  // Make room first, so a node is never constructed without being destroyed later
+  if (arena->nodes.size() == arena->nodes.capacity()) {
+    arena->nodes.reserve(arena->nodes.size() * 2 + 64);
+  }
+  T* node = new (arena->allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  node->arena = arena.get();
+  arena->nodes.push_back(node);
+  return std::shared_ptr<T>(arena, node);
+}
+
 /**
   \brief All the types a BlockNode can be.
 */
@@ -175,9 +352,9 @@ private:
   BlockType type;
 public:
   /// Maps identifiers to their declaration (contains current value/type)
-  std::map<std::string, std::shared_ptr<ValueWrapper>> blockScope {};
+  std::unordered_map<Symbol, std::shared_ptr<ValueWrapper>> blockScope {};
   /// Maps function names to their respective FunctionWrapper
-  std::map<std::string, std::shared_ptr<FunctionWrapper>> blockFuncs {};
+  std::unordered_map<Symbol, std::shared_ptr<FunctionWrapper>> blockFuncs {};
   /// List of types defined in this block
   std::unordered_set<AbstractId::Link> blockTypes {};
   
@@ -203,6 +380,10 @@ public:
 class ExpressionNode: public ASTNode {
 private:
   Token tok = Token(TT::UNPROCESSED, defaultTrace);
+  /// For identifiers, their interned name
+  Symbol symbol {};
+  /// What an identifier refers to, set by NameResolver
+  NameBinding* binding = nullptr;
 public:
   ExpressionNode(Token token);
   
@@ -212,6 +393,17 @@ public:
   inline Token getToken() const noexcept {
     return tok;
   }
+  /// Only valid for identifiers
+  inline Symbol getSymbol() const noexcept {
+    return symbol;
+  }
+  
+  inline NameBinding* getBinding() const noexcept {
+    return binding;
+  }
+  inline void setBinding(NameBinding* newBinding) noexcept {
+    binding = newBinding;
+  }
   
   bool operator==(const ASTNode& rhs) const override;
   bool operator!=(const ASTNode& rhs) const override;
@@ -270,7 +462,7 @@ public:
   /**
     \param childrenCount does not have more than this many children
   */
-  NoMoreChildrenNode(std::size_t childrenCount) noexcept;
+  NoMoreChildrenNode(NodeKind kind, std::size_t childrenCount) noexcept;
   
   /**
     \throws InternalError always throws, never use
@@ -279,7 +471,7 @@ public:
   
   /// Utility to check if the childIndex'th child is not nullptr
   inline bool notNull(unsigned childIndex) const noexcept {
-    return getChildren()[childIndex] != nullptr;
+    return children[childIndex] != nullptr;
   }
 };
 
@@ -290,10 +482,14 @@ public:
 */
 class DeclarationNode: public NoMoreChildrenNode {
 private:
-  std::string identifier;
+  Symbol identifier;
   DefiniteTypeInfo info;
-  /// Optional initialization. Only child of DeclarationNode
-  Node<ExpressionNode>::Link _init = nullptr;
+  NameBinding* binding = nullptr;
+  
+protected:
+  /// For subclasses
+  DeclarationNode(NodeKind kind, std::string identifier, TypeList typeList) noexcept:
+    NoMoreChildrenNode(kind, 1), identifier(identifier), info(typeList) {}
   
 public:
   /**
@@ -301,22 +497,22 @@ public:
     \param typeList what types are allowed to be stored in this variable
   */
   DeclarationNode(std::string identifier, TypeList typeList) noexcept:
-    NoMoreChildrenNode(1), identifier(identifier), info(typeList) {}
+    DeclarationNode(NodeKind::DECLARATION, identifier, typeList) {}
   
+  /// Optional initialization. Only child of DeclarationNode
   inline Node<ExpressionNode>::Link init() const noexcept {
-    return _init;
+    return linkTo(static_cast<ExpressionNode*>(children[0]));
   }
   
   inline void init(Node<ExpressionNode>::Link init) noexcept {
-    init->setParent(shared_from_this());
-    _init = init;
+    init->setParent(this);
+    children[0] = init.get();
   }
   
-  inline Children getChildren() const noexcept override {
-    return {_init};
+  inline const std::string& getIdentifier() const noexcept {
+    return identifier.str();
   }
-  
-  inline std::string getIdentifier() const noexcept {
+  inline Symbol getSymbol() const noexcept {
     return identifier;
   }
 
@@ -329,7 +525,15 @@ public:
   }
 
   inline bool hasInit() const noexcept {
-    return _init != nullptr;
+    return children[0] != nullptr;
+  }
+  
+  /// The binding identifiers that refer to this declaration use, set by NameResolver
+  inline NameBinding* getBinding() const noexcept {
+    return binding;
+  }
+  inline void setBinding(NameBinding* newBinding) noexcept {
+    binding = newBinding;
   }
   
   bool operator==(const ASTNode& rhs) const override;
@@ -347,57 +551,46 @@ public:
     - FailiureBlock - BlockNode or BranchNode (optional)
 */
 class BranchNode: public NoMoreChildrenNode {
-private:
-  /// Branch condition
-  Node<ExpressionNode>::Link _condition = nullptr;
-  /// Code to run when condition is true
-  Node<BlockNode>::Link _success = nullptr;
-  /// Either code or another branch to be ran when the condition is false
-  mpark::variant<
+public:
+  using Failiure = mpark::variant<
     Node<BlockNode>::Link,
     std::shared_ptr<BranchNode>,
     std::nullptr_t
-  > _failiure = nullptr;
-
-public:
-  BranchNode() noexcept: NoMoreChildrenNode(3) {}
+  >;
+  
+  BranchNode() noexcept: NoMoreChildrenNode(NodeKind::BRANCH, 3) {}
   
+  /// Branch condition
   inline Node<ExpressionNode>::Link condition() const noexcept {
-    return _condition;
+    return linkTo(static_cast<ExpressionNode*>(children[0]));
   }
   
   inline void condition(Node<ExpressionNode>::Link condition) noexcept {
-    condition->setParent(shared_from_this());
-    _condition = condition;
+    condition->setParent(this);
+    children[0] = condition.get();
   }
   
+  /// Code to run when condition is true
   inline Node<BlockNode>::Link success() const noexcept {
-    return _success;
+    return linkTo(static_cast<BlockNode*>(children[1]));
   }
   
   inline void success(Node<BlockNode>::Link success) noexcept {
-    success->setParent(shared_from_this());
-    _success = success;
+    success->setParent(this);
+    children[1] = success.get();
   }
   
-  inline decltype(_failiure) failiure() const noexcept {
-    return _failiure;
+  /// Either code or another branch to be ran when the condition is false
+  inline Failiure failiure() const noexcept {
+    if (children[2] == nullptr) return nullptr;
+    if (auto branch = dynamic_cast<BranchNode*>(children[2])) return linkTo(branch);
+    return linkTo(static_cast<BlockNode*>(children[2]));
   }
   
   template<typename T>
   inline void failiure(typename Node<T>::Link failiure) noexcept {
-    failiure->setParent(shared_from_this());
-    _failiure = failiure;
-  }
-  
-  inline Children getChildren() const noexcept override {
-    Node<ASTNode>::Link fail = nullptr;
-    if (mpark::holds_alternative<0>(_failiure)) {
-      fail = Node<ASTNode>::dynPtrCast(mpark::get<0>(_failiure));
-    } else if (mpark::holds_alternative<1>(_failiure)) {
-      fail = Node<ASTNode>::dynPtrCast(mpark::get<1>(_failiure));
-    }
-    return {_condition, _success, fail};
+    failiure->setParent(this);
+    children[2] = failiure.get();
   }
   
   void visit(ASTVisitorLink visitor) override;
@@ -406,71 +599,65 @@ public:
 /**
   \brief Represents a loop.
   
-  Has 4 children:
-    - Init - DeclarationNode (optional)
+  Has these children, in order:
+    - Inits - DeclarationNode (any number)
     - Condition - ExpressionNode (optional)
-    - Update - ExpressionNode (optional)
+    - Updates - ExpressionNode (any number)
     - Code - BlockNode
   Example on a for loop:
   for Init; Condition; Update Code
 */
 class LoopNode: public NoMoreChildrenNode {
 private:
-  std::vector<Node<DeclarationNode>::Link> _inits = {};
-  Node<ExpressionNode>::Link _condition = nullptr;
-  std::vector<Node<ExpressionNode>::Link> _updates = {};
-  Node<BlockNode>::Link _code = nullptr;
+  std::size_t initCount = 0;
+  std::size_t updateCount = 0;
+  
+  inline std::size_t conditionPos() const noexcept {
+    return initCount;
+  }
 
 public:
   /// Used by the break statement
   llvm::BasicBlock* exitBlock;
   
-  LoopNode() noexcept: NoMoreChildrenNode(4) {}
+  LoopNode() noexcept: NoMoreChildrenNode(NodeKind::LOOP, 2) {}
   
   inline Node<ExpressionNode>::Link condition() const noexcept {
-    return _condition;
+    return linkTo(static_cast<ExpressionNode*>(children[conditionPos()]));
   }
   
   inline void condition(Node<ExpressionNode>::Link condition) noexcept {
-    condition->setParent(shared_from_this());
-    _condition = condition;
+    condition->setParent(this);
+    children[conditionPos()] = condition.get();
   }
   
   inline Node<BlockNode>::Link code() const noexcept {
-    return _code;
+    return linkTo(static_cast<BlockNode*>(children.back()));
   }
   
   inline void code(Node<BlockNode>::Link code) noexcept {
-    code->setParent(shared_from_this());
-    _code = code;
-  }
-  
-  inline decltype(_inits) inits() const noexcept {
-    return _inits;
+    code->setParent(this);
+    children.back() = code.get();
   }
   
-  inline void addInit(Node<DeclarationNode>::Link init) noexcept {
-    init->setParent(shared_from_this());
-    _inits.push_back(init);
+  inline NodeSpan<DeclarationNode> inits() const noexcept {
+    return spanOf<DeclarationNode>(0, initCount);
   }
   
-  inline decltype(_updates) updates() const noexcept {
-    return _updates;
+  inline void addInit(Node<DeclarationNode>::Link init) {
+    init->setParent(this);
+    children.insert(children.begin() + static_cast<std::ptrdiff_t>(initCount), init.get());
+    initCount++;
   }
   
-  inline void addUpdate(Node<ExpressionNode>::Link upd) noexcept {
-    upd->setParent(shared_from_this());
-    _updates.push_back(upd);
+  inline NodeSpan<ExpressionNode> updates() const noexcept {
+    return spanOf<ExpressionNode>(conditionPos() + 1, conditionPos() + 1 + updateCount);
   }
   
-  inline Children getChildren() const noexcept override {
-    Children c;
-    c.reserve(_inits.size() + 1 + _updates.size() + 1);
-    c.insert(std::end(c), ALL(_inits));
-    c.push_back(_condition);
-    c.insert(std::end(c), ALL(_updates));
-    c.push_back(_code);
-    return c;
+  inline void addUpdate(Node<ExpressionNode>::Link upd) {
+    upd->setParent(this);
+    children.insert(children.end() - 1, upd.get());
+    updateCount++;
   }
   
   void visit(ASTVisitorLink visitor) override;
@@ -482,23 +669,16 @@ public:
   Can have an ExpressionNode to be returned.
 */
 class ReturnNode: public NoMoreChildrenNode {
-private:
-  Node<ExpressionNode>::Link _value = nullptr;
-  
 public:
-  ReturnNode() noexcept: NoMoreChildrenNode(1) {}
+  ReturnNode() noexcept: NoMoreChildrenNode(NodeKind::RETURN, 1) {}
   
   inline Node<ExpressionNode>::Link value() const noexcept {
-    return _value;
+    return linkTo(static_cast<ExpressionNode*>(children[0]));
   }
   
   inline void value(Node<ExpressionNode>::Link value) noexcept {
-    value->setParent(shared_from_this());
-    _value = value;
-  }
-  
-  inline Children getChildren() const noexcept override {
-    return {_value};
+    value->setParent(this);
+    children[0] = value.get();
   }
   
   void visit(ASTVisitorLink visitor) override;
@@ -511,7 +691,7 @@ public:
 */
 class BreakLoopNode: public NoMoreChildrenNode {
 public:
-  BreakLoopNode() noexcept: NoMoreChildrenNode(0) {}
+  BreakLoopNode() noexcept: NoMoreChildrenNode(NodeKind::BREAK_LOOP, 0) {}
   
   void visit(ASTVisitorLink visitor) override;
 };
@@ -521,10 +701,14 @@ public:
 */
 class FunctionNode: public NoMoreChildrenNode {
 private:
-  std::string ident;
+  Symbol ident;
   FunctionSignature sig;
   bool foreign;
-  Node<BlockNode>::Link _code = nullptr;
+  NameBinding* binding = nullptr;
+  
+protected:
+  /// For subclasses
+  FunctionNode(NodeKind kind, std::string ident, FunctionSignature sig, bool foreign);
   
 public:
   FunctionNode(FunctionSignature sig);
@@ -532,19 +716,18 @@ public:
   FunctionNode(std::string ident, FunctionSignature sig, bool foreign = false);
   
   inline Node<BlockNode>::Link code() const noexcept {
-    return _code;
+    return linkTo(static_cast<BlockNode*>(children[0]));
   }
   
   inline void code(Node<BlockNode>::Link code) noexcept {
-    code->setParent(shared_from_this());
-    _code = code;
+    code->setParent(this);
+    children[0] = code.get();
   }
   
-  inline Children getChildren() const noexcept override {
-    return {_code};
+  inline const std::string& getIdentifier() const noexcept {
+    return ident.str();
   }
-  
-  inline std::string getIdentifier() const noexcept {
+  inline Symbol getSymbol() const noexcept {
     return ident;
   }
   inline const FunctionSignature& getSignature() const noexcept {
@@ -556,6 +739,14 @@ public:
   inline bool isAnon() const noexcept {
     return ident.empty();
   }
+  
+  /// The binding identifiers that refer to this function use, set by NameResolver
+  inline NameBinding* getBinding() const noexcept {
+    return binding;
+  }
+  inline void setBinding(NameBinding* newBinding) noexcept {
+    binding = newBinding;
+  }
 
   bool operator==(const ASTNode& rhs) const override;
   bool operator!=(const ASTNode& rhs) const override;
@@ -640,13 +831,19 @@ class MemberNode: public DeclarationNode {
 private:
   bool staticM;
   Visibility vis;
+  bool cold;
 public:
   /// \copydoc DeclarationNode(std::string,TypeList)
-  MemberNode(std::string identifier, TypeList typeList, bool staticM = false, Visibility vis = PRIVATE);
+  MemberNode(std::string identifier, TypeList typeList, bool staticM = false, Visibility vis = PRIVATE, bool cold = false);
   
   inline bool isStatic() const noexcept {
     return staticM;
   }
+  
+  /// If the member is rarely used, so it is kept out of the way of the others
+  inline bool isCold() const noexcept {
+    return cold;
+  }
 
   inline Visibility getVisibility() const noexcept {
     return vis;
@@ -667,7 +864,7 @@ public:
 */
 class AST {
 private:
-  /// Root of AST
+  /// Root of AST, which keeps the arena of its nodes alive
   Node<BlockNode>::Link root;
 public:
   AST(Node<BlockNode>::Link lk);
@@ -710,24 +907,82 @@ public:
 
 #undef PURE_VIRTUAL_VISIT
 
-class ASTPrinter: public ASTVisitor, public std::enable_shared_from_this<ASTPrinter> {
+/**
+  \see StaticASTVisitor::visit
+*/
+#define STATIC_VISIT_CASE(kind, nodeName) \
+case NodeKind::kind: return self.visit##nodeName(static_cast<nodeName##Node*>(node));
+
+/**
+  \brief Visitor that is dispatched at compile time
+  
+  Derived must have a visitX(XNode*) function for every kind of node. Unlike ASTVisitor,
+  visiting a node is a switch on its kind followed by a direct call, and neither the
+  visitor nor the node need a Link.
+*/
+template<typename Derived>
+class StaticASTVisitor {
+public:
+  void visit(ASTNode* node) {
+    auto& self = static_cast<Derived&>(*this);
+    switch (node->getKind()) {
+      STATIC_VISIT_CASE(BLOCK, Block)
+      STATIC_VISIT_CASE(EXPRESSION, Expression)
+      STATIC_VISIT_CASE(DECLARATION, Declaration)
+      STATIC_VISIT_CASE(BRANCH, Branch)
+      STATIC_VISIT_CASE(LOOP, Loop)
+      STATIC_VISIT_CASE(RETURN, Return)
+      STATIC_VISIT_CASE(BREAK_LOOP, BreakLoop)
+      STATIC_VISIT_CASE(FUNCTION, Function)
+      STATIC_VISIT_CASE(TYPE, Type)
+      STATIC_VISIT_CASE(CONSTRUCTOR, Constructor)
+      STATIC_VISIT_CASE(METHOD, Method)
+      STATIC_VISIT_CASE(MEMBER, Member)
+    }
+    throw InternalError("Unknown node kind", {
+      METADATA_PAIRS,
+      {"kind", std::to_string(static_cast<int>(node->getKind()))}
+    });
+  }
+};
+
+#undef STATIC_VISIT_CASE
+
+class ASTPrinter: public StaticASTVisitor<ASTPrinter> {
+  friend class StaticASTVisitor<ASTPrinter>;
 private:
-  void visitExpression(Node<ExpressionNode>::Link node) override;
-  void visitDeclaration(Node<DeclarationNode>::Link node) override;
-  void visitBranch(Node<BranchNode>::Link node) override;
-  void visitLoop(Node<LoopNode>::Link node) override;
-  void visitReturn(Node<ReturnNode>::Link node) override;
-  void visitBlock(Node<BlockNode>::Link node) override;
-  void visitBreakLoop(Node<BreakLoopNode>::Link node) override;
-  void visitFunction(Node<FunctionNode>::Link node) override;
-  void visitType(Node<TypeNode>::Link node) override;
-  void visitConstructor(Node<ConstructorNode>::Link node) override;
-  void visitMethod(Node<MethodNode>::Link node) override;
-  void visitMember(Node<MemberNode>::Link node) override;
+  void visitExpression(ExpressionNode* node);
+  void visitDeclaration(DeclarationNode* node);
+  void visitBranch(BranchNode* node);
+  void visitLoop(LoopNode* node);
+  void visitReturn(ReturnNode* node);
+  void visitBlock(BlockNode* node);
+  void visitBreakLoop(BreakLoopNode* node);
+  void visitFunction(FunctionNode* node);
+  void visitType(TypeNode* node);
+  void visitConstructor(ConstructorNode* node);
+  void visitMethod(MethodNode* node);
+  void visitMember(MemberNode* node);
   
   unsigned level = 0;
   std::string text = "";
   
+  /// Something to print at some level, a node or the label before one
+  struct PrintItem {
+    ASTNode* node;
+    const char* label;
+    unsigned level;
+  };
+  /**
+    \brief What remains to be printed, in reverse order
+    
+    The printer doesn't recurse into children, because trees can be very deep. Instead, the
+    visit functions schedule them, and print keeps going until there is nothing left.
+  */
+  std::vector<PrintItem> pending {};
+  /// What the current visit function scheduled, in order
+  std::vector<PrintItem> scheduled {};
+  
 protected:
   ASTPrinter() = default;
   ASTPrinter(const ASTPrinter&) = default;
@@ -744,18 +999,19 @@ protected:
     text += s + '\n';
   }
   
-  void printSubtree(ASTNode::Link node) {
-    level++;
-    for (auto& child : node->getChildren()) child->visit(shared_from_this());
-    level--;
+  /// Print all the children of the node, one level deeper
+  void printSubtree(ASTNode* node) {
+    for (auto child : node->getChildSpan()) scheduled.push_back({child, nullptr, level + 1});
   }
   
-public:
-  inline static std::string print(ASTNode::Link node) {
-    auto printer = std::shared_ptr<ASTPrinter>(new ASTPrinter());
-    node->visit(printer);
-    return printer->text;
+  /// Print a child one level deeper, preceded by its label
+  void printLabeled(ASTNode* child, const char* label) {
+    scheduled.push_back({nullptr, label, level + 1});
+    scheduled.push_back({child, nullptr, level + 1});
   }
+  
+public:
+  static std::string print(ASTNode::Link node);
 };
 
 inline std::ostream& operator<<(std::ostream& out, AST ast) noexcept {
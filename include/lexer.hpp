@@ -5,13 +5,21 @@
 #include <stack>
 #include <string>
 #include <cctype>
+#include <cstring>
+#include <thread>
+#include <exception>
 #include <unordered_map>
 
 #include "utils/util.hpp"
 #include "utils/trace.hpp"
 #include "utils/error.hpp"
+#include "utils/mappedFile.hpp"
+#include "utils/sourceManager.hpp"
+#include "utils/charScan.hpp"
+#include "utils/numbers.hpp"
 #include "operator.hpp"
 #include "token.hpp"
+#include "tokenStore.hpp"
 
 namespace {
   /**
@@ -36,34 +44,55 @@ namespace {
 /// Tokenizes input.
 class Lexer {
 private:
-  std::string code;
+  /// Start of the input, which is owned by either ownedCode or mappedCode
+  const char* code = nullptr;
+  uint64_t codeLength = 0;
+  std::string ownedCode;
+  std::unique_ptr<MappedFile> mappedCode;
+  /// If true, materialized tokens point into the input instead of owning a copy of their data
+  bool viewTokens = false;
   std::string sourceOfCode;
-  std::vector<Token> tokens {};
+  FileId fileId;
+  TokenStore tokens {};
   
   uint64_t pos = 0;
-  uint64_t currentLine = 1;
-  uint64_t currentLinePos = 0;
+  /// Indices of the parens that were opened, but not closed yet
+  std::stack<std::size_t> openParens {};
+  /// True after the TT::FILE_END token was added
+  bool finished = false;
   
-  /// Get character at current position
-  inline char current() const {
-    return code[pos];
+  /// Files smaller than this are never lexed in parallel by tokenizeFile
+  static constexpr uint64_t parallelThreshold = 4 * 1024 * 1024;
+  /// How much of the input lexMore looks at in one go
+  static constexpr uint64_t streamWindow = 64 * 1024;
+  
+  /// Tokens from part of the input, lexed without knowing what came before it
+  struct Chunk {
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    /// Where lexing stopped; past end if the last token crossed into the next chunk
+    uint64_t stoppedAt = 0;
+    TokenStore tokens {};
+    /// Lexing errors are only thrown after the tokens before them are processed
+    std::exception_ptr error = nullptr;
+  };
+  
+  /// Get character at current position, or '\0' past the end of the input
+  inline char current() const noexcept {
+    return peekAhead(0);
   }
-  /**
-    \brief Get multiple characters starting at the current position
-    \param charCount how many should be retrieved
-  */
-  inline std::string current(unsigned charCount) const {
-    return code.substr(pos, charCount);
+  /// Get a character this many indices ahead, or '\0' past the end of the input
+  inline char peekAhead(unsigned ahead) const noexcept {
+    return pos + ahead < codeLength ? code[pos + ahead] : '\0';
   }
-  /// Get a character this many indices ahead
-  inline char peekAhead(unsigned ahead) const {
-    return code[pos + ahead];
+  /// Check if the input at the current position starts with str
+  inline bool isAt(const std::string& str) const noexcept {
+    return str.length() <= codeLength - pos && std::equal(ALL(str), code + pos);
   }
   /// Skip a number of chars, usually just advances to the next one
   inline void skip(uint64_t skipped) {
     pos += skipped;
-    currentLinePos += skipped;
-    if (pos >= code.length()) pos = code.length();
+    if (pos >= codeLength) pos = codeLength;
   }
   /// Decrement current position so the loop doesn't increment automatically
   inline void noIncrement() noexcept {
@@ -75,28 +104,19 @@ private:
   }
   /// Is end of file
   inline bool isEOF() const noexcept {
-    return pos == code.length();
-  }
-  /// Advance to the next line
-  inline void nextLine() noexcept {
-    currentLinePos = 0;
-    currentLine++;
-  }
-  /// Get a Position object to the current location
-  inline Position getPos() const noexcept {
-    return Position(currentLine, currentLinePos);
-  }
-  /// Make a range from the argument to the current position
-  inline Range rangeFrom(Position start) const noexcept {
-    return Range(start, getPos());
+    return pos == codeLength;
   }
+  /// Advance to the next character in the set, or to the end of the input
+  void skipUntil(const CharSet& set) noexcept;
+  /// Advance to the next character not in the set, but not past limit
+  void skipWhile(const CharSet& set, uint64_t limit) noexcept;
   /// Make a trace from the argument to the current position
-  inline Trace traceFrom(Position start) const noexcept {
-    return Trace(sourceOfCode, rangeFrom(start));
+  inline Trace traceFrom(uint64_t start) const noexcept {
+    return Trace(fileId, static_cast<uint32_t>(start), static_cast<uint32_t>(pos - start));
   }
   /// Make a trace n characters long
   inline Trace traceFor(unsigned n) const noexcept {
-    return Trace(sourceOfCode, Range(getPos(), n));
+    return Trace(fileId, static_cast<uint32_t>(pos), n);
   }
 
   inline void handleMultiLineComments();
@@ -104,17 +124,30 @@ private:
   /// Check if the current character can be part of an identifier
   bool isIdentifierChar() const noexcept;
   /**
-    \brief Disambiguate the fixity of the last token added
+    \brief Disambiguate the fixity of a token
+    \param before how many tokens are in front of it
     \returns one of the arguments, depending on the token in front
   */
   Fixity determineFixity(
+    std::size_t before,
     Fixity afterBinaryOrPrefix,
     Fixity afterIdentOrParen,
     Fixity otherCases
   ) const noexcept;
   
-  /// Disambiguate between parens and calls, on the current token
-  TokenType determineParenBeginType() const noexcept;
+  /// Disambiguate between parens and calls, for a paren with this many tokens in front of it
+  TokenType determineParenBeginType(std::size_t before) const noexcept;
+  /// Pick one of the operators that use a symbol, based on the token in front of it
+  Operator::Index pickOperator(
+    std::size_t before,
+    const Operator::SymbolMatch& symbolMatch
+  ) const noexcept;
+  /**
+    \brief Track parens using a stack of token indices, turning closing parens into
+    TT::CALL_END if they close a call, and telling opening parens where they are closed
+    \throws Error if the parens don't match
+  */
+  void matchParen(std::size_t at, std::stack<std::size_t>& parenStack);
   
   bool isValidForRadix(char c, unsigned radix) const noexcept;
   /**
@@ -123,11 +156,10 @@ private:
   */
   unsigned readRadix();
   /**
-    \brief Look for a number at the current position
-    \param radix the number's radix
-    \returns a token with TT::INTEGER or TT::FLOAT, with its data field in decimal
+    \brief Look for a number at the current position, including its radix, and add a token
+    with TT::INTEGER or TT::FLOAT that has its parsed value
   */
-  Token readNumber(unsigned radix);
+  void readNumber();
   /**
     \brief Look for an escape sequence (assumes that the \\ was skipped)
     \returns whatever was escaped
@@ -136,9 +168,28 @@ private:
 protected:
   /// Put the actual lexical analysis in here, not in tokenize
   void processTokens();
+  /**
+    \brief Split the input in chunks at line ends, lex them on separate threads, then fix
+    the tokens at their boundaries. The result is the same as processTokens
+  */
+  void processTokensInChunks(unsigned chunkCount);
+  void skipHashbang() noexcept;
+  /// Check that all parens were closed, and add the TT::FILE_END token
+  void finishTokens();
+  /**
+    \brief Lex tokens until the given position (or past it, if a token crosses it)
+    \param parenStack used to match parens, or nullptr to leave them unmatched
+  */
+  void lexUntil(uint64_t end, std::stack<std::size_t>* parenStack);
+  /// Lex a chunk of the input, never throwing
+  Chunk lexChunk(uint64_t begin, uint64_t end) const;
   
   Lexer(std::string code, std::string sourceOfCode);
-  Lexer(const Lexer&) = default;
+  Lexer(std::unique_ptr<MappedFile> file, std::string sourceOfCode);
+  /// Used for lexing chunks of the input of another Lexer, starting at begin
+  Lexer(const Lexer& whole, uint64_t begin);
+  /// Copies would have dangling token views
+  Lexer(const Lexer&) = delete;
 public:
   /**
     \brief Call to create token list from code
@@ -146,24 +197,73 @@ public:
     \param sourceOfCode where the code came from, used for error messages
   */
   static std::unique_ptr<Lexer> tokenize(std::string code, std::string sourceOfCode);
+  /**
+    \brief Like the other tokenize, but the input is split in chunks that are lexed in parallel
+    \param chunkCount how many chunks (and threads) to use
+  */
+  static std::unique_ptr<Lexer> tokenize(
+    std::string code,
+    std::string sourceOfCode,
+    unsigned chunkCount
+  );
+  /**
+    \brief Create token list from a file, by mapping it in memory
+    
+    The data of the resulting tokens is a view into the mapped file (or into the literal
+    pool of the token store, for processed literals), so they must not outlive this Lexer.
+    \param file what to tokenize; its path is used for error messages
+    \param chunkCount if more than 1, files of at least parallelThreshold bytes are split in
+    this many chunks that are lexed in parallel. Chunks are slower unless they really run at
+    the same time, so this is off by default
+  */
+  static std::unique_ptr<Lexer> tokenizeFile(fs::path file, unsigned chunkCount = 1);
+  /**
+    \brief Prepare to lex some code, without lexing any of it yet
+    
+    Tokens are only produced by calling lexMore, so the input can be consumed a bit at a
+    time, with discardTokensBefore.
+  */
+  static std::unique_ptr<Lexer> open(std::string code, std::string sourceOfCode);
+  /// Like open, but the input is a file that gets mapped in memory \see tokenizeFile
+  static std::unique_ptr<Lexer> openFile(fs::path file);
   
-  inline Token operator[](std::size_t at) const noexcept {
+  /**
+    \brief Lex the next part of the input, adding at least one token
+    \returns false if the input was already done, and nothing was added
+  */
+  bool lexMore();
+  /**
+    \brief Allow the tokens before the given index to be forgotten, since they are no longer
+    needed. The last token can't be discarded, because the ones after it depend on it
+    
+    Tokens are only removed once enough of them pile up, to avoid moving the remaining ones
+    too often. These are renumbered to start from 0.
+    \returns how many tokens were removed
+  */
+  std::size_t discardTokensBefore(std::size_t at);
+  
+  inline Token operator[](std::size_t at) const {
     return tokens[at];
   }
   
   /// Get input code
-  inline const std::string& getCode() const noexcept {
-    return code;
+  inline std::string getCode() const {
+    return std::string(code, codeLength);
+  }
+  
+  /// Get copies of the lexed tokens
+  inline std::vector<Token> getTokens() const {
+    return tokens.toTokens();
   }
   
-  /// Get lexed tokens
-  inline std::vector<Token> getTokens() const noexcept {
+  /// Get lexed tokens, without copying them. They must not outlive this Lexer
+  inline const TokenStore& getTokenStore() const noexcept {
     return tokens;
   }
 
   /// Get total line count
-  inline uint64_t getLineCount() const noexcept {
-    return tokens.empty() ? 0 : currentLine;
+  inline uint64_t getLineCount() const {
+    return tokens.empty() ? 0 : SourceManager::get().getLineCount(fileId);
   }
 
   /// Where the code came from
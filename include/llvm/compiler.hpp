@@ -5,6 +5,7 @@
 #include <llvm/ADT/STLExtras.h>
 #include <llvm/ADT/Triple.h>
 #include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <llvm/Transforms/Utils/Local.h>
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/DerivedTypes.h>
@@ -30,6 +31,7 @@
 #include <string>
 #include <vector>
 #include <stack>
+#include <map>
 #include <unordered_set>
 #include <unordered_map>
 #include <fstream>
@@ -42,6 +44,8 @@
 #include "parser/tokenParser.hpp"
 #include "llvm/typeId.hpp"
 #include "llvm/values.hpp"
+#include "llvm/nameResolver.hpp"
+#include "llvm/narrowedTypes.hpp"
 #include "runtime/runtime.hpp"
 
 class ProgramData {
@@ -52,10 +56,19 @@ public:
   std::unique_ptr<llvm::Module> rootModule;
 };
 
+/// Counts of the type checks that could not be decided from the declared types alone
+struct TypeCheckStats {
+  /// Checks that are still done at runtime
+  std::size_t dynamic = 0;
+  /// Checks that were unnecessary, because the union was known to hold an allowed type
+  std::size_t removed = 0;
+};
+
 /**
   \brief Each ModuleCompiler creates a llvm::Module from an AST.
 */
-class ModuleCompiler: public ASTVisitor, public std::enable_shared_from_this<ModuleCompiler> {
+class ModuleCompiler: public StaticASTVisitor<ModuleCompiler>, public std::enable_shared_from_this<ModuleCompiler> {
+friend class StaticASTVisitor<ModuleCompiler>;
 friend class TypeData;
 friend class TypeInitializer;
 friend class InstanceWrapper;
@@ -74,8 +87,10 @@ private:
   llvm::IntegerType* booleanType;
   llvm::PointerType* functionType;
   llvm::PointerType* voidPtrType;
+  llvm::IntegerType* unionTagType;
   llvm::StructType* taggedUnionType;
   llvm::PointerType* taggedUnionPtrType;
+  llvm::StructType* typeInfoType; ///< An entry of the RTTI table, same as _xyl_TypeInfo
   
   TypeId::Link voidTid;
   TypeId::Link integerTid;
@@ -85,13 +100,38 @@ private:
 
   /// Pointer to global type set
   std::shared_ptr<ProgramData::TypeSet> types;
+  /// Every type list used by the program, each of which is also in types
+  TypeListTable typeLists;
 
   std::unique_ptr<llvm::IRBuilder<>> builder; ///< Used to construct llvm instructions
   llvm::Module* module = nullptr; ///< The module that is being created
   FunctionWrapper::Link entryPoint; ///< Entry point for module
   std::stack<FunctionWrapper::Link> functionStack; ///< Current function stack. Not a call stack
   AST ast; ///< Source AST
-  
+  NameResolver resolver; ///< Binds the identifiers in the AST before they are compiled
+  NarrowedTypes narrowed; ///< What the union variables hold at the code being compiled
+  TypeCheckStats checkStats;
+  /// Union variables whose values never leave their function, so they can point into its stack
+  std::unordered_set<const llvm::Value*> localUnions {};
+  /// Stack slots for the values of local unions that don't fit inline, by union and type index
+  std::unordered_map<llvm::Value*, std::unordered_map<std::size_t, llvm::AllocaInst*>> payloadSlots {};
+  /**
+    \brief The types whose tags are in the code, by id
+    
+    Their tags are given in this order when the module is finished, see assignTypeTags.
+  */
+  std::map<UniqueIdentifier, TypeId::Link> taggedTypes {};
+  /// Runtime type checks, as placeholder calls taking the tag, and the types each one allows
+  std::vector<std::pair<llvm::CallInst*, AbstractId::Link>> pendingTypeChecks {};
+  /// A method call that goes through the vtable
+  struct VirtualCall {
+    llvm::CallInst* call;
+    /// The type of the object the method is called on, as far as the caller knows
+    TypeData* type;
+    uint slot;
+  };
+  /// Method calls that might be devirtualized once all the types are known
+  std::vector<VirtualCall> virtualCalls {};
   
   using CodegenFun = std::function<ValueWrapper::Link(std::vector<ValueWrapper::Link>, Node<ExpressionNode>::Link)>;
   /// Map of codegen funcs for operators
@@ -100,6 +140,8 @@ private:
   bool isRoot;
   
   ModuleCompiler(std::string moduleName, AST, bool isRoot);
+  /// Add the block the statements of main go in, unless it was already added
+  void startRootBlock();
 public:
   /**
     Create a ModuleCompiler.
@@ -115,9 +157,32 @@ public:
   
   /// Compile the AST. Call this before trying to retrieve the module.
   void compile();
+  /**
+    \brief Compile a top-level statement by itself, instead of the whole AST at once
+    
+    The statement is only part of the AST while it is compiled, so it can be freed right
+    after. Call finish once all the statements are done, instead of calling compile.
+  */
+  void compileStatement(ASTNode::Link statement);
+  /// Finish the module after the last statement was compiled
+  void finish();
   
-  /// Store the global RTTI in this module
-  void serializeTypeSet();
+  /**
+    \brief Give tags to the types in taggedTypes, and put them in the code
+    
+    Tags are dense, starting from 0, and given in the order of the types' ids. They only
+    depend on the types the module uses, not on the order they were compiled in, or on
+    what else the process compiled before.
+    \returns the tag of each type, by id
+  */
+  std::unordered_map<UniqueIdentifier, std::size_t> assignTypeTags();
+  /**
+    \brief Store the RTTI table in this module, and register it with the runtime
+    
+    The table is indexed by the tags in unions, and has an entry for every tagged type.
+    Only the root module has it.
+  */
+  void serializeTypeSet(const std::unordered_map<UniqueIdentifier, std::size_t>& tags);
   
   inline llvm::Module* getModule() const noexcept {
     return module;
@@ -130,19 +195,23 @@ public:
   inline std::shared_ptr<ProgramData::TypeSet> getTypeSetPtr() const noexcept {
     return types;
   }
+  
+  inline const TypeCheckStats& getTypeCheckStats() const noexcept {
+    return checkStats;
+  }
 private:
-  void visitExpression(Node<ExpressionNode>::Link node) override;
-  void visitDeclaration(Node<DeclarationNode>::Link node) override;
-  void visitBranch(Node<BranchNode>::Link node) override;
-  void visitLoop(Node<LoopNode>::Link node) override;
-  void visitReturn(Node<ReturnNode>::Link node) override;
-  void visitBlock(Node<BlockNode>::Link node) override;
-  void visitBreakLoop(Node<BreakLoopNode>::Link node) override;
-  void visitFunction(Node<FunctionNode>::Link node) override;
-  void visitType(Node<TypeNode>::Link node) override;
-  void visitConstructor(Node<ConstructorNode>::Link node) override;
-  void visitMethod(Node<MethodNode>::Link node) override;
-  void visitMember(Node<MemberNode>::Link node) override;
+  void visitExpression(ExpressionNode* node);
+  void visitDeclaration(DeclarationNode* node);
+  void visitBranch(BranchNode* node);
+  void visitLoop(LoopNode* node);
+  void visitReturn(ReturnNode* node);
+  void visitBlock(BlockNode* node);
+  void visitBreakLoop(BreakLoopNode* node);
+  void visitFunction(FunctionNode* node);
+  void visitType(TypeNode* node);
+  void visitConstructor(ConstructorNode* node);
+  void visitMethod(MethodNode* node);
+  void visitMember(MemberNode* node);
   
   /// Add a main function to this module
   void addMainFunction();
@@ -152,21 +221,75 @@ private:
   
   /// If the held value is a Boolean or can be converted to one
   bool canBeBoolean(ValueWrapper::Link) const;
-  // TODO: this should not be necessary
-  /// Convert simple value to tagged union with 1 type
-  ValueWrapper::Link boxPrimitive(ValueWrapper::Link p);
+  /// Get a constant string with the type's name, which is only added to the module once
+  llvm::Constant* typeNameString(AbstractId::Link type);
   /// Checks if assignment is allowed. Inserts IR
   void typeCheck(AbstractId::Link, ValueWrapper::Link, Error);
-  /// Inserts a call to the runtime '_xyl_typeErrIfIncompatible' function
-  void insertRuntimeTypeCheck(ValueWrapper::Link target, ValueWrapper::Link);
-  /// Inserts a call to the runtime '_xyl_typeErrIfIncompatibleTid' function
-  void insertRuntimeTypeCheck(AbstractId::Link, ValueWrapper::Link);
-  /// Inserts a call to malloc and returns a pointer with the ValueWrapper's type
-  llvm::Value* insertDynAlloc(uint64_t, ValueWrapper::Link);
-  // Store in the allowed type list field of a union
-  llvm::Value* storeTypeList(llvm::Value* taggedUnion, UniqueIdentifier typeList);
+  /**
+    \brief Get the tag of a type, as a unionTagType
+    
+    It is a placeholder until assignTypeTags replaces it.
+  */
+  llvm::Constant* typeTag(TypeId::Link type);
+  /// Get the tag of the type currently stored in the value, as a unionTagType
+  llvm::Value* loadTypeTag(ValueWrapper::Link value);
+  /// Replace a placeholder from insertRuntimeTypeCheck with a test of the tag against the mask
+  void lowerTypeCheck(
+    llvm::CallInst* placeholder,
+    AbstractId::Link allowed,
+    const std::unordered_map<UniqueIdentifier, std::size_t>& tags
+  );
+  /**
+    \brief Inserts a check that the value's current type is allowed
+    
+    The tag is tested against the allowed type's mask inline. Only if that fails, the runtime
+    '_xyl_typeErr' function is called, which ends the program.
+  */
+  void insertRuntimeTypeCheck(AbstractId::Link allowed, ValueWrapper::Link);
+  /// Inserts a call to malloc and returns a pointer to the given type
+  llvm::Value* insertDynAlloc(uint64_t, llvm::Type*);
+  /**
+    \brief Inserts an alloca at the start of the current function
+    
+    It is allocated once per call, even if the code that uses it is in a loop.
+  */
+  llvm::AllocaInst* createEntryAlloca(llvm::Type* type, const std::string& name);
+  /// Get the stack slot that a local union stores values of this type in, instead of the heap
+  llvm::Value* payloadSlot(llvm::Value* taggedUnion, TypeId::Link type);
+  /**
+    \brief Give a new object storage for its cold members, if its type has any
+    
+    See TypeData::attachColdStorage.
+    \param onStack if the object is on the stack, otherwise its cold members go on the heap
+  */
+  void allocateColdStorage(TypeData* tyData, llvm::Value* object, bool onStack, const std::string& name);
+  /// Copy an object value to a new stack slot, with cold members of its own, and return the slot
+  llvm::Value* ownObject(TypeData* tyData, llvm::Value* data, const std::string& name);
+  /**
+    \brief Where functions put the cold members of the objects of this type that they return
+    
+    A function's stack slots don't outlive it, so the caller copies the cold members from here
+    before anything else can be called, see callResult.
+  */
+  llvm::GlobalVariable* returnedColdStorage(TypeData* tyData);
+  /// Wrap what a call returned, copying returned objects to storage owned by the caller
+  ValueWrapper::Link callResult(llvm::Value* result, AbstractId::Link ty);
+  /// If values of this type are stored in the union itself, instead of being pointed to
+  bool fitsInUnion(llvm::Type* type) const;
+  /// Get a pointer to the data of a union, which holds a value of the given type
+  llvm::Value* unionDataPtr(llvm::Value* taggedUnion, llvm::Type* dataType);
+  /**
+    \brief Store a value and its type's tag in a union
+    \param onStack if the union doesn't escape its function, so values that don't fit inline can
+    be kept in a stack slot instead of being allocated on the heap
+  */
+  void storeInUnion(llvm::Value* taggedUnion, ValueWrapper::Link value, bool onStack = false);
   // Update all required fields in a union when assigning a new value
   void assignToUnion(ValueWrapper::Link to, ValueWrapper::Link from);
+  /// If the value is a union that is known to hold a single type here, read it as that type
+  ValueWrapper::Link readNarrowed(ValueWrapper::Link value);
+  /// Forget what is known about the variables the code might assign to
+  void forgetAssignedIn(ASTNode* node);
   /**
     \brief Creates a pointer pointing to a specific function's argument
     
@@ -179,9 +302,11 @@ private:
     std::size_t which
   );
   /// Gets the llvm:Type* to be allocated for the given type info
-  llvm::Type* typeFromInfo(TypeInfo ti, ASTNode::Link node);
+  llvm::Type* typeFromInfo(TypeInfo ti, const ASTNode* node);
   /// Gets an id for the given type info
-  AbstractId::Link typeIdFromInfo(TypeInfo ti, ASTNode::Link node);
+  AbstractId::Link typeIdFromInfo(TypeInfo ti, const ASTNode* node);
+  /// Gets the id of a single type by its name, looking in the blocks above the node
+  TypeId::Link typeIdFromName(Symbol name, const ASTNode* node);
   /// How to handle an identifier in compileExpression
   enum IdentifierHandling {
     AS_POINTER, ///< Return a pointer
@@ -189,12 +314,14 @@ private:
   };
   /// Gets a ValueWrapper for an ExpressionNode containing an identifier
   ValueWrapper::Link valueFromIdentifier(Node<ExpressionNode>::Link identifier);
+  /// Compile an ExpressionNode that has no operands
+  ValueWrapper::Link compileTerminal(Node<ExpressionNode>::Link node);
   /// Implementation detail of visitExpression
   ValueWrapper::Link compileExpression(Node<ExpressionNode>::Link node, IdentifierHandling how = AS_VALUE);
   /// Implementation detail of visitBranch
-  void compileBranch(Node<BranchNode>::Link node, llvm::BasicBlock* surrounding = nullptr);
+  void compileBranch(BranchNode* node);
   /// Implementation detail of visitBlock
-  llvm::BasicBlock* compileBlock(Node<BlockNode>::Link node, const std::string& name);
+  llvm::BasicBlock* compileBlock(BlockNode* node, const std::string& name);
   
   // Codegen stuff
   
@@ -305,6 +432,37 @@ private:
   ValueWrapper::Link shiftRight(std::vector<ValueWrapper::Link> ops, Node<ExpressionNode>::Link node);
   /// Is a CodegenFun that creates a call
   ValueWrapper::Link call(std::vector<ValueWrapper::Link> ops, Node<ExpressionNode>::Link node);
+  /// Type check the arguments of a call, and get what to pass to CreateCall
+  std::vector<llvm::Value*> callArguments(
+    const FunctionSignature& sig,
+    const std::vector<ValueWrapper::Link>& ops,
+    const std::string& name,
+    Node<ExpressionNode>::Link node
+  );
+  /// Gets the id of what a function with this signature returns
+  AbstractId::Link returnTypeOf(const FunctionSignature& sig, const ASTNode* node);
+  /// The arguments of a method call on the right of a member access, or none for a member
+  NodeSpan<ASTNode> methodArguments(Node<ExpressionNode>::Link access);
+  /// Is a CodegenFun that gets a member of an object, or calls one of its methods
+  ValueWrapper::Link memberAccess(std::vector<ValueWrapper::Link> ops, Node<ExpressionNode>::Link node);
+  /**
+    \brief Call a method of an object
+    
+    If the object is known to be of exactly its type, the method is called directly.
+    Otherwise, it is called through the vtable, and devirtualize might make that direct later.
+    \param object pointer to the object
+    \param exact if the object is known to be of exactly the type of tyData, see ValueWrapper::exactType
+    \param call the node of the call, whose second child is the method's name
+  */
+  ValueWrapper::Link callMethod(
+    TypeData* tyData,
+    llvm::Value* object,
+    bool exact,
+    std::vector<ValueWrapper::Link> args,
+    Node<ExpressionNode>::Link call
+  );
+  /// Call the methods directly where no subtype overrides them
+  void devirtualize();
   /// Is a CodegenFun that creates an assignment
   ValueWrapper::Link assignment(std::vector<ValueWrapper::Link> ops, Node<ExpressionNode>::Link node);
 };
@@ -0,0 +1,152 @@
+#ifndef NAME_RESOLVER_HPP
+#define NAME_RESOLVER_HPP
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "utils/util.hpp"
+#include "utils/error.hpp"
+#include "ast.hpp"
+#include "llvm/values.hpp"
+
+/**
+  \brief What an identifier refers to
+
+  There is one for each declaration, function, argument and member, shared by all the
+  identifiers that refer to it.
+*/
+struct NameBinding {
+  enum Kind {
+    VARIABLE, ///< A DeclarationNode
+    FUNCTION, ///< A FunctionNode
+    ARGUMENT, ///< An argument of the innermost function
+    MEMBER ///< A member of the type whose constructor or method the identifier is in
+  };
+
+  Kind kind;
+  Symbol name;
+  /// The declaration, the function (for ARGUMENT) or the type (for MEMBER)
+  ASTNode* node;
+  /// For ARGUMENT, the position of the argument in the compiled function, after 'this'
+  std::size_t argument = 0;
+  /// For VARIABLE and FUNCTION, set by ModuleCompiler once the declaration is compiled
+  ValueWrapper::Link value = nullptr;
+  /// How many functions the declaration is nested in
+  std::size_t depth = 0;
+  /**
+    \brief For VARIABLE, if its value can be copied somewhere that outlives it
+    
+    This is the case when it is stored in another variable or member, returned, passed to a
+    function, or used from another function.
+  */
+  bool escapes = false;
+
+  NameBinding(Kind kind, Symbol name, ASTNode* node) noexcept:
+    kind(kind), name(name), node(node) {}
+};
+
+/**
+  \brief Binds every identifier to what it refers to, before codegen
+
+  An identifier is looked up in the arguments of the innermost function, then in the
+  variables and functions of each enclosing block, innermost first, then in the members of
+  the type whose constructor or method it is in. Declarations are only visible after them,
+  in the same order ModuleCompiler compiles the code in.
+
+  Like the other passes over the tree, it doesn't recurse into children, because trees can be
+  very deep.
+*/
+class NameResolver: public StaticASTVisitor<NameResolver> {
+  friend class StaticASTVisitor<NameResolver>;
+private:
+  using Names = std::unordered_map<Symbol, NameBinding*>;
+
+  struct BlockScope {
+    Names variables;
+    Names functions;
+    /// Names of the members of each type, including the inherited ones
+    std::unordered_map<Symbol, std::vector<Symbol>> typeMembers;
+  };
+  struct FunctionScope {
+    Names arguments;
+    /// For constructors and methods, the members of their type
+    const Names* members;
+  };
+  /// Something to do after the children of a node were resolved
+  enum class Exit {
+    NONE, ///< Not an exit, resolve the node
+    BLOCK,
+    FUNCTION,
+    TYPE
+  };
+  struct Task {
+    ASTNode* node;
+    Exit exit;
+  };
+
+  /// All the bindings, which must outlive the nodes for top-level statements
+  std::deque<NameBinding> bindings {};
+  std::vector<BlockScope> blocks {};
+  std::vector<FunctionScope> functions {};
+  /// Members of the types being resolved
+  std::deque<Names> types {};
+  /// What remains to be done, in reverse order
+  std::vector<Task> pending {};
+  /// What the current visit function scheduled, in order
+  std::vector<Task> scheduled {};
+  /// If statements are resolved one at a time
+  bool streamed = false;
+
+  NameBinding* makeBinding(NameBinding::Kind kind, Symbol name, ASTNode* node);
+  /// Find what a name refers to from the current position, or nullptr
+  NameBinding* lookup(Symbol name) const;
+
+  /// Start the root block's scope, with what the compiler already put in it
+  void enterRoot(BlockNode* root);
+  /// Mark the variable as escaping if this use of it can copy its value
+  void checkEscape(NameBinding* binding, ExpressionNode* use) const;
+  /// Find the member names of a type from the current position, or nullptr
+  const std::vector<Symbol>* lookupMembers(Symbol type) const;
+
+  inline void schedule(ASTNode* node) {
+    scheduled.push_back({node, Exit::NONE});
+  }
+  inline void scheduleExit(Exit exit) {
+    scheduled.push_back({nullptr, exit});
+  }
+  /**
+    \brief Resolve the code of a function, constructor or method, with its arguments in scope
+    \param hasThis if the compiled function takes 'this' before its other arguments
+    \param members what the members of the enclosing type are, if they are visible
+  */
+  void enterFunction(FunctionNode* node, bool hasThis, const Names* members);
+  /// Resolve everything pending
+  void run();
+
+  void visitExpression(ExpressionNode* node);
+  void visitDeclaration(DeclarationNode* node);
+  void visitBranch(BranchNode* node);
+  void visitLoop(LoopNode* node);
+  void visitReturn(ReturnNode* node);
+  void visitBlock(BlockNode* node);
+  void visitBreakLoop(BreakLoopNode* node);
+  void visitFunction(FunctionNode* node);
+  void visitType(TypeNode* node);
+  void visitConstructor(ConstructorNode* node);
+  void visitMethod(MethodNode* node);
+  void visitMember(MemberNode* node);
+public:
+  /// Resolve a whole tree
+  void resolve(BlockNode* root);
+  /**
+    \brief Resolve a statement as if it was the next one in the root block
+
+    The root block's scope is kept between calls, so statements see what the ones before
+    them declared.
+  */
+  void resolveStatement(BlockNode* root, ASTNode* statement);
+};
+
+#endif
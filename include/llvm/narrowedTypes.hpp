@@ -0,0 +1,57 @@
+#ifndef NARROWED_TYPES_HPP
+#define NARROWED_TYPES_HPP
+
+#include <unordered_map>
+
+#include "llvm/typeId.hpp"
+#include "llvm/values.hpp"
+
+/**
+  \brief What single type each union variable is known to hold, at some point in the code
+
+  ModuleCompiler updates this as it compiles, in the order the code runs in. Assigning to a
+  union records the assigned type; where control flow merges, only what is known on every
+  path is kept. Facts are tied to the function they were found in, since a function's code
+  can run from anywhere.
+*/
+class NarrowedTypes {
+private:
+  struct Fact {
+    /// Kept alive, so another variable can't reuse its address while this is known
+    ValueWrapper::Link var;
+    TypeId::Link type;
+    const llvm::Function* function;
+
+    inline bool operator==(const Fact& rhs) const noexcept {
+      return *type == *rhs.type && function == rhs.function;
+    }
+  };
+
+  std::unordered_map<const ValueWrapper*, Fact> facts {};
+public:
+  /// \returns the type the variable holds in the given function, or nullptr if it isn't known
+  inline TypeId::Link get(const ValueWrapper* var, const llvm::Function* function) const {
+    auto it = facts.find(var);
+    if (it == facts.end() || it->second.function != function) return nullptr;
+    return it->second.type;
+  }
+  inline void set(ValueWrapper::Link var, TypeId::Link type, const llvm::Function* function) {
+    facts[var.get()] = {var, type, function};
+  }
+  inline void forget(const ValueWrapper* var) {
+    facts.erase(var);
+  }
+  inline void forgetAll() {
+    facts.clear();
+  }
+  /// Keep only the facts that are also known in the other one
+  inline void join(const NarrowedTypes& other) {
+    for (auto it = facts.begin(); it != facts.end();) {
+      auto otherIt = other.facts.find(it->first);
+      if (otherIt == other.facts.end() || !(otherIt->second == it->second)) it = facts.erase(it);
+      else ++it;
+    }
+  }
+};
+
+#endif
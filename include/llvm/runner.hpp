@@ -13,8 +13,9 @@
 /// Maps runtime function names to pointers to those functions.
 const std::unordered_map<std::string, void*> nameToFunPtr {
   {"printC", reinterpret_cast<void*>(printC)},
-  {"_xyl_typeErrIfIncompatible", reinterpret_cast<void*>(_xyl_typeErrIfIncompatible)},
-  {"_xyl_typeErrIfIncompatibleTid", reinterpret_cast<void*>(_xyl_typeErrIfIncompatibleTid)},
+  {"_xyl_typeErr", reinterpret_cast<void*>(_xyl_typeErr)},
+  {"_xyl_registerTypes", reinterpret_cast<void*>(_xyl_registerTypes)},
+  {"_xyl_typeOf", reinterpret_cast<void*>(_xyl_typeOf)},
 };
 
 /// exit code + stdout + stderr
@@ -6,6 +6,7 @@
 
 namespace llvm {
   class FunctionType;
+  class GlobalVariable;
 }
 
 class ModuleCompiler;
@@ -25,6 +26,8 @@ public:
   DefiniteTypeInfo getTypeInfo() const;
   llvm::Type* getAllocaType() const;
   std::string getName() const;
+  /// If it is kept in the type's side allocation, instead of in the object itself
+  bool isCold() const;
   bool hasInit() const;
   Node<ExpressionNode>::Link getInit() const;
   Node<MemberNode>::Link getNode() const;
@@ -132,14 +135,64 @@ private:
     bool exists() const;
   };
   
+  /// A method that can be called through the vtable
+  struct VirtualMethod {
+    /// What is called for objects of this type
+    MethodData::Link impl;
+    /// Type of the method that added the slot, which is how the slot is called
+    llvm::FunctionType* type;
+  };
+  
+  /// A cold block that objects of this type point to, their own or one of their members'
+  struct ColdBlock {
+    using Steps = std::vector<std::pair<llvm::StructType*, std::vector<uint>>>;
+    /// The coldType of the type whose cold members are in the block
+    llvm::StructType* type;
+    /**
+      \brief How to get to the pointer to the block, from the object
+      
+      Each step is a struct and the field indices to follow in it. The first step starts at
+      the object, the next ones in the cold block the previous step's pointer points to.
+    */
+    Steps steps;
+  };
+  
   /// Pointer to the owning ModuleCompiler
   std::shared_ptr<ModuleCompiler> mc;
   /// Pointer to the TypeNode where this type was defined
   Node<TypeNode>::Link node;
   /// llvm::Type of the llvm struct for this type
   llvm::StructType* dataType;
+  /// The type this one inherits from, which is the first field of dataType. Can be null
+  TypeData* parent = nullptr;
+  /// The types that inherit from this one
+  std::vector<TypeData*> subtypes;
+  /**
+    \brief The type whose struct holds the vtable pointer, this one or an ancestor
+    
+    It is the first type in the hierarchy that has methods, so null if there are none.
+  */
+  TypeData* vtableOwner = nullptr;
+  /// Field of vtableOwner's struct that points to the vtable
+  uint vtableField = 0;
+  /// Every method that can be called on this type, inherited ones first
+  std::vector<VirtualMethod> vtableSlots;
+  /// Constant array of pointers to the implementations in vtableSlots
+  llvm::GlobalVariable* vtable = nullptr;
+  /// Struct for the cold members, which the object points to. Null if there are none
+  llvm::StructType* coldType = nullptr;
+  /// Field of dataType that points to the cold members
+  uint coldField = 0;
   /// Metadata for normal members of this type
   std::vector<MemberMetadata::Link> members;
+  /// Field of each member, in the same order as members. Cold members are fields of coldType
+  std::vector<uint> fieldIndices;
+  /// Type of each member that is an object, in the same order as members. Null for other members
+  std::vector<TypeData*> memberTypes;
+  /// Every cold block that objects of this type point to, outer blocks before the ones in them
+  std::vector<ColdBlock> coldBlocks;
+  /// Struct made of the blocks in coldBlocks. Null if there are none
+  llvm::StructType* coldStorageType = nullptr;
   /// Metadata for static members of this type
   std::vector<MemberMetadata::Link> staticMembers;
   /// List of methods
@@ -159,6 +212,14 @@ private:
   inline std::string nameFrom(std::string prefix, std::string nameOfThing) {
     return fmt::format("{0}_{1}_{2}", prefix, node->getName(), nameOfThing);
   }
+  /// The fields before the members: the parent's struct, then the vtable pointer if it goes here
+  std::vector<llvm::Type*> getLeadingTypes() const;
+  /// Fill vtableSlots and create the vtable
+  void buildVtable();
+  /// Add the cold blocks of the object that the steps lead to, which has this type
+  void addColdBlocks(std::vector<ColdBlock>& blocks, ColdBlock::Steps steps) const;
+  /// Get a pointer to where the object points to the cold block
+  llvm::Value* coldPointerIn(llvm::Value* object, const ColdBlock& block);
 public:
   /**
     \brief Create a TypeData
@@ -175,12 +236,67 @@ public:
   llvm::StructType* getStructTy() const;
   /// Get the name of this type
   TypeName getName() const;
+  /// Get the type this one inherits from, or nullptr
+  TypeData* getParent() const;
+  /// Make this type inherit from another, before any members are added
+  void setParent(TypeData* parent);
+  /// If it has a member with this name, including inherited members
+  bool hasMember(std::string name) const;
+  /// The vtable slot of the method with this name, or -1 if there is no such method
+  int findSlot(std::string name) const;
+  /// \copydoc VirtualMethod
+  const VirtualMethod& getSlot(uint slot) const;
+  /**
+    \brief If a subtype of this one, or theirs, calls something else for this slot
+    
+    Only meaningful once all the types of the module were finalized.
+  */
+  bool isOverridden(uint slot) const;
+  /// Load the vtable slot's function from an object of this type, as a pointer of the slot's type
+  llvm::Value* loadFromVtable(llvm::Value* object, uint slot);
   /// Get initializer
   TypeInitializer getInit() const;
   /// Get static initializer
   TypeInitializer getStaticInit() const;
-  /// Gets a list of types so we know what to allocate for the struct
+  /// Gets a list of types so we know what to allocate for the struct, in declaration order
   std::vector<llvm::Type*> getAllocaTypes() const;
+  /**
+    \brief Add the body of the struct, once all the members were added
+    
+    Fields are sorted by alignment, largest first, so no padding is needed between them.
+    Cold members are moved to a struct of their own, see attachColdStorage.
+  */
+  void layOut();
+  /// Bytes allocated for each object, not counting the cold members
+  uint64_t getSize() const;
+  /// Bytes allocated for the cold members of each object
+  uint64_t getColdSize() const;
+  /// Bytes each object would take with all its members in declaration order
+  uint64_t getDeclaredSize() const;
+  /**
+    \brief Struct with storage for every cold block an object of this type points to
+    
+    That includes the blocks of its ancestors, and of its members that are objects.
+    Null if objects of this type have no cold members.
+  */
+  llvm::StructType* getColdStorageType() const;
+  /**
+    \brief Point a new object to the storage for its cold members
+    
+    The storage must live as long as the object, so whatever allocates the object also
+    allocates its cold storage, before the normal initializer is called.
+    \param object pointer to the object
+    \param storage pointer to a struct of type getColdStorageType
+  */
+  void attachColdStorage(llvm::Value* object, llvm::Value* storage);
+  /**
+    \brief Store a copy of an object, which keeps its own cold members
+    
+    The values of the original's cold members are copied into the storage dest already points to.
+    \param data the object being copied, as a value
+    \param dest pointer to an object whose cold members were allocated
+  */
+  void storeCopy(llvm::Value* data, llvm::Value* dest);
   /// Check if this name isn't already used for something else
   void validateName(std::string name) const;
   /// Add a new member to the type
@@ -193,6 +309,7 @@ public:
     \brief Signal that this type is completely built, and can be instantiated
     
     This does a couple things:
+    - Fills the vtable
     - Adds codegen functions to initializers
     - Finalizes both initializers
     - Adds the bodies of non-static, non-foreign methods
@@ -2,7 +2,10 @@
 #define TYPEID_HPP
 
 #include <memory>
+#include <vector>
+#include <cstdint>
 #include <unordered_set>
+#include <unordered_map>
 
 #include "utils/util.hpp"
 #include "utils/error.hpp"
@@ -21,29 +24,100 @@ enum TypeCompat {
   DYNAMIC = 1 << 5, ///< Cannot statically determine compatibility
 };
 
+/**
+  \brief A set of types, as one bit for the index of each TypeId
+
+  The first 64 types fit in a single word, which is enough for most programs, so checking
+  if two sets intersect is usually a single AND. Later types are kept in extra words.
+*/
+class TypeMask {
+public:
+  static constexpr std::size_t wordBits = 64;
+private:
+  uint64_t first = 0;
+  std::vector<uint64_t> rest {};
+public:
+  TypeMask() = default;
+
+  inline void set(std::size_t index) {
+    if (index < wordBits) {
+      first |= uint64_t(1) << index;
+      return;
+    }
+    auto word = index / wordBits - 1;
+    if (word >= rest.size()) rest.resize(word + 1, 0);
+    rest[word] |= uint64_t(1) << (index % wordBits);
+  }
+  inline bool test(std::size_t index) const noexcept {
+    return (getWord(index / wordBits) >> (index % wordBits)) & 1;
+  }
+  inline bool intersects(const TypeMask& rhs) const noexcept {
+    if (first & rhs.first) return true;
+    auto common = std::min(rest.size(), rhs.rest.size());
+    for (std::size_t i = 0; i < common; i++) {
+      if (rest[i] & rhs.rest[i]) return true;
+    }
+    return false;
+  }
+  inline TypeMask& operator|=(const TypeMask& rhs) {
+    first |= rhs.first;
+    if (rest.size() < rhs.rest.size()) rest.resize(rhs.rest.size(), 0);
+    for (std::size_t i = 0; i < rhs.rest.size(); i++) rest[i] |= rhs.rest[i];
+    return *this;
+  }
+
+  /// \returns how many words are needed to store this mask, at least 1
+  inline std::size_t wordCount() const noexcept {
+    auto count = rest.size();
+    while (count > 0 && rest[count - 1] == 0) count--;
+    return count + 1;
+  }
+  /// \returns the bits for the indices [word * 64, word * 64 + 63]
+  inline uint64_t getWord(std::size_t word) const noexcept {
+    if (word == 0) return first;
+    return word - 1 < rest.size() ? rest[word - 1] : 0;
+  }
+
+  inline bool operator==(const TypeMask& rhs) const noexcept {
+    auto count = wordCount();
+    if (count != rhs.wordCount()) return false;
+    for (std::size_t i = 0; i < count; i++) {
+      if (getWord(i) != rhs.getWord(i)) return false;
+    }
+    return true;
+  }
+  inline bool operator!=(const TypeMask& rhs) const noexcept {
+    return !operator==(rhs);
+  }
+};
+
 /**
   \brief An abstract identifier with a name and a unique id.
 */
 class AbstractId {
 public:
   using Link = std::shared_ptr<AbstractId>;
-private:
-  /**
-    The values returned by this function MUST be unique (until max int value is hit).
-    Otherwise, there are no requirements on the value of the number.
-  */
-  static inline UniqueIdentifier generateId() {
-    static UniqueIdentifier lastId = 100;
-    lastId += 1;
-    return lastId;
-  }
 protected:
   /// Name of the this type
   TypeName name;
+  /// Names of the stored types, kept since types are looked up by them
+  TypeList names;
+  /// Indices of the stored types
+  TypeMask mask;
   /// Constant numeric unique id
-  const UniqueIdentifier id = generateId();
+  const UniqueIdentifier id;
+  
+  /**
+    \brief Get the id for a fully qualified name
+
+    Ids are a stable hash of the name, so they don't depend on the order types are created
+    in, or on which thread creates them. The same name always gets the same id. If two names
+    hash to the same value, the one registered second is moved to the next free id. Ids are
+    never 0, which terminates RTTI arrays.
+  */
+  static UniqueIdentifier idFor(const TypeName& qualifiedName);
   
-  AbstractId() = default;
+  AbstractId(TypeName name): name(name), id(idFor(name)) {}
   AbstractId(const AbstractId&) = default;
   virtual ~AbstractId() {}
 public:
@@ -57,7 +131,13 @@ public:
   /// \returns how many types are stored by this identifier
   virtual std::size_t storedTypeCount() const noexcept = 0;
   /// \returns names of the types stored by this identifier
-  virtual TypeList storedNames() const noexcept = 0;
+  inline const TypeList& storedNames() const noexcept {
+    return names;
+  }
+  /// \returns the set of types stored by this identifier
+  inline const TypeMask& getMask() const noexcept {
+    return mask;
+  }
   /// \returns what should llvm allocate for this id
   virtual llvm::Type* getAllocaType() const noexcept = 0;
   /// \returns if the parameter can be assigned to this id
@@ -120,6 +200,15 @@ private:
   */
   llvm::Type* basicTy = nullptr;
   TypeData* tyData = nullptr;
+  /// Dense index of this type, its bit in every TypeMask
+  std::size_t index;
+
+  /**
+    Indices are consecutive, starting from 0, so masks stay small. They are given in the
+    order names are first seen by the process, so they are only used while compiling; tags
+    in the generated code are given by the module, see ModuleCompiler::assignTypeTags.
+  */
+  static std::size_t indexFor(const TypeName& qualifiedName);
 protected:
   TypeId(TypeData* tyData);
   TypeId(TypeName, llvm::Type*);
@@ -134,14 +223,14 @@ public:
     return tyData;
   }
   
+  inline std::size_t getIndex() const noexcept {
+    return index;
+  }
+  
   inline std::size_t storedTypeCount() const noexcept override {
     return 1;
   }
 
-  inline TypeList storedNames() const noexcept override {
-    return {name};
-  }
-  
   llvm::Type* getAllocaType() const noexcept override;
   TypeCompat isCompat(AbstractId::Link) const noexcept override;
 };
@@ -170,11 +259,28 @@ public:
     return types.size();
   }
   
-  TypeList storedNames() const noexcept override;
   llvm::Type* getAllocaType() const noexcept override;
   TypeCompat isCompat(AbstractId::Link) const noexcept override;
 };
 
+/**
+  \brief Canonical type lists, so each set of types has a single TypeListId
+
+  Lists are found by their types sorted by id, so the order the types were written in
+  doesn't matter.
+*/
+class TypeListTable {
+private:
+  std::unordered_map<std::vector<AbstractId::Link>, TypeListId::Link> lists {};
+public:
+  /// Get the list of some types, creating it the first time it is needed
+  TypeListId::Link get(std::vector<AbstractId::Link> types, llvm::StructType* taggedUnionType);
+  
+  inline std::size_t size() const noexcept {
+    return lists.size();
+  }
+};
+
 // TODO class AliasId: public AbstractId
 
 #endif
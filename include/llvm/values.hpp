@@ -15,8 +15,15 @@ public:
   
   llvm::Value* val;
   AbstractId::Link ty;
+  /**
+    \brief If the value is an object of exactly the type ty, and not of one of its subtypes
+    
+    Methods of such objects are called directly, instead of through the vtable.
+  */
+  bool exactType;
   
-  ValueWrapper(llvm::Value* val, AbstractId::Link ty) noexcept: val(val), ty(ty) {}
+  ValueWrapper(llvm::Value* val, AbstractId::Link ty, bool exactType = false) noexcept:
+    val(val), ty(ty), exactType(exactType) {}
   
   virtual ~ValueWrapper() {}
   
@@ -30,6 +37,24 @@ public:
   }
 };
 
+/**
+  \brief Holds what a union variable is known to hold, read as that single type
+*/
+class NarrowedWrapper: public ValueWrapper {
+public:
+  using Link = std::shared_ptr<NarrowedWrapper>;
+private:
+  AbstractId::Link declared;
+public:
+  NarrowedWrapper(llvm::Value* val, TypeId::Link current, AbstractId::Link declared) noexcept:
+    ValueWrapper(val, current), declared(declared) {}
+  
+  /// \returns the type list the variable was declared with
+  inline AbstractId::Link getDeclaredType() const noexcept {
+    return declared;
+  }
+};
+
 /**
   \brief Holds a llvm::Function* and its respective FunctionSignature
 */
@@ -55,6 +80,8 @@ public:
 private:
   /// Maps member names to their declaration
   std::map<std::string, ValueWrapper::Link> members {};
+  /// The part of the object that belongs to the parent type, for inherited members
+  Link base = nullptr;
 public:
   InstanceWrapper(llvm::Value*, TypeId::Link current);
   
@@ -2,6 +2,7 @@
 #define OPERATOR_HPP
 
 #include <string>
+#include <array>
 #include <vector>
 #include <unordered_set>
 #include <algorithm>
@@ -49,6 +50,16 @@ public:
   using Index = std::size_t;
   /// If true, require that the operand at a specific index in this list can be mutated
   using RequireReferenceList = std::vector<bool>;
+  
+  /// Result of Operator::matchSymbol
+  struct SymbolMatch {
+    /// Length of the matched symbol, 0 if nothing matched
+    std::size_t length = 0;
+    /// Operators that have the matched symbol, in Operator::list order
+    std::array<Index, 2> candidates {{0, 0}};
+    /// How many of the candidates are valid
+    std::size_t candidateCount = 0;
+  };
 private:
   /// \copydoc Symbol
   Symbol symbol;
@@ -105,6 +116,15 @@ public:
   
   /// Find an Operator::Index from an Operator::Name
   static Index find(Name name);
+  
+  /**
+    \brief Find the operators with the longest symbol that the input starts with.
+    
+    Takes time proportional to the symbol's length, and does not allocate.
+    \param begin start of the input
+    \param end past the last character of the input
+  */
+  static SymbolMatch matchSymbol(const char* begin, const char* end) noexcept;
 };
 
 #endif
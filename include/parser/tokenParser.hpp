@@ -5,47 +5,52 @@
 #include <vector>
 #include <stack>
 #include <algorithm>
+#include <functional>
 
 #include "utils/util.hpp"
 #include "utils/error.hpp"
 #include "ast.hpp"
 #include "token.hpp"
+#include "tokenStore.hpp"
 #include "operator.hpp"
+#include "lexer.hpp"
 
 /**
   \brief Parses a list of tokens, and produces an AST.
 */
 class TokenParser {
 private:
-  std::vector<Token> input;
-  std::size_t pos = 0;
+  TokenCursor input;
   
-  /// Get token at current position
-  inline Token current() {
-    return input[pos];
+  /// Get a copy of the token at current position
+  inline Token current() const {
+    return input.current();
+  }
+  inline Trace currentTrace() const noexcept {
+    return input.trace();
+  }
+  inline TokenText currentData() const {
+    return input.text();
   }
   /// Skip a number of tokens, usually just advances to the next one
   inline void skip(int skipped = 1) {
-    pos = pos + static_cast<std::size_t>(skipped);
-    if (pos >= input.size()) pos = input.size() - 1;
+    input.skip(static_cast<std::size_t>(skipped));
   }
   /// Accept a TokenType
-  inline bool accept(TokenType tok) {
-    return tok == current().type;
+  inline bool accept(TokenType tok) const noexcept {
+    return tok == input.type();
   }
   /// Accept a Operator::Symbol
-  inline bool accept(Operator::Symbol operatorSymbol) {
-    if (!current().isOp()) return false;
-    if (current().op().hasSymbol(operatorSymbol)) return true;
-    return false;
+  inline bool accept(Operator::Symbol operatorSymbol) const {
+    return input.isOp() && input.op().hasSymbol(operatorSymbol);
   }
   /// Accept a Fixity
-  inline bool accept(Fixity fixity) {
-    return current().isOp() && current().op().hasFixity(fixity);
+  inline bool accept(Fixity fixity) const noexcept {
+    return input.isOp() && input.op().hasFixity(fixity);
   }
   /// Accept only terminals
-  inline bool acceptTerminal() {
-    return current().isTerminal();
+  inline bool acceptTerminal() const noexcept {
+    return TT::isTerminal(input.type());
   }
   /// Accept anything that ends an expression
   inline bool acceptEndOfExpression() {
@@ -56,8 +61,8 @@ private:
     if (accept(tok)) {
       return true;
     } else {
-      auto currentData = current().isOp() ? current().op().getSymbol() : current().data;
-      throw "{0} (found: {1})"_syntax(errorMessage, currentData) + current().trace;
+      auto found = input.isOp() ? input.op().getSymbol() : currentData().str();
+      throw "{0} (found: {1})"_syntax(errorMessage, found) + currentTrace();
     }
   }
   /// Expect a semicolon \see expect
@@ -70,21 +75,38 @@ private:
   
   /// Creates an ExpressionNode from the current Token
   Node<ExpressionNode>::Link exprFromCurrent();
-  /// Parse the stuff inside () or [] or calls
-  Node<ExpressionNode>::Link parseCircumfixGroup(Token begin);
-  /// Parse postfix ops in primaries
-  Node<ExpressionNode>::Link parsePostfix(Node<ExpressionNode>::Link terminal);
-  /**
-    \brief Parse a primary in the expression
+  /// Binary operators that are waiting for their right operand, and the unfinished primary
+  struct PendingExpression {
+    /// Binary operators that only have their left operand
+    std::vector<Node<ExpressionNode>::Link> operators {};
+    /// Prefix operators in front of the current primary
+    Node<ExpressionNode>::Link prefixes = nullptr;
+    /// The innermost of the prefixes, which gets the rest of the primary as its operand
+    Node<ExpressionNode>::Link lastPrefix = nullptr;
+    /// The current primary, without prefix or postfix operators
+    Node<ExpressionNode>::Link terminal = nullptr;
+    /// The postfix operators and calls applied to the terminal so far
+    Node<ExpressionNode>::Link postfixes = nullptr;
+    /// If the group being parsed holds call arguments, this is the call
+    Node<ExpressionNode>::Link call = nullptr;
+    /// Where to continue after the group being parsed
+    TokenCursor after;
+    bool throwIfEmpty;
     
-    Example of empty expressions: "" or ";"
-    \returns an ExpressionNode, or nullptr if the expression is empty (terminates immediately)
-  */
-  Node<ExpressionNode>::Link parseExpressionPrimary();
-  /// Implementation detail of expression, only exists to allow recursion.
-  Node<ExpressionNode>::Link expressionImpl(Node<ExpressionNode>::Link lhs, int minPrecedence);
+    PendingExpression(TokenCursor after, bool throwIfEmpty):
+      after(std::move(after)), throwIfEmpty(throwIfEmpty) {}
+  };
+  /// Attach a postfix operator or a call to the current primary
+  void addPostfix(PendingExpression& expr, Node<ExpressionNode>::Link postfix);
+  /// Split the comma tree inside the parens of a call into its arguments
+  void addCallArguments(Node<ExpressionNode>::Link call, Node<ExpressionNode>::Link insideCall);
   /**
     \brief Parse an expression starting at the current token
+    
+    Circumfix groups are parsed in place, as separate expressions, and the expressions
+    around them wait on an explicit stack instead of the call stack. Neither nesting nor
+    operator chains make this recurse, so the depth of an expression is only limited by
+    memory.
     \param throwIfEmpty throws an error on empty expressions; if set to false, empty expressions return nullptr
   */
   Node<ExpressionNode>::Link expression(bool throwIfEmpty = true);
@@ -138,7 +160,7 @@ private:
   
   Node<ConstructorNode>::Link constructor(Visibility, bool isForeign);
   Node<MethodNode>::Link method(Visibility, bool isStatic, bool isForeign);
-  Node<MemberNode>::Link member(Visibility, bool isStatic);
+  Node<MemberNode>::Link member(Visibility, bool isStatic, bool isCold);
   Node<TypeNode>::Link type();
 
   // Statements
@@ -149,12 +171,24 @@ private:
   */
   ASTNode::Link statement();
 
-  inline TokenParser() {}
+  inline TokenParser(const TokenStore& input): input(input) {}
+  inline TokenParser(TokenCursor input): input(std::move(input)) {}
 public:
   /**
     \brief Turn a list of tokens into an AST
   */
-  static AST parse(std::vector<Token> input);
+  static AST parse(const TokenStore& input);
+  /// \copydoc parse(const TokenStore&)
+  static AST parse(const std::vector<Token>& input);
+  /**
+    \brief Parse the top-level statements of some code one at a time, instead of making an AST
+    
+    Tokens are requested from the lexer only when they are needed, and each statement is
+    passed to the callback as soon as it is complete. The tokens before it are discarded, so
+    only about one statement is held in memory at once.
+    \param lexer made with Lexer::open or Lexer::openFile
+  */
+  static void parseStatements(Lexer& lexer, std::function<void(ASTNode::Link)> onStatement);
 };
 
 #endif
@@ -7,6 +7,7 @@
 
 #include "utils/util.hpp"
 #include "utils/error.hpp"
+#include "utils/numbers.hpp"
 #include "utils/typeInfo.hpp"
 #include "ast.hpp"
 
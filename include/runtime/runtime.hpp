@@ -2,6 +2,7 @@
 #define RUNTIME_HPP
 
 #include <string>
+#include <cstdint>
 #include <cstdlib>
 
 #include "utils/util.hpp"
@@ -9,18 +10,36 @@
 
 extern "C" {
   struct _xyl_Value {
-    void* ptrToData;
-    UniqueIdentifier allowedTypeList;
-    UniqueIdentifier currentType;
+    /// Index of the TypeId of the stored value
+    uint32_t currentType;
+    /// The value itself if it fits in 8 bytes, otherwise a pointer to it
+    uint64_t data;
   };
 
-  bool _xyl_checkTypeCompat(_xyl_Value* val, _xyl_Value* newVal);
+  /// What the runtime knows about a type, found by the index of its TypeId
+  struct _xyl_TypeInfo {
+    /// Null for the indices of types the program never stores in a union
+    const char* name;
+    uint64_t size;
+    uint64_t align;
+  };
+
+  /**
+    \brief Called at the start of the program with its table of types, before anything uses it
+    \param count how many entries the table has
+  */
+  void _xyl_registerTypes(const _xyl_TypeInfo* types, uint64_t count);
+
+  /// The name of the type the value currently has, which lives as long as the program
   const char* _xyl_typeOf(_xyl_Value* val);
   _xyl_Value _xyl_withType(_xyl_Value* toConcretize, UniqueIdentifier concreteType);
   
-  // TODO maybe take a string param for the error to emit
-  void _xyl_typeErrIfIncompatible(_xyl_Value* val, _xyl_Value* newVal);
-  void _xyl_typeErrIfIncompatibleTid(UniqueIdentifier allowed, _xyl_Value* newVal);
+  /**
+    \brief Called by the generated code when a value's type is not allowed, kills the program
+    \param allowed name of the type that was expected
+    \param actualType index of the type that the value has
+  */
+  void _xyl_typeErr(const char* allowed, uint32_t actualType) __attribute__((noreturn, cold));
   
   /**
     \brief This kills the program
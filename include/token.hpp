@@ -2,6 +2,7 @@
 #define TOKEN_HPP
 
 #include <string>
+#include <cstring>
 #include <array>
 #include <algorithm>
 
@@ -15,6 +16,92 @@
   #undef VOID
 #endif
 
+/**
+  \brief The text stored in a Token.
+  
+  It either owns its characters, or it is a view into a buffer that outlives it, such
+  as the memory-mapped source file of a Lexer. Views make lexing allocation-free.
+*/
+class TokenText {
+private:
+  const char* viewData = nullptr;
+  std::size_t viewLength = 0;
+  std::string owned = "";
+public:
+  TokenText() = default;
+  TokenText(std::string str) noexcept: owned(std::move(str)) {}
+  TokenText(const char* str): owned(str) {}
+  
+  /// Create a non-owning view of some characters
+  static inline TokenText view(const char* begin, std::size_t length) noexcept {
+    TokenText text;
+    text.viewData = begin;
+    text.viewLength = length;
+    return text;
+  }
+  
+  /// If true, the characters belong to someone else
+  inline bool isView() const noexcept {
+    return viewData != nullptr;
+  }
+  
+  /// Copy the viewed characters, so this no longer depends on the viewed buffer
+  inline void detach() {
+    if (!isView()) return;
+    owned.assign(viewData, viewLength);
+    viewData = nullptr;
+    viewLength = 0;
+  }
+  
+  inline const char* begin() const noexcept {
+    return isView() ? viewData : owned.data();
+  }
+  inline const char* end() const noexcept {
+    return begin() + length();
+  }
+  inline std::size_t length() const noexcept {
+    return isView() ? viewLength : owned.length();
+  }
+  inline bool empty() const noexcept {
+    return length() == 0;
+  }
+  inline char back() const noexcept {
+    return *(end() - 1);
+  }
+  
+  inline std::string str() const {
+    return isView() ? std::string(viewData, viewLength) : owned;
+  }
+  inline operator std::string() const {
+    return str();
+  }
+  /// Intern the text
+  inline Symbol symbol() const {
+    return Symbol(begin(), length());
+  }
+  
+  inline bool equals(const char* other, std::size_t otherLength) const noexcept {
+    return length() == otherLength && std::equal(begin(), end(), other);
+  }
+  inline bool operator==(const TokenText& rhs) const noexcept {
+    return equals(rhs.begin(), rhs.length());
+  }
+  inline bool operator==(const std::string& rhs) const noexcept {
+    return equals(rhs.data(), rhs.length());
+  }
+  inline bool operator==(const char* rhs) const noexcept {
+    return equals(rhs, std::strlen(rhs));
+  }
+  template<typename T>
+  inline bool operator!=(const T& rhs) const noexcept {
+    return !operator==(rhs);
+  }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const TokenText& text) noexcept {
+  return os.write(text.begin(), static_cast<std::streamsize>(text.length()));
+}
+
 class TokenType {
 private:
   int index;
@@ -25,6 +112,7 @@ public:
     index(idx), prettyName(prettyName) {}
 
   constexpr operator int() const {return index;}
+  constexpr const char* getPrettyName() const {return prettyName;}
   constexpr bool operator==(const TokenType& rhs) const {return index == rhs.index;}
   constexpr bool operator!=(const TokenType& rhs) const {return !operator==(rhs);}
   
@@ -100,6 +188,7 @@ namespace TT {
   constexpr Keyword THROW(227, "throw");
   constexpr Keyword TRY(228, "try");
   constexpr Keyword CATCH(229, "catch");
+  constexpr Keyword COLD(230, "cold");
 
   constexpr Construct SEMI(';', 300, "Semicolon");
   constexpr Construct TWO_POINT(':', 301, "Colon");
@@ -116,7 +205,7 @@ namespace TT {
   constexpr TokenType IDENTIFIER(5, "Identifier");
   constexpr TokenType UNPROCESSED(0, "Unprocessed?");
   
-  constexpr std::array<Keyword, 30> keywords = {
+  constexpr std::array<Keyword, 31> keywords = {
     DEFINE,
     AS, IMPORT, EXPORT, ALL_OF, FROM,
     FUNCTION, RETURN,
@@ -125,7 +214,7 @@ namespace TT {
     WHILE, FOR, BREAK, CONTINUE,
     FAT_ARROW, VOID, FOREIGN,
     TYPE, INHERITS, CONSTR, METHOD,
-    PUBLIC, PRIVATE, PROTECT, STATIC,
+    PUBLIC, PRIVATE, PROTECT, STATIC, COLD,
     THROW, TRY, CATCH
   };
   
@@ -135,7 +224,7 @@ namespace TT {
     SQPAREN_LEFT, SQPAREN_RIGHT
   };
   
-  constexpr std::array<TokenType, 45> all = {
+  constexpr std::array<TokenType, 48> all = {
     INTEGER, FLOAT, BOOLEAN, STRING,
     
     DEFINE,
@@ -146,12 +235,13 @@ namespace TT {
     WHILE, FOR, BREAK, CONTINUE,
     FAT_ARROW, VOID, FOREIGN,
     TYPE, INHERITS, CONSTR, METHOD,
-    PUBLIC, PRIVATE, PROTECT, STATIC,
+    PUBLIC, PRIVATE, PROTECT, STATIC, COLD,
     THROW, TRY, CATCH,
     
     SEMI, TWO_POINT, QUESTION,
     PAREN_LEFT, PAREN_RIGHT,
     SQPAREN_LEFT, SQPAREN_RIGHT,
+    CALL_BEGIN, CALL_END,
     
     FILE_END,
     OPERATOR,
@@ -159,9 +249,26 @@ namespace TT {
     UNPROCESSED
   };
   
+  /// Position of a TokenType in TT::all, used to store it compactly
+  using Tag = uint16_t;
+  
+  inline TokenType fromTag(Tag tag) noexcept {
+    return all[tag];
+  }
+  Tag toTag(TokenType) noexcept;
+  
+  /// Matches identifiers and literals
+  constexpr bool isTerminal(TokenType type) noexcept {
+    return type == IDENTIFIER ||
+      type == INTEGER ||
+      type == FLOAT ||
+      type == STRING ||
+      type == BOOLEAN;
+  }
+  
   TokenType findByPrettyName(std::string);
   TokenType findConstruct(char) noexcept;
-  TokenType findKeyword(std::string) noexcept;
+  TokenType findKeyword(const TokenText&) noexcept;
 }
 
 /**
@@ -170,27 +277,34 @@ namespace TT {
 class Token {
 public:
   TokenType type; ///< \see TokenType
-  std::string data = ""; ///< Stores the data that represents this token. May be processed
+  TokenText data = ""; ///< Stores the data that represents this token. May be processed
   Operator::Index idx = 9999; ///< Only if the type is OPERATOR
   Trace trace; ///< At what line of the input was this Token encountered
+  /// Only for number literals, their value as parsed by the lexer
+  union {
+    int64_t intValue = 0; ///< If the type is INTEGER
+    double floatValue; ///< If the type is FLOAT
+  };
   
   /// Create a non-operator Token.
-  Token(TokenType type, std::string data, Trace trace) noexcept:
-    type(type), data(data), trace(trace) {}
+  Token(TokenType type, TokenText data, Trace trace) noexcept:
+    type(type), data(std::move(data)), trace(trace) {}
   /// Create an operator Token.
   Token(TokenType type, Operator::Index idx, Trace trace) noexcept:
     type(type), idx(idx), trace(trace) {}
+  /// Create a TT::INTEGER Token.
+  Token(TokenText data, int64_t value, Trace trace) noexcept:
+    type(TT::INTEGER), data(std::move(data)), trace(trace), intValue(value) {}
+  /// Create a TT::FLOAT Token.
+  Token(TokenText data, double value, Trace trace) noexcept:
+    type(TT::FLOAT), data(std::move(data)), trace(trace), floatValue(value) {}
   /// Create a Token without initializing any data.
   Token(TokenType type, Trace trace) noexcept:
     type(type), trace(trace) {}
   
   /// Matches identifiers and literals
   inline bool isTerminal() const noexcept {
-    return type == TT::IDENTIFIER ||
-      type == TT::INTEGER ||
-      type == TT::FLOAT ||
-      type == TT::STRING ||
-      type == TT::BOOLEAN;
+    return TT::isTerminal(type);
   }
   /// Matches operators
   inline bool isOp() const noexcept {
@@ -0,0 +1,258 @@
+#ifndef TOKEN_STORE_HPP
+#define TOKEN_STORE_HPP
+
+#include <vector>
+#include <string>
+#include <functional>
+
+#include "utils/util.hpp"
+#include "utils/trace.hpp"
+#include "operator.hpp"
+#include "token.hpp"
+
+/**
+  \brief Compact list of tokens.
+
+  Each field of the tokens is kept in its own array, so looking at token types doesn't load
+  anything else. The text of most tokens is not stored at all, since it can be found in the
+  source code using the offset and length of the token. Only text that isn't in the source
+  (strings with escape sequences) is kept, in the literal pool. Number literals also have
+  their parsed value, in a separate table. Opening parens know where they are closed.
+
+  All the tokens in a store come from the same file.
+*/
+class TokenStore {
+public:
+  /// Value of aux for tokens whose text is their source (without the quote, for strings)
+  static constexpr uint32_t sourceText = UINT32_MAX;
+  /// Value of aux for opening parens whose closing paren wasn't lexed yet
+  static constexpr uint32_t unmatched = UINT32_MAX;
+private:
+  /// Source code of the tokens, which must outlive the store
+  const char* code = nullptr;
+  FileId file = Trace::noFile;
+  /// If true, materialized tokens have views of their text instead of copies
+  bool viewText = false;
+
+  std::vector<TT::Tag> types {};
+  /// Meaning depends on the type of the token \see AuxKind
+  std::vector<uint32_t> aux {};
+  std::vector<uint32_t> offsets {};
+  std::vector<uint32_t> lengths {};
+
+  std::string literalPool {};
+  /// Literal i is between literalStarts[i] and literalStarts[i + 1] in the pool
+  std::vector<uint32_t> literalStarts {0};
+
+  struct NumberLiteral {
+    /// The int64_t or double value of the literal
+    uint64_t bits;
+    /// An index in the literal pool, or sourceText
+    uint32_t literal;
+  };
+  std::vector<NumberLiteral> numbers {};
+
+  /// What the aux value of a token is
+  enum class AuxKind {
+    OPERATOR, ///< Operator::Index
+    NUMBER, ///< Index in numbers, for INTEGER and FLOAT
+    PAREN_BEGIN, ///< Index of the closing paren, or unmatched
+    TEXT ///< Index in the literal pool, or sourceText
+  };
+  inline AuxKind auxKind(std::size_t at) const noexcept {
+    auto ty = type(at);
+    if (ty == TT::OPERATOR) return AuxKind::OPERATOR;
+    if (ty == TT::INTEGER || ty == TT::FLOAT) return AuxKind::NUMBER;
+    if (ty == TT::PAREN_LEFT || ty == TT::CALL_BEGIN || ty == TT::SQPAREN_LEFT) {
+      return AuxKind::PAREN_BEGIN;
+    }
+    return AuxKind::TEXT;
+  }
+  /// Index in the literal pool of a token's text, or sourceText
+  inline uint32_t literalIndex(std::size_t at) const noexcept {
+    switch (auxKind(at)) {
+      case AuxKind::NUMBER: return numbers[aux[at]].literal;
+      case AuxKind::TEXT: return aux[at];
+      default: return sourceText;
+    }
+  }
+  void pushFields(TokenType type, uint32_t auxValue, Trace trace);
+  uint32_t pushLiteral(const TokenText& text);
+  void pushNumber(TokenType type, Trace trace, uint64_t bits, uint32_t literal);
+public:
+  TokenStore() = default;
+  /**
+    \param code the source of the tokens
+    \param file where the code came from
+    \param viewText if true, materialized tokens will be views into the code or the pool
+  */
+  TokenStore(const char* code, FileId file, bool viewText) noexcept;
+
+  /// Create a store with copies of some tokens
+  static TokenStore fromTokens(const std::vector<Token>& tokens);
+
+  inline std::size_t size() const noexcept {
+    return types.size();
+  }
+  inline bool empty() const noexcept {
+    return types.empty();
+  }
+  void reserve(std::size_t tokenCount);
+
+  inline TokenType type(std::size_t at) const noexcept {
+    return TT::fromTag(types[at]);
+  }
+  inline bool isOp(std::size_t at) const noexcept {
+    return type(at) == TT::OPERATOR;
+  }
+  /// Only valid for operators
+  inline Operator::Index opIndex(std::size_t at) const noexcept {
+    return aux[at];
+  }
+  /// Only valid for operators
+  inline const Operator& op(std::size_t at) const noexcept {
+    return Operator::list[aux[at]];
+  }
+  inline Trace trace(std::size_t at) const noexcept {
+    return Trace(file, offsets[at], lengths[at]);
+  }
+  /// Get the text of a token, or an empty text for operators
+  TokenText text(std::size_t at) const;
+  /// Only valid for opening parens, gets the index of their closing paren or unmatched
+  inline std::size_t matchingParen(std::size_t at) const noexcept {
+    return aux[at];
+  }
+  /// Only valid for TT::INTEGER
+  int64_t intValue(std::size_t at) const noexcept;
+  /// Only valid for TT::FLOAT
+  double floatValue(std::size_t at) const noexcept;
+
+  /// Materialize a token
+  Token operator[](std::size_t at) const;
+  /// Materialize all the tokens
+  std::vector<Token> toTokens() const;
+
+  inline void setType(std::size_t at, TokenType type) noexcept {
+    types[at] = TT::toTag(type);
+  }
+  inline void setOpIndex(std::size_t at, Operator::Index idx) noexcept {
+    aux[at] = static_cast<uint32_t>(idx);
+  }
+  inline void setMatchingParen(std::size_t at, std::size_t closedAt) noexcept {
+    aux[at] = static_cast<uint32_t>(closedAt);
+  }
+
+  /// Add a token whose text is its source (without the opening quote, for strings)
+  void push(TokenType type, Trace trace);
+  /// Add a token whose text is not its source
+  void push(TokenType type, Trace trace, const TokenText& text);
+  void pushOperator(Operator::Index idx, Trace trace);
+  /// Add a TT::INTEGER token whose text is its source
+  void pushInteger(Trace trace, int64_t value);
+  /// Add a TT::FLOAT token whose text is its source
+  void pushFloat(Trace trace, double value);
+  /// Add a copy of any token
+  void push(const Token& tok);
+  /// Add copies of all the tokens in another store with the same source
+  void append(const TokenStore& other);
+  /// Remove the first count tokens, along with their literals; the rest are renumbered from 0
+  void discardBefore(std::size_t count);
+};
+
+/**
+  \brief Reads the tokens of a TokenStore in order, without copying them
+
+  A cursor can be limited to a range of the store, like the inside of some parens. Past the
+  end of its range, it only sees a TT::FILE_END.
+*/
+class TokenCursor {
+private:
+  const TokenStore* store;
+  std::size_t pos = 0;
+  /// The cursor stops here, or at the end of the store if this is noLimit
+  std::size_t limit = noLimit;
+  /// Adds more tokens to the store, returning false if there are none left
+  std::function<bool()> refill;
+  
+  static constexpr std::size_t noLimit = SIZE_MAX;
+  
+  inline bool atLimit() const noexcept {
+    return pos == limit;
+  }
+public:
+  explicit TokenCursor(const TokenStore& store) noexcept: store(&store) {}
+  /**
+    \brief Read a store that is still being filled
+    \param refill called when the cursor needs tokens past the end of the store
+  */
+  TokenCursor(const TokenStore& store, std::function<bool()> refill):
+    store(&store), refill(std::move(refill)) {}
+  
+  /// Get a cursor for the tokens in [begin, end) of the same store
+  inline TokenCursor range(std::size_t begin, std::size_t end) const noexcept {
+    TokenCursor cursor(*store);
+    cursor.pos = begin;
+    cursor.limit = end;
+    return cursor;
+  }
+  
+  inline const TokenStore& getStore() const noexcept {
+    return *store;
+  }
+  inline std::size_t getPosition() const noexcept {
+    return pos;
+  }
+  
+  inline TokenType type() const noexcept {
+    return atLimit() ? TT::FILE_END : store->type(pos);
+  }
+  inline bool isOp() const noexcept {
+    return !atLimit() && store->isOp(pos);
+  }
+  inline const Operator& op() const noexcept {
+    return store->op(pos);
+  }
+  /// Past the end of a range, this is the trace of the token that ends it
+  inline Trace trace() const noexcept {
+    return store->trace(pos);
+  }
+  inline TokenText text() const {
+    return atLimit() ? TokenText() : store->text(pos);
+  }
+  inline int64_t intValue() const noexcept {
+    return store->intValue(pos);
+  }
+  inline double floatValue() const noexcept {
+    return store->floatValue(pos);
+  }
+  /// Get a copy of the current token
+  inline Token current() const {
+    return atLimit() ? Token(TT::FILE_END, trace()) : (*store)[pos];
+  }
+  /**
+    \brief Find the paren that closes the current one, reading more tokens if it wasn't
+    reached yet
+    \returns its index, or TokenStore::unmatched if there isn't one
+  */
+  inline std::size_t matchingParen() {
+    while (store->matchingParen(pos) == TokenStore::unmatched && refill && refill()) {}
+    return store->matchingParen(pos);
+  }
+  
+  /// Skip a number of tokens, without going past the last one
+  inline void skip(std::size_t skipped) {
+    if (limit != noLimit) {
+      pos = std::min(pos + skipped, limit);
+      return;
+    }
+    // Going back wraps around, so it never needs a refill
+    while (pos + skipped >= store->size() && refill && refill()) {}
+    pos = std::min(pos + skipped, store->size() - 1);
+  }
+  /// Keep pointing to the same token after some were removed from the front of the store
+  inline void rebase(std::size_t removed) noexcept {
+    pos -= removed;
+  }
+};
+
+#endif
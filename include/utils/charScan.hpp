@@ -0,0 +1,69 @@
+#ifndef CHAR_SCAN_HPP
+#define CHAR_SCAN_HPP
+
+#include <array>
+#include <string>
+
+#include "utils/util.hpp"
+
+/**
+  \brief A set of characters that can be searched for in a buffer.
+
+  Searches look at many bytes at a time, using SSE2 or AVX2 when the CPU has them. The
+  implementation is picked at runtime, and all of them give the same results.
+*/
+class CharSet {
+public:
+  enum Implementation: int {
+    SCALAR, ///< One byte at a time
+    SSE2, ///< 16 bytes at a time
+    AVX2 ///< 32 bytes at a time
+  };
+private:
+  /// Indexed by unsigned char
+  std::array<bool, 256> members {};
+  /// Each character in the set, once
+  std::string chars;
+  /**
+    \brief Tables for classifying bytes with shuffles, valid if canUseNibbleTables.
+
+    Every distinct high nibble of the members gets a bit. A byte is in the set if the
+    entries for its low and high nibbles share a bit.
+  */
+  alignas(16) std::array<uint8_t, 16> lowNibbleMasks {};
+  alignas(16) std::array<uint8_t, 16> highNibbleMasks {};
+  /// There are only 8 bits, so sets with more distinct high nibbles can't use the tables
+  bool canUseNibbleTables = false;
+
+  static Implementation& selectedImplementation() noexcept;
+
+  /// Find the first character for which contains() == wanted
+  const char* findScalar(const char* begin, const char* end, bool wanted) const noexcept;
+  const char* findSSE2(const char* begin, const char* end, bool wanted) const noexcept;
+  const char* findAVX2(const char* begin, const char* end, bool wanted) const noexcept;
+  const char* find(const char* begin, const char* end, bool wanted) const noexcept;
+public:
+  explicit CharSet(const std::string& characters) noexcept;
+
+  inline bool contains(char c) const noexcept {
+    return members[static_cast<unsigned char>(c)];
+  }
+
+  /// Find the first character in the set, or end if there isn't any
+  inline const char* findFirstIn(const char* begin, const char* end) const noexcept {
+    return find(begin, end, true);
+  }
+  /// Find the first character not in the set, or end if there isn't any
+  inline const char* findFirstNotIn(const char* begin, const char* end) const noexcept {
+    return find(begin, end, false);
+  }
+
+  /// Check if this CPU (and build) can use an implementation
+  static bool isSupported(Implementation impl) noexcept;
+  /// The implementation used by all searches. Defaults to the fastest supported one
+  static Implementation getImplementation() noexcept;
+  /// Force an implementation, for testing. It must be supported
+  static void setImplementation(Implementation impl) noexcept;
+};
+
+#endif
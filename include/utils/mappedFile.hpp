@@ -0,0 +1,38 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <string>
+
+#include "utils/util.hpp"
+#include "utils/error.hpp"
+
+/**
+  \brief Read-only view of a whole file, mapped into memory.
+  
+  On platforms without mmap, the file is read into a buffer instead.
+*/
+class MappedFile {
+private:
+  const char* contents = nullptr;
+  std::size_t length = 0;
+#ifdef _MSC_VER
+  std::string buffer;
+#endif
+public:
+  /// Throws if the file can't be read
+  explicit MappedFile(fs::path path);
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile();
+  
+  /// Start of the file's contents. Not null terminated
+  inline const char* data() const noexcept {
+    return contents;
+  }
+  
+  inline std::size_t size() const noexcept {
+    return length;
+  }
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef NUMBERS_HPP
+#define NUMBERS_HPP
+
+#include <string>
+
+#include "utils/util.hpp"
+
+/**
+  \brief Parse the digits of a non-negative integer
+  \param radix between 2 and 16
+  \param[out] value the parsed integer, if successful
+  \returns false if a character isn't a digit in the radix, or if the value doesn't fit in
+  an int64_t
+*/
+bool parseInteger(const char* begin, const char* end, unsigned radix, int64_t& value) noexcept;
+
+/**
+  \brief Parse a decimal number made of digits and at most one point, like "12.5"
+
+  The result is correctly rounded. Numbers with few enough significant digits are computed
+  exactly using a single multiplication or division (Clinger's fast path), while the rest
+  fall back to std::strtod.
+  \param[out] value the parsed number, if successful
+  \returns false if there is any other character in the input
+*/
+bool parseFloat(const char* begin, const char* end, double& value);
+
+#endif
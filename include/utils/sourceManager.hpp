@@ -0,0 +1,52 @@
+#ifndef SOURCE_MANAGER_HPP
+#define SOURCE_MANAGER_HPP
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+
+#include "utils/util.hpp"
+#include "utils/trace.hpp"
+
+/**
+  \brief Keeps the data shared by all the Traces of a source file.
+  
+  Each file name is stored once, along with the offsets where the file's lines start,
+  which are used to turn a Trace's offset into a Position. Thread safe.
+*/
+class SourceManager {
+private:
+  struct File {
+    std::string name;
+    /// Offset of the first character of each line
+    std::vector<uint32_t> lineStarts;
+  };
+  
+  mutable std::mutex filesMutex;
+  /// Indexed by FileId. A deque, so that files don't move when others are added
+  std::deque<File> files;
+  
+  SourceManager();
+public:
+  SourceManager(const SourceManager&) = delete;
+  
+  /// Get the instance used by the whole program
+  static SourceManager& get() noexcept;
+  
+  /**
+    \brief Register a file, and find where its lines begin.
+    
+    The contents are not retained.
+    \param name where the code came from, used for error messages
+  */
+  FileId addFile(std::string name, const char* contents, std::size_t length);
+  
+  std::string getFileName(FileId file) const;
+  /// How many lines a file has
+  uint64_t getLineCount(FileId file) const;
+  /// Turn an offset into a line and column
+  Position getPosition(FileId file, uint32_t offset) const;
+};
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef SYMBOL_HPP
+#define SYMBOL_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+
+/**
+  \brief An interned name, compared and hashed as a 32-bit id
+
+  Identifiers and type names are interned once, when they are parsed, so scopes and type
+  lists don't have to hash or compare their text again. The same text always gets the same
+  id. The table of names is global, and can be used from multiple threads. Names are never
+  removed from it.
+*/
+class Symbol {
+public:
+  using Id = uint32_t;
+private:
+  /// The empty name is always 0
+  Id id = 0;
+
+  /// Get the id of a name, adding it to the table if it isn't there
+  static Id intern(const char* text, std::size_t length);
+public:
+  Symbol() = default;
+  Symbol(const std::string& text): id(intern(text.data(), text.length())) {}
+  Symbol(const char* text): Symbol(std::string(text)) {}
+  Symbol(const char* text, std::size_t length): id(intern(text, length)) {}
+
+  inline Id getId() const noexcept {
+    return id;
+  }
+  inline bool empty() const noexcept {
+    return id == 0;
+  }
+  /// The interned text, which lives as long as the program
+  const std::string& str() const;
+  inline operator const std::string&() const {
+    return str();
+  }
+
+  inline bool operator==(const Symbol& rhs) const noexcept {
+    return id == rhs.id;
+  }
+  inline bool operator!=(const Symbol& rhs) const noexcept {
+    return id != rhs.id;
+  }
+  /// Orders by id, which is the order names were first interned in
+  inline bool operator<(const Symbol& rhs) const noexcept {
+    return id < rhs.id;
+  }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const Symbol& sym) {
+  return os << sym.str();
+}
+
+namespace std {
+  /// Symbol std::hash template specialization
+  template<>
+  struct hash<Symbol> {
+    using argument_type = Symbol;
+    using result_type = size_t;
+    size_t operator()(const Symbol& sym) const noexcept {
+      // Ids are unique, so they work well as hashes
+      return sym.getId();
+    }
+  };
+}
+
+/**
+  \brief A small set of symbols, kept as a sorted vector
+
+  Sets of type names rarely have more than a few elements, so comparing two of them is just
+  comparing a few ids.
+*/
+class SymbolSet {
+private:
+  std::vector<Symbol> symbols;
+public:
+  using value_type = Symbol;
+  using const_iterator = std::vector<Symbol>::const_iterator;
+  using iterator = const_iterator;
+
+  SymbolSet() = default;
+  SymbolSet(std::initializer_list<Symbol> list): SymbolSet(list.begin(), list.end()) {}
+  template<typename Iter>
+  SymbolSet(Iter begin, Iter end) {
+    for (auto it = begin; it != end; ++it) insert(*it);
+  }
+
+  /// Add a symbol, if it isn't already in the set
+  inline void insert(Symbol sym) {
+    auto it = std::lower_bound(symbols.begin(), symbols.end(), sym);
+    if (it == symbols.end() || *it != sym) symbols.insert(it, sym);
+  }
+  inline bool contains(Symbol sym) const noexcept {
+    return std::binary_search(symbols.begin(), symbols.end(), sym);
+  }
+
+  inline std::size_t size() const noexcept {
+    return symbols.size();
+  }
+  inline bool empty() const noexcept {
+    return symbols.empty();
+  }
+  inline const_iterator begin() const noexcept {
+    return symbols.begin();
+  }
+  inline const_iterator end() const noexcept {
+    return symbols.end();
+  }
+
+  inline bool operator==(const SymbolSet& rhs) const noexcept {
+    return symbols == rhs.symbols;
+  }
+  inline bool operator!=(const SymbolSet& rhs) const noexcept {
+    return symbols != rhs.symbols;
+  }
+};
+
+#endif
@@ -52,30 +52,44 @@ inline std::ostream& operator<<(std::ostream& os, const Range& r) noexcept {
   return os << r.toString();
 }
 
+/// Identifies a file registered with the SourceManager
+using FileId = uint32_t;
+
 /**
   \brief Stores debug information.
+  
+  Only the offset and length of the traced source are stored. The file name and the
+  line/column positions are looked up in the SourceManager when they are needed.
 */
 class Trace {
 private:
-  bool isNullTrace = false;
-  std::string file;
-  Range location;
+  FileId file;
+  uint32_t offset;
+  uint32_t length;
   // std::stack<?FunctionData?> stack; TODO
 public:
-  inline Trace(std::string file, Range location) noexcept: file(file), location(location) {}
-  inline Trace(std::nullptr_t) noexcept: isNullTrace(true), location(Range(Position(0, 0), 0)) {}
+  /// Used by null traces
+  static constexpr FileId nullFile = 0;
+  /// Used for things that don't come from a source file
+  static constexpr FileId noFile = 1;
   
-  inline Range getRange() const noexcept {
-    return location;
-  }
-  inline std::string getFileName() const noexcept {
+  inline constexpr Trace(FileId file, uint32_t offset, uint32_t length) noexcept:
+    file(file), offset(offset), length(length) {}
+  inline constexpr Trace(std::nullptr_t) noexcept: file(nullFile), offset(0), length(0) {}
+  
+  inline constexpr FileId getFile() const noexcept {
     return file;
   }
-  
-  inline std::string toString() const noexcept {
-    if (isNullTrace) return "";
-    else return fmt::format("found {0} in {1}", location, file);
+  inline constexpr uint32_t getOffset() const noexcept {
+    return offset;
   }
+  inline constexpr uint32_t getLength() const noexcept {
+    return length;
+  }
+  
+  Range getRange() const noexcept;
+  std::string getFileName() const noexcept;
+  std::string toString() const noexcept;
 };
 
 inline std::ostream& operator<<(std::ostream& os, const Trace& tr) noexcept {
@@ -83,6 +97,6 @@ inline std::ostream& operator<<(std::ostream& os, const Trace& tr) noexcept {
 }
 
 /// Default trace object that has an empty range
-const Trace defaultTrace = Trace("<none>", Range(Position(0, 0), Position(0, 0)));
+constexpr Trace defaultTrace = Trace(Trace::noFile, 0, 0);
 
 #endif
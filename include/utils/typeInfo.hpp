@@ -36,7 +36,7 @@ public:
   TypeInfo(const TypeInfo&) = default;
   TypeInfo& operator=(const TypeInfo&) = default;
   
-  inline TypeList getEvalTypeList() const {
+  inline const TypeList& getEvalTypeList() const {
     throwIfVoid();
     return evalValue;
   }
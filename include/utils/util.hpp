@@ -15,6 +15,8 @@
 #include <fmt/format.h>
 #include <fmt/ostream.h>
 
+#include "utils/symbol.hpp"
+
 namespace fs = std::experimental::filesystem;
 
 #ifdef _MSC_VER
@@ -47,7 +49,7 @@ namespace fs = std::experimental::filesystem;
 using UniqueIdentifier = std::size_t;
 
 /// Represents a list of types. Used in multiple places
-using TypeList = std::unordered_set<std::string>;
+using TypeList = SymbolSet;
 
 /// Syntactic sugar
 using TypeName = std::string;
@@ -1,39 +1,95 @@
 #include "ast.hpp"
 
+void* ASTArena::allocate(std::size_t size, std::size_t alignment) {
+  std::size_t padding = reinterpret_cast<std::uintptr_t>(next) % alignment;
+  if (padding != 0) padding = alignment - padding;
+  if (next == nullptr || padding + size > available) {
+    // Chunks get bigger as the arena grows, so small ASTs stay small
+    chunkSize = std::min(std::max(chunkSize * 2, minChunkSize), maxChunkSize);
+    std::size_t newSize = std::max(chunkSize, size + alignment);
+    chunks.emplace_back(new char[newSize]);
+    next = chunks.back().get();
+    available = newSize;
+    padding = reinterpret_cast<std::uintptr_t>(next) % alignment;
+    if (padding != 0) padding = alignment - padding;
+  }
+  void* memory = next + padding;
+  next += padding + size;
+  available -= padding + size;
+  return memory;
+}
+
+ASTArena::~ASTArena() {
+  // Nodes don't destroy each other, so the order doesn't matter
+  for (auto node : nodes) node->~ASTNode();
+}
+
+std::weak_ptr<ASTArena>& ASTArena::current() noexcept {
+  static thread_local std::weak_ptr<ASTArena> arena;
+  return arena;
+}
+
+std::shared_ptr<ASTArena> ASTArena::forThread() {
+  auto arena = current().lock();
+  if (arena == nullptr) {
+    arena = std::make_shared<ASTArena>();
+    current() = arena;
+  }
+  return arena;
+}
+
+ASTArena::Scope::Scope(): arena(std::make_shared<ASTArena>()), previous(current()) {
+  current() = arena;
+}
+
+ASTArena::Scope::~Scope() {
+  current() = previous;
+}
+
 void ASTNode::addChild(Link child) {
-  child->setParent(shared_from_this());
-  children.push_back(child);
+  child->setParent(this);
+  children.push_back(child.get());
 }
 
 ASTNode::Link ASTNode::removeChild(int64_t pos) {
   Link child = this->at(pos);
-  child->setParent(WeakLink());
+  child->setParent(nullptr);
   this->children.erase(std::next(std::begin(children), transformArrayIndex<int64_t>(pos)));
   return child;
 }
 
+ASTNode::Children ASTNode::getChildren() const {
+  Children links;
+  links.reserve(children.size());
+  for (auto child : children) links.push_back(linkTo(child));
+  return links;
+}
+
 ASTNode::Link ASTNode::at(int64_t pos) const {
-  return getChildren().at(transformArrayIndex(pos));
+  return linkTo(children.at(transformArrayIndex(pos)));
 }
 
 ASTNode::Link ASTNode::at(std::size_t pos) const {
-  return getChildren().at(pos);
+  return linkTo(children.at(pos));
 }
 
 ASTNode::Link ASTNode::findAbove(std::function<bool(Link)> isOk) const {
-  auto lastParent = this->getParent();
-  for (; ; lastParent = lastParent.lock()->getParent()) {
-    if (lastParent.lock() == nullptr) return nullptr;
-    if (isOk(lastParent.lock())) return lastParent.lock();
+  for (ASTNode* node = parent; node != nullptr; node = node->parent) {
+    auto link = linkTo(node);
+    if (isOk(link)) return link;
   }
+  return nullptr;
 }
 
 bool ASTNode::operator==(const ASTNode& rhs) const {
   if (typeid(*this) != typeid(rhs)) return false;
-  if (getChildren().size() != rhs.getChildren().size()) return false;
-  for (std::size_t i = 0; i < getChildren().size(); i++) {
-    if (this->at(i) == nullptr && rhs.at(i) == nullptr) continue;
-    if (*(this->at(i)) != *(rhs.at(i))) return false;
+  auto lhsChildren = getChildSpan();
+  auto rhsChildren = rhs.getChildSpan();
+  if (lhsChildren.size() != rhsChildren.size()) return false;
+  for (std::size_t i = 0; i < lhsChildren.size(); i++) {
+    if (lhsChildren[i] == nullptr && rhsChildren[i] == nullptr) continue;
+    if (lhsChildren[i] == nullptr || rhsChildren[i] == nullptr) return false;
+    if (*lhsChildren[i] != *rhsChildren[i]) return false;
   }
   return true;
 }
@@ -42,7 +98,8 @@ bool ASTNode::operator!=(const ASTNode& rhs) const {
   return !operator==(rhs);
 }
 
-NoMoreChildrenNode::NoMoreChildrenNode(std::size_t childrenCount) noexcept {
+NoMoreChildrenNode::NoMoreChildrenNode(NodeKind kind, std::size_t childrenCount) noexcept:
+  ASTNode(kind) {
   children.resize(childrenCount, nullptr);
 }
 
@@ -51,9 +108,11 @@ void NoMoreChildrenNode::addChild(Link child) {
   throw InternalError("Cannot add children to NoMoreChildrenNode", {METADATA_PAIRS});
 }
 
-BlockNode::BlockNode(BlockType type): type(type) {}
+BlockNode::BlockNode(BlockType type): ASTNode(NodeKind::BLOCK), type(type) {}
 
-ExpressionNode::ExpressionNode(Token token): tok(token) {
+ExpressionNode::ExpressionNode(Token token): ASTNode(NodeKind::EXPRESSION), tok(token) {
+  // The AST can outlive the Lexer whose input the token data might be pointing into
+  tok.data.detach();
   switch (int(tok.type)) {
     case TT::IDENTIFIER:
     case TT::OPERATOR:
@@ -64,6 +123,7 @@ ExpressionNode::ExpressionNode(Token token): tok(token) {
       break;
     default: throw InternalError("Trying to add unsupported token to ExpressionNode", {METADATA_PAIRS, {"token", token.toString()}});
   }
+  if (tok.type == TT::IDENTIFIER) symbol = tok.data.symbol();
 }
 
 std::shared_ptr<ExpressionNode> ExpressionNode::at(int64_t pos) const {
@@ -71,6 +131,7 @@ std::shared_ptr<ExpressionNode> ExpressionNode::at(int64_t pos) const {
 }
 
 TypeNode::TypeNode(std::string name, TypeList inheritsFrom):
+  ASTNode(NodeKind::TYPE),
   name(name),
   inheritsFrom(inheritsFrom) {}
 
@@ -89,25 +150,27 @@ void TypeNode::addChild(Link child) {
   }
 }
 
-FunctionNode::FunctionNode(std::string ident, FunctionSignature sig, bool foreign):
-  NoMoreChildrenNode(1),
+FunctionNode::FunctionNode(NodeKind kind, std::string ident, FunctionSignature sig, bool foreign):
+  NoMoreChildrenNode(kind, 1),
   ident(ident),
   sig(sig),
   foreign(foreign) {}
+FunctionNode::FunctionNode(std::string ident, FunctionSignature sig, bool foreign):
+  FunctionNode(NodeKind::FUNCTION, ident, sig, foreign) {}
 FunctionNode::FunctionNode(FunctionSignature sig): FunctionNode("", sig, false) {}
 
 ConstructorNode::ConstructorNode(FunctionSignature::Arguments args, Visibility vis, bool isForeign):
-  FunctionNode("constructor", FunctionSignature(nullptr, args), isForeign), vis(vis) {
+  FunctionNode(NodeKind::CONSTRUCTOR, "constructor", FunctionSignature(nullptr, args), isForeign), vis(vis) {
   if (vis == INVALID) throw InternalError("Invalid visibility", {METADATA_PAIRS});
 }
   
 MethodNode::MethodNode(std::string name, FunctionSignature sig, Visibility vis, bool staticM, bool isForeign):
-  FunctionNode(name, sig, isForeign), vis(vis), staticM(staticM) {
+  FunctionNode(NodeKind::METHOD, name, sig, isForeign), vis(vis), staticM(staticM) {
   if (vis == INVALID) throw InternalError("Invalid visibility", {METADATA_PAIRS});
 }
   
-MemberNode::MemberNode(std::string identifier, TypeList typeList, bool staticM, Visibility vis):
-  DeclarationNode(identifier, typeList), staticM(staticM), vis(vis) {}
+MemberNode::MemberNode(std::string identifier, TypeList typeList, bool staticM, Visibility vis, bool cold):
+  DeclarationNode(NodeKind::MEMBER, identifier, typeList), staticM(staticM), vis(vis), cold(cold) {}
 
 /**
   \brief Macro to help implement the 'visit' functions in each node
@@ -115,8 +178,7 @@ MemberNode::MemberNode(std::string identifier, TypeList typeList, bool staticM,
 */
 #define VISITOR_VISIT_IMPL_FOR(nodeName) \
 void nodeName##Node::visit(ASTVisitorLink visitor) {\
-  auto shared = this->shared_from_this();\
-  visitor->visit##nodeName(Node<nodeName##Node>::staticPtrCast(shared));\
+  visitor->visit##nodeName(linkTo(this));\
 }
 
 VISITOR_VISIT_IMPL_FOR(Block)
@@ -157,46 +219,59 @@ bool AST::operator!=(const AST& rhs) const {
 
 // Printer
 
-/// Macro for easy printing of NoMoreChildrenNode children
-#define PRETTY_PRINT_FOR(child, nameOf) \
-level++;\
-printIndent();\
-println(nameOf":");\
-child->visit(shared_from_this());\
-level--;
+std::string ASTPrinter::print(ASTNode::Link node) {
+  ASTPrinter printer;
+  printer.pending.push_back({node.get(), nullptr, 0});
+  while (!printer.pending.empty()) {
+    auto item = printer.pending.back();
+    printer.pending.pop_back();
+    printer.level = item.level;
+    if (item.label != nullptr) {
+      printer.printIndent();
+      printer.println(fmt::format("{}:", item.label));
+      continue;
+    }
+    // Missing optional children are skipped
+    if (item.node == nullptr) continue;
+    printer.visit(item.node);
+    std::move(printer.scheduled.rbegin(), printer.scheduled.rend(), std::back_inserter(printer.pending));
+    printer.scheduled.clear();
+  }
+  return printer.text;
+}
 
-void ASTPrinter::visitBlock(Node<BlockNode>::Link node) {
+void ASTPrinter::visitBlock(BlockNode* node) {
   printIndent();
   println(fmt::format("Block Node: {}", node->getType()));
   printSubtree(node);
 }
 
-void ASTPrinter::visitExpression(Node<ExpressionNode>::Link node) {
+void ASTPrinter::visitExpression(ExpressionNode* node) {
   printIndent();
   println(fmt::format("Expression Node: {}", node->getToken()));
   printSubtree(node);
 }
 
-void ASTPrinter::visitDeclaration(Node<DeclarationNode>::Link node) {
+void ASTPrinter::visitDeclaration(DeclarationNode* node) {
   printIndent();
   println(fmt::format("Declaration Node: {0} ({1})", node->getIdentifier(), node->getTypeInfo()));
   if (node->notNull(0)) printSubtree(node);
 }
 
-void ASTPrinter::visitType(Node<TypeNode>::Link node) {
+void ASTPrinter::visitType(TypeNode* node) {
   printIndent();
   println(fmt::format("Type Node: {0} {1}", node->getName(),
     node->getAncestors().size() ? "inherits from" + collate(node->getAncestors()) : "\b"));
   printSubtree(node);
 }
 
-void ASTPrinter::visitConstructor(Node<ConstructorNode>::Link node) {
+void ASTPrinter::visitConstructor(ConstructorNode* node) {
   printIndent();
   println(fmt::format("Constructor Node: {}", node->getSignature()));
   if (node->notNull(0)) printSubtree(node);
 }
 
-void ASTPrinter::visitMethod(Node<MethodNode>::Link node) {
+void ASTPrinter::visitMethod(MethodNode* node) {
   printIndent();
   println(fmt::format("Method Node: {0} {1}",
     node->getIdentifier(), node->isStatic() ? "(static)" : ""));
@@ -205,56 +280,58 @@ void ASTPrinter::visitMethod(Node<MethodNode>::Link node) {
   if (node->notNull(0)) printSubtree(node);
 }
 
-void ASTPrinter::visitMember(Node<MemberNode>::Link node) {
+void ASTPrinter::visitMember(MemberNode* node) {
   printIndent();
-  println(fmt::format("Member Node: {0} ({1}) {2}",
-    node->getIdentifier(), node->getTypeInfo(), node->isStatic() ? "(static)" : ""));
+  println(fmt::format("Member Node: {0} ({1}) {2}{3}",
+    node->getIdentifier(), node->getTypeInfo(), node->isStatic() ? "(static)" : "",
+    node->isCold() ? "(cold)" : ""));
   if (node->notNull(0)) printSubtree(node);
 }
 
-void ASTPrinter::visitBranch(Node<BranchNode>::Link node) {
+void ASTPrinter::visitBranch(BranchNode* node) {
   printIndent();
   println("Branch Node:");
-  PRETTY_PRINT_FOR(node->condition(), "Condition");
-  PRETTY_PRINT_FOR(node->success(), "Success");
-  PRETTY_PRINT_FOR(node->getChildren()[2], "Failiure");
+  auto children = node->getChildSpan();
+  printLabeled(children[0], "Condition");
+  printLabeled(children[1], "Success");
+  if (children[2] != nullptr) printLabeled(children[2], "Failiure");
 }
 
-void ASTPrinter::visitLoop(Node<LoopNode>::Link node) {
+void ASTPrinter::visitLoop(LoopNode* node) {
   printIndent();
   println("Loop Node:");
   for (auto init : node->inits()) {
-    PRETTY_PRINT_FOR(init, "Init");
+    printLabeled(init, "Init");
   }
   if (node->condition() != nullptr) {
-    PRETTY_PRINT_FOR(node->condition(), "Condition");
+    printLabeled(node->condition().get(), "Condition");
   }
   for (auto upd : node->updates()) {
-    PRETTY_PRINT_FOR(upd, "Update");
+    printLabeled(upd, "Update");
   }
   if (node->code() != nullptr) {
-    PRETTY_PRINT_FOR(node->code(), "Code");
+    printLabeled(node->code().get(), "Code");
   }
 }
 
-void ASTPrinter::visitReturn(Node<ReturnNode>::Link node) {
+void ASTPrinter::visitReturn(ReturnNode* node) {
   printIndent();
   println("Return Node:");
-  if (node->value() != nullptr) PRETTY_PRINT_FOR(node->value(), "Value");
+  if (node->value() != nullptr) printLabeled(node->value().get(), "Value");
 }
 
-void ASTPrinter::visitBreakLoop(Node<BreakLoopNode>::Link node) {
+void ASTPrinter::visitBreakLoop(BreakLoopNode* node) {
   printIndent();
   println("Break Loop:");
   printSubtree(node);
 }
 
-void ASTPrinter::visitFunction(Node<FunctionNode>::Link node) {
+void ASTPrinter::visitFunction(FunctionNode* node) {
   printIndent();
   println(fmt::format("Function {0}: {1}",
     node->isAnon() ? "<anonymous>" : node->getIdentifier(), node->getSignature()));
   if (node->code() != nullptr) {
-    PRETTY_PRINT_FOR(node->code(), "Code");
+    printLabeled(node->code().get(), "Code");
   } else {
     level++;
     printIndent();
@@ -263,8 +340,6 @@ void ASTPrinter::visitFunction(Node<FunctionNode>::Link node) {
   }
 }
 
-#undef PRETTY_PRINT_FOR
-
 // Equality boilerplate
 
 bool BlockNode::operator==(const ASTNode& rhs) const {
@@ -287,7 +362,7 @@ bool ExpressionNode::operator!=(const ASTNode& rhs) const {
 
 bool DeclarationNode::operator==(const ASTNode& rhs) const {
   if (!ASTNode::operator==(rhs)) return false;
-  auto decl = dynamic_cast<const DeclarationNode&>(rhs);
+  auto& decl = dynamic_cast<const DeclarationNode&>(rhs);
   if (this->identifier != decl.identifier) return false;
   if (this->info != decl.info) return false;
   return true;
@@ -298,7 +373,7 @@ bool DeclarationNode::operator!=(const ASTNode& rhs) const {
 
 bool TypeNode::operator==(const ASTNode& rhs) const {
   if (!ASTNode::operator==(rhs)) return false;
-  auto decl = dynamic_cast<const TypeNode&>(rhs);
+  auto& decl = dynamic_cast<const TypeNode&>(rhs);
   if (this->name != decl.name) return false;
   if (this->inheritsFrom != decl.inheritsFrom) return false;
   return true;
@@ -309,7 +384,7 @@ bool TypeNode::operator!=(const ASTNode& rhs) const {
 
 bool FunctionNode::operator==(const ASTNode& rhs) const {
   if (!ASTNode::operator==(rhs)) return false;
-  auto fun = dynamic_cast<const FunctionNode&>(rhs);
+  auto& fun = dynamic_cast<const FunctionNode&>(rhs);
   if (this->ident != fun.ident) return false;
   if (this->sig != fun.sig) return false;
   if (this->foreign != fun.foreign) return false;
@@ -321,7 +396,7 @@ bool FunctionNode::operator!=(const ASTNode& rhs) const {
 
 bool ConstructorNode::operator==(const ASTNode& rhs) const {
   if (!FunctionNode::operator==(rhs)) return false;
-  auto constr = dynamic_cast<const ConstructorNode&>(rhs);
+  auto& constr = dynamic_cast<const ConstructorNode&>(rhs);
   if (this->vis != constr.vis) return false;
   return true;
 }
@@ -331,7 +406,7 @@ bool ConstructorNode::operator!=(const ASTNode& rhs) const {
 
 bool MethodNode::operator==(const ASTNode& rhs) const {
   if (!FunctionNode::operator==(rhs)) return false;
-  auto meth = dynamic_cast<const MethodNode&>(rhs);
+  auto& meth = dynamic_cast<const MethodNode&>(rhs);
   if (this->vis != meth.vis) return false;
   if (this->staticM != meth.staticM) return false;
   return true;
@@ -342,9 +417,10 @@ bool MethodNode::operator!=(const ASTNode& rhs) const {
 
 bool MemberNode::operator==(const ASTNode& rhs) const {
   if (!DeclarationNode::operator==(rhs)) return false;
-  auto mem = dynamic_cast<const MemberNode&>(rhs);
+  auto& mem = dynamic_cast<const MemberNode&>(rhs);
   if (this->vis != mem.vis) return false;
   if (this->staticM != mem.staticM) return false;
+  if (this->cold != mem.cold) return false;
   return true;
 }
 bool MemberNode::operator!=(const ASTNode& rhs) const {
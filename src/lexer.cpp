@@ -1,36 +1,133 @@
 #include "lexer.hpp"
 
+namespace {
+  /// Characters that end an identifier
+  const CharSet& identifierDelimiters() {
+    static const CharSet delimiters = [] {
+      std::string chars = "\n";
+      for (char c : Operator::operatorCharacters) chars += c;
+      for (auto construct : TT::constructs) chars += construct.getData();
+      return CharSet(chars);
+    }();
+    return delimiters;
+  }
+  /// Like identifierDelimiters, but also stops at escapes, which are errors in identifiers
+  const CharSet& identifierStoppers() {
+    static const CharSet stoppers = [] {
+      std::string chars = "\n\\";
+      for (char c : Operator::operatorCharacters) chars += c;
+      for (auto construct : TT::constructs) chars += construct.getData();
+      return CharSet(chars);
+    }();
+    return stoppers;
+  }
+  /// Same characters as std::isspace in the "C" locale
+  const CharSet& whitespace() {
+    static const CharSet spaces(" \t\n\v\f\r");
+    return spaces;
+  }
+  const CharSet& newline() {
+    static const CharSet newlines("\n");
+    return newlines;
+  }
+  const CharSet& stringSpecials() {
+    static const CharSet specials("\"\\");
+    return specials;
+  }
+  const CharSet& commentStar() {
+    static const CharSet stars("*");
+    return stars;
+  }
+}
+
 Lexer::Lexer(std::string code, std::string sourceOfCode):
-  code(code), sourceOfCode(sourceOfCode) {}
+  ownedCode(std::move(code)), sourceOfCode(sourceOfCode) {
+  this->code = ownedCode.data();
+  codeLength = ownedCode.length();
+  fileId = SourceManager::get().addFile(sourceOfCode, this->code, codeLength);
+  tokens = TokenStore(this->code, fileId, viewTokens);
+}
+
+Lexer::Lexer(std::unique_ptr<MappedFile> file, std::string sourceOfCode):
+  mappedCode(std::move(file)), viewTokens(true), sourceOfCode(sourceOfCode) {
+  code = mappedCode->data();
+  codeLength = mappedCode->size();
+  fileId = SourceManager::get().addFile(sourceOfCode, code, codeLength);
+  tokens = TokenStore(code, fileId, viewTokens);
+}
+
+Lexer::Lexer(const Lexer& whole, uint64_t begin):
+  code(whole.code),
+  codeLength(whole.codeLength),
+  viewTokens(whole.viewTokens),
+  fileId(whole.fileId),
+  tokens(whole.code, whole.fileId, whole.viewTokens),
+  pos(begin) {}
 
 std::unique_ptr<Lexer> Lexer::tokenize(std::string code, std::string sourceOfCode) {
-  Lexer* lx = new Lexer(code, sourceOfCode);
+  Lexer* lx = new Lexer(std::move(code), sourceOfCode);
   lx->processTokens();
   return std::unique_ptr<Lexer>(lx);
 }
 
+std::unique_ptr<Lexer> Lexer::tokenize(
+  std::string code,
+  std::string sourceOfCode,
+  unsigned chunkCount
+) {
+  Lexer* lx = new Lexer(std::move(code), sourceOfCode);
+  lx->processTokensInChunks(chunkCount);
+  return std::unique_ptr<Lexer>(lx);
+}
+
+std::unique_ptr<Lexer> Lexer::open(std::string code, std::string sourceOfCode) {
+  return std::unique_ptr<Lexer>(new Lexer(std::move(code), sourceOfCode));
+}
+
+std::unique_ptr<Lexer> Lexer::openFile(fs::path file) {
+  return std::unique_ptr<Lexer>(new Lexer(std::make_unique<MappedFile>(file), file.string()));
+}
+
+std::unique_ptr<Lexer> Lexer::tokenizeFile(fs::path file, unsigned chunkCount) {
+  auto lx = std::unique_ptr<Lexer>(
+    new Lexer(std::make_unique<MappedFile>(file), file.string()));
+  if (chunkCount > 1 && lx->codeLength >= parallelThreshold) {
+    lx->processTokensInChunks(chunkCount);
+  } else {
+    lx->processTokens();
+  }
+  return lx;
+}
+
 bool Lexer::isIdentifierChar() const noexcept {
-  bool isOperatorChar = Operator::operatorCharacters.find(current()) !=
-    Operator::operatorCharacters.end();
-  bool isConstructChar = TT::findConstruct(current()) != TT::UNPROCESSED;
-  return !isOperatorChar && !isConstructChar && !isEOL() && !isEOF();
+  return !identifierDelimiters().contains(current()) && !isEOF();
+}
+
+void Lexer::skipUntil(const CharSet& set) noexcept {
+  pos = static_cast<uint64_t>(set.findFirstIn(code + pos, code + codeLength) - code);
+}
+
+void Lexer::skipWhile(const CharSet& set, uint64_t limit) noexcept {
+  pos = static_cast<uint64_t>(set.findFirstNotIn(code + pos, code + limit) - code);
 }
 
 Fixity Lexer::determineFixity(
+  std::size_t before,
   Fixity afterBinaryOrPrefix,
   Fixity afterIdentOrParen,
   Fixity otherCases
 ) const noexcept {
-  if (tokens.empty()) return otherCases;
-  auto tok = tokens.back();
-  if (tok.isOp() && (tok.op().hasArity(BINARY) || tok.op().hasFixity(PREFIX))) {
+  if (before == 0) return otherCases;
+  auto prev = before - 1;
+  bool prevIsOp = tokens.isOp(prev);
+  if (prevIsOp && (tokens.op(prev).hasArity(BINARY) || tokens.op(prev).hasFixity(PREFIX))) {
     // If the thing before this op is a binary op or a prefix unary, it means this
     // must be a prefix unary
     return afterBinaryOrPrefix;
   } else if (
-    tok.isTerminal() ||
-    tok.type == TT::PAREN_RIGHT ||
-    (tok.isOp() && tok.op().hasFixity(POSTFIX))
+    TT::isTerminal(tokens.type(prev)) ||
+    tokens.type(prev) == TT::PAREN_RIGHT ||
+    (prevIsOp && tokens.op(prev).hasFixity(POSTFIX))
   ) {
     // If the thing before was an identifier/paren (or the postfix op attached to an
     // ident), then this must be a postfix unary or a binary infix
@@ -39,25 +136,68 @@ Fixity Lexer::determineFixity(
   return otherCases;
 }
 
-TokenType Lexer::determineParenBeginType() const noexcept {
-  if (tokens.empty()) return TT::PAREN_LEFT;
-  const auto prev = tokens.back();
+TokenType Lexer::determineParenBeginType(std::size_t before) const noexcept {
+  if (before == 0) return TT::PAREN_LEFT;
+  auto prev = before - 1;
+  auto prevType = tokens.type(prev);
   bool isCall =
-    prev.type == TT::IDENTIFIER ||
-    prev.type == TT::PAREN_RIGHT || prev.type == TT::CALL_END ||
-    (prev.isOp() && prev.op().hasFixity(POSTFIX));
+    prevType == TT::IDENTIFIER ||
+    prevType == TT::PAREN_RIGHT || prevType == TT::CALL_END ||
+    (prevType == TT::OPERATOR && tokens.op(prev).hasFixity(POSTFIX));
   return isCall ? TT::CALL_BEGIN : TT::PAREN_LEFT;
 }
 
+Operator::Index Lexer::pickOperator(
+  std::size_t before,
+  const Operator::SymbolMatch& symbolMatch
+) const noexcept {
+  if (symbolMatch.candidateCount == 1) return symbolMatch.candidates[0];
+  // Symbols like "++" or "-" are used by multiple operators, so figure out if
+  // it's prefix, or postfix/infix (whichever one the other operator is)
+  auto candidatesEnd = symbolMatch.candidates.begin() + symbolMatch.candidateCount;
+  bool hasPostfix = std::any_of(symbolMatch.candidates.begin(), candidatesEnd,
+    [](Operator::Index idx) {return Operator::list[idx].hasFixity(POSTFIX);});
+  Fixity type = determineFixity(before, PREFIX, hasPostfix ? POSTFIX : INFIX, PREFIX);
+  Operator::Index opIdx = symbolMatch.candidates[0];
+  for (std::size_t i = 0; i < symbolMatch.candidateCount; i++) {
+    if (Operator::list[symbolMatch.candidates[i]].hasFixity(type)) {
+      opIdx = symbolMatch.candidates[i];
+    }
+  }
+  return opIdx;
+}
+
+void Lexer::matchParen(std::size_t at, std::stack<std::size_t>& parenStack) {
+  auto type = tokens.type(at);
+  if (type == TT::PAREN_LEFT || type == TT::CALL_BEGIN || type == TT::SQPAREN_LEFT) {
+    parenStack.push(at);
+    return;
+  }
+  if (type != TT::PAREN_RIGHT && type != TT::SQPAREN_RIGHT) return;
+  if (parenStack.empty()) throw "Mismatched parenthesis"_syntax + tokens.trace(at);
+  auto openType = tokens.type(parenStack.top());
+  tokens.setMatchingParen(parenStack.top(), at);
+  parenStack.pop();
+  if (openType == TT::CALL_BEGIN) {
+    type = TT::CALL_END;
+    tokens.setType(at, type);
+  }
+  bool isMatched =
+    (openType == TT::PAREN_LEFT && type == TT::PAREN_RIGHT) ||
+    (openType == TT::SQPAREN_LEFT && type == TT::SQPAREN_RIGHT) ||
+    (openType == TT::CALL_BEGIN && type == TT::CALL_END);
+  if (!isMatched) throw "Mismatched parenthesis"_syntax + tokens.trace(at);
+}
+
 inline void Lexer::handleMultiLineComments() {
   // TODO: nested comments
-  Position start = getPos();
-  if (current(2) == "/*") {
+  uint64_t start = pos;
+  if (isAt("/*")) {
     skip(2); // Skip "/*"
-    while (current(2) != "*/") {
+    // Jump from star to star until one of them ends the comment
+    for (skipUntil(commentStar()); !isAt("*/"); skipUntil(commentStar())) {
       if (isEOF()) throw "Multi-line comment not closed"_syntax + traceFrom(start);
-      else if (isEOL()) nextLine();
-      skip(1); // Skip characters one by one until we hit the end of the comment
+      skip(1);
     }
     skip(2); // Skip "*/"
   }
@@ -65,7 +205,7 @@ inline void Lexer::handleMultiLineComments() {
 
 unsigned Lexer::readRadix() {
   if (current() == '0' && isalpha(peekAhead(1))) {
-    Position zeroPos = getPos();
+    uint64_t zeroPos = pos;
     auto radixIdent = peekAhead(1);
     skip(2); // Skip the "0x", etc
     switch (radixIdent) {
@@ -94,40 +234,59 @@ bool Lexer::isValidForRadix(char c, unsigned radix) const noexcept {
 
 #pragma GCC diagnostic pop
 
-Token Lexer::readNumber(unsigned radix) {
-  Position start = getPos();
+void Lexer::readNumber() {
+  uint64_t start = pos;
+  unsigned radix = readRadix();
+  uint64_t digitsStart = pos;
   if (current() == '0' && std::isdigit(peekAhead(1)))
     throw "Numbers cannot begin with '0'"_syntax + traceFor(1);
-  std::string number = "";
+  auto number = [=]() {
+    return std::string(code + digitsStart, pos - digitsStart);
+  };
   bool isFloat = false;
   while (!isEOF()) {
     if (current() == '.') {
       if (isFloat)
-        throw "multiple decimal points"_badfloat(number) + traceFrom(start);
+        throw "multiple decimal points"_badfloat(number()) + traceFrom(start);
       isFloat = true;
-      number += current();
       skip(1);
     } else if (isValidForRadix(current(), radix)) {
-      number += current();
       skip(1);
     } else if (isIdentifierChar()) {
-      throw "Invalid character in number: {}"_syntax(current()) + traceFrom(start);
+      throw "Invalid character in number: {}"_syntax(current()) + traceFrom(digitsStart);
     } else {
       break;
     }
   }
-  noIncrement();
-  if (number.back() == '.')
-    throw "missing digits after decimal point"_badfloat(number) + traceFrom(start);
+  if (pos == digitsStart)
+    throw "Missing digits after radix"_syntax + traceFrom(digitsStart);
+  if (code[pos - 1] == '.')
+    throw "missing digits after decimal point"_badfloat(number()) + traceFrom(digitsStart);
   if (radix != 10 && isFloat)
-    throw "floats must be decimal"_badfloat(number) + traceFrom(start);
-  if (radix != 10)
-    number = std::to_string(std::stoll(number, nullptr, static_cast<int>(radix)));
-  return Token(isFloat ? TT::FLOAT : TT::INTEGER, number, traceFrom(start));
+    throw "floats must be decimal"_badfloat(number()) + traceFrom(digitsStart);
+  // The digits are parsed here once, so nothing after the lexer needs to look at the text
+  if (isFloat) {
+    double value;
+    parseFloat(code + digitsStart, code + pos, value);
+    tokens.pushFloat(traceFrom(start), value);
+  } else {
+    int64_t value;
+    if (!parseInteger(code + digitsStart, code + pos, radix, value)) {
+      // Decimal digits are let through for every radix by isValidForRadix
+      auto badDigit = std::find_if(code + digitsStart, code + pos, [=](char c) {
+        return static_cast<unsigned>(c - '0') >= radix && c <= '9';
+      });
+      if (badDigit != code + pos)
+        throw "Invalid digit in base {} number: {}"_syntax(radix, *badDigit) + traceFrom(start);
+      throw "Integer literal is too large"_syntax + traceFrom(start);
+    }
+    tokens.pushInteger(traceFrom(start), value);
+  }
+  noIncrement();
 }
 
 char Lexer::readEscapeSeq() {
-  Position escChar = getPos();
+  uint64_t escChar = pos;
   char escapedChar = peekAhead(1);
   skip(2); // Skip escape code, eg '\n', '\t'
   auto charIt = singleCharEscapeSeqences.find(escapedChar);
@@ -163,50 +322,183 @@ char Lexer::readEscapeSeq() {
   throw badEscape("\\"s + escapedChar, "") + traceFrom(escChar);
 }
 
+void Lexer::skipHashbang() noexcept {
+  if (current() == '#' && peekAhead(1) == '!') skipUntil(newline());
+}
+
+void Lexer::finishTokens() {
+  if (!openParens.empty()) {
+    // TODO: print error for each paren left in the stack
+    throw "Unmatched parenthesis"_syntax + tokens.trace(openParens.top());
+  }
+  tokens.push(TT::FILE_END, traceFor(1), "");
+  finished = true;
+}
+
 void Lexer::processTokens() {
   // Keep track of paren and call beginnings
   // When a paren close is found, the top of the stack is popped, and determines if
   // the paren is TT::PAREN_RIGHT or TT::CALL_END
-  std::stack<Token> parenStack {};
+  skipHashbang();
+  lexUntil(codeLength, &openParens);
+  finishTokens();
+}
+
+bool Lexer::lexMore() {
+  if (finished) return false;
+  if (pos == 0) skipHashbang();
+  std::size_t oldSize = tokens.size();
+  // Comments and whitespace don't make any tokens, so there might be nothing in a window
+  while (tokens.size() == oldSize && !isEOF()) {
+    lexUntil(std::min(pos + streamWindow, codeLength), &openParens);
+  }
+  if (isEOF()) finishTokens();
+  return true;
+}
+
+std::size_t Lexer::discardTokensBefore(std::size_t at) {
+  if (at < tokens.size() / 2) return 0;
+  tokens.discardBefore(at);
+  // Parens still open were opened after the statements that were discarded
+  std::vector<std::size_t> parens;
+  for (; !openParens.empty(); openParens.pop()) parens.push_back(openParens.top() - at);
+  for (auto it = parens.rbegin(); it != parens.rend(); ++it) openParens.push(*it);
+  return at;
+}
+
+Lexer::Chunk Lexer::lexChunk(uint64_t begin, uint64_t end) const {
+  Lexer chunkLexer(*this, begin);
+  Chunk chunk;
+  chunk.begin = begin;
+  chunk.end = end;
+  try {
+    if (begin == 0) chunkLexer.skipHashbang();
+    chunkLexer.lexUntil(end, nullptr);
+  } catch (...) {
+    chunk.error = std::current_exception();
+  }
+  chunk.tokens = std::move(chunkLexer.tokens);
+  chunk.stoppedAt = chunkLexer.pos;
+  return chunk;
+}
+
+void Lexer::processTokensInChunks(unsigned chunkCount) {
+  if (chunkCount <= 1) {
+    processTokens();
+    return;
+  }
+  // Only strings and comments can contain newlines, so start each chunk after one
+  std::vector<uint64_t> bounds {0};
+  for (unsigned i = 1; i < chunkCount; i++) {
+    uint64_t at = std::max(bounds.back(), codeLength / chunkCount * i);
+    auto newline = static_cast<const char*>(std::memchr(code + at, '\n', codeLength - at));
+    bounds.push_back(newline == nullptr ? codeLength : static_cast<uint64_t>(newline - code) + 1);
+  }
+  bounds.push_back(codeLength);
+  
+  std::vector<Chunk> chunks(chunkCount);
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < chunkCount; i++) {
+    workers.emplace_back([this, &chunks, &bounds, i] {
+      chunks[i] = lexChunk(bounds[i], bounds[i + 1]);
+    });
+  }
+  chunks[0] = lexChunk(bounds[0], bounds[1]);
+  for (auto& worker : workers) worker.join();
+  
+  // If a string or comment crossed into the next chunk, that chunk was lexed from the
+  // middle of it, so lex it again starting from where the previous one really stopped
+  for (std::size_t i = 1; i < chunks.size(); i++) {
+    const Chunk& prev = chunks[i - 1];
+    // Nothing after an error matters
+    if (prev.error) break;
+    if (prev.stoppedAt != chunks[i].begin) {
+      chunks[i] = lexChunk(std::max(prev.stoppedAt, chunks[i].begin), chunks[i].end);
+    }
+  }
   
-  // Ignore hashbang line
-  if (code[0] == '#' && code[1] == '!') {
-    while (!isEOL() && !isEOF()) skip(1);
+  // Put the chunks together, remembering where each of them starts
+  std::vector<std::size_t> chunkStarts;
+  std::size_t tokenCount = 1;
+  for (const auto& chunk : chunks) tokenCount += chunk.tokens.size();
+  tokens.reserve(tokenCount);
+  for (auto& chunk : chunks) {
+    chunkStarts.push_back(tokens.size());
+    tokens.append(chunk.tokens);
+    chunk.tokens = TokenStore();
   }
+  chunkStarts.push_back(tokens.size());
   
-  for (; pos != code.length(); skip(1)) {
+  // Chunks were lexed without knowing the tokens before them, so the fixity of operators and
+  // the kind of parens at their start might be wrong; also, the parens can only be matched
+  // across the whole input
+  for (std::size_t c = 0; c < chunks.size(); c++) {
+    bool mightBeWrong = true;
+    for (std::size_t i = chunkStarts[c]; i < chunkStarts[c + 1]; i++) {
+      auto oldType = tokens.type(i);
+      auto oldIdx = tokens.isOp(i) ? tokens.opIndex(i) : 0;
+      if (mightBeWrong) {
+        if (oldType == TT::PAREN_LEFT || oldType == TT::CALL_BEGIN) {
+          tokens.setType(i, determineParenBeginType(i));
+        } else if (oldType == TT::OPERATOR) {
+          auto trace = tokens.trace(i);
+          auto symbol = code + trace.getOffset();
+          auto match = Operator::matchSymbol(symbol, symbol + trace.getLength());
+          tokens.setOpIndex(i, pickOperator(i, match));
+        }
+      }
+      matchParen(i, openParens);
+      // Tokens only depend on the one right before them, so stop fixing them after one is unchanged
+      mightBeWrong = tokens.type(i) != oldType || (tokens.isOp(i) && tokens.opIndex(i) != oldIdx);
+    }
+    if (chunks[c].error) std::rethrow_exception(chunks[c].error);
+  }
+  pos = codeLength;
+  finishTokens();
+}
+
+void Lexer::lexUntil(uint64_t end, std::stack<std::size_t>* parenStack) {
+  for (; pos < end; skip(1)) {
     // Comments
-    if (current(2) == "//") {
-      while (!isEOL() && !isEOF()) skip(1);
+    if (isAt("//")) {
+      skipUntil(newline());
       continue;
     }
     handleMultiLineComments();
-    // Count lines
-    if (isEOL()) nextLine();
     // Ignore whitespace
-    if (std::isspace(current())) continue;
+    if (whitespace().contains(current())) {
+      skipWhile(whitespace(), end);
+      noIncrement();
+      continue;
+    }
     // Check for number literals
     if (std::isdigit(current())) {
-      unsigned radix = readRadix();
-      tokens.push_back(readNumber(radix));
+      readNumber();
       continue;
     }
     // Check for string literals
     if (current() == '"') {
-      Position start = getPos();
+      uint64_t start = pos;
       skip(1); // Skip the quote
-      std::string str = "";
-      while (current() != '"') {
+      uint64_t strStart = pos;
+      // Only strings with escape sequences need a processed copy of their contents
+      bool hasEscapes = false;
+      std::string escaped = "";
+      while (true) {
+        // Copy plain runs of characters all at once
+        uint64_t runStart = pos;
+        skipUntil(stringSpecials());
+        if (hasEscapes) escaped.append(code + runStart, pos - runStart);
         if (isEOF())
           throw "String literal has unmatched quote"_syntax + traceFrom(start);
-        if (current() == '\\') {
-          str += readEscapeSeq();
-          continue;
-        }
-        str += current();
-        skip(1);
+        if (current() == '"') break;
+        // Otherwise, it's an escape
+        if (!hasEscapes) escaped.assign(code + strStart, pos - strStart);
+        hasEscapes = true;
+        escaped += readEscapeSeq();
       }
-      tokens.push_back(Token(TT::STRING, str, traceFrom(start)));
+      if (hasEscapes) tokens.push(TT::STRING, traceFrom(start), escaped);
+      else tokens.push(TT::STRING, traceFrom(start));
       continue;
     }
     // TODO: split into function
@@ -214,99 +506,51 @@ void Lexer::processTokens() {
     TokenType construct = TT::findConstruct(current());
     if (construct != TT::UNPROCESSED) {
       construct = construct == TT::PAREN_LEFT ?
-        determineParenBeginType() : construct;
-      auto constrTok = Token(construct, current(1), traceFor(1));
-      if (construct == TT::PAREN_LEFT || construct == TT::CALL_BEGIN || construct == TT::SQPAREN_LEFT) {
-        parenStack.push(constrTok);
-      }
-      auto mismatchedParen = "Mismatched parenthesis"_syntax + constrTok.trace;
-      if (construct == TT::PAREN_RIGHT || construct == TT::SQPAREN_RIGHT) {
-        if (parenStack.empty()) throw mismatchedParen;
-        Token topOfStack = parenStack.top();
-        parenStack.pop();
-        if (topOfStack.type == TT::CALL_BEGIN) {
-          constrTok.type = construct = TT::CALL_END;
-        }
-        bool isMatched =
-          (topOfStack.type == TT::PAREN_LEFT && construct == TT::PAREN_RIGHT) ||
-          (topOfStack.type == TT::SQPAREN_LEFT && construct == TT::SQPAREN_RIGHT) ||
-          (topOfStack.type == TT::CALL_BEGIN && construct == TT::CALL_END);
-        if (!isMatched) throw mismatchedParen;
-      }
-      tokens.push_back(constrTok);
+        determineParenBeginType(tokens.size()) : construct;
+      tokens.push(construct, traceFor(1));
+      // Chunks leave the matching for later, since their parens can be opened in other chunks
+      if (parenStack != nullptr) matchParen(tokens.size() - 1, *parenStack);
       continue;
     }
     // Check for fat arrows
-    if (current(2) == "=>") {
-      tokens.push_back(Token(TT::FAT_ARROW, "=>", traceFor(2)));
+    if (isAt("=>")) {
+      tokens.push(TT::FAT_ARROW, traceFor(2));
       skip(2);
       continue;
     }
     // Check for operators
-    auto operatorIt = Operator::list.end();
-    for (auto op = Operator::list.begin(); op != Operator::list.end(); ++op) {
-      bool doesNameMatch =
-        current(static_cast<uint>(op->getSymbol().length())) == op->getSymbol();
-      if (!doesNameMatch) continue;
-      Fixity type;
-      if (op->hasSymbol("++") || op->hasSymbol("--")) {
-        // Figure out if it's postfix or prefix
-        type = determineFixity(PREFIX, POSTFIX, PREFIX);
-      } else if (op->hasSymbol("+") || op->hasSymbol("-")) {
-        // Figure out if it's postfix or infix
-        type = determineFixity(PREFIX, INFIX, PREFIX);
-      } else {
-        // This operator is unambiguous
-        operatorIt = op;
-        break;
-      }
-      // Refine the search using the fixity information
-      operatorIt = std::find_if(ALL(Operator::list), [=](const Operator& currentOp) {
-        return op->hasSymbol(currentOp.getSymbol()) && currentOp.getFixity() == type;
-      });
-      break;
-    }
-    if (operatorIt != Operator::list.end()) {
-      Position operatorStart = getPos();
-      skip(operatorIt->getSymbol().length());
-      tokens.push_back(Token(
-        TT::OPERATOR,
-        static_cast<Operator::Index>(operatorIt - Operator::list.begin()),
-        traceFrom(operatorStart)
-      ));
+    auto symbolMatch = Operator::matchSymbol(code + pos, code + codeLength);
+    if (symbolMatch.length != 0) {
+      Operator::Index opIdx = pickOperator(tokens.size(), symbolMatch);
+      uint64_t operatorStart = pos;
+      skip(symbolMatch.length);
+      tokens.pushOperator(opIdx, traceFrom(operatorStart));
       noIncrement();
       continue;
     }
     // Get a string until the char can't be part of an identifier
-    std::string str = "";
-    Position identStart = getPos();
-    while (isIdentifierChar()) {
-      if (current() == '\\')
-        throw "Extraneous escape character '{}'"_syntax(peekAhead(1)) + traceFor(2);
-      str += current();
-      skip(1);
-    }
+    uint64_t identStart = pos;
+    skipUntil(identifierStoppers());
+    if (current() == '\\')
+      throw "Extraneous escape character '{}'"_syntax(peekAhead(1)) + traceFor(2);
+    auto str = TokenText::view(code + identStart, pos - identStart);
+    auto trace = traceFrom(identStart);
     noIncrement();
     // No point in looking for it anywhere if it's empty
-    if (str.length() == 0) continue;
+    if (str.empty()) continue;
     // Check for boolean literals
     if (str == "true" || str == "false") {
-      tokens.push_back(Token(TT::BOOLEAN, str, traceFrom(identStart)));
+      tokens.push(TT::BOOLEAN, trace);
       continue;
     }
     // Check for keywords
     TokenType keyword = TT::findKeyword(str);
     if (keyword != TT::UNPROCESSED) {
-      tokens.push_back(Token(keyword, str, traceFrom(identStart)));
+      tokens.push(keyword, trace);
       continue;
     }
     
     // Must be an identifier
-    tokens.push_back(Token(TT::IDENTIFIER, str, traceFrom(identStart)));
-  }
-  if (!parenStack.empty()) {
-    // TODO: print error for each paren left in the stack
-    throw "Unmatched parenthesis"_syntax + parenStack.top().trace;
+    tokens.push(TT::IDENTIFIER, trace);
   }
-  tokens.push_back(Token(TT::FILE_END, traceFor(1)));
 }
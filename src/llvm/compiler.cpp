@@ -3,17 +3,17 @@
 
 Compiler::Compiler(fs::path rootScript, fs::path output):
   rootScript(rootScript), output(output) {
-  std::ifstream file(rootScript);
-  std::stringstream buffer;
-  buffer << file.rdbuf();
-  auto lx = Lexer::tokenize(buffer.str(), rootScript);
+  auto lx = Lexer::openFile(rootScript);
   auto mc = ModuleCompiler::create(
     pd.types,
     "temp_module_name",
-    TokenParser::parse(lx->getTokens()),
+    AST(Node<BlockNode>::make(ROOT_BLOCK)),
     true
   );
-  mc->compile();
+  TokenParser::parseStatements(*lx, [&mc](ASTNode::Link statement) {
+    mc->compileStatement(statement);
+  });
+  mc->finish();
   pd.rootModule = std::unique_ptr<llvm::Module>(mc->getModule());
 }
 
@@ -94,12 +94,18 @@ ModuleCompiler::ModuleCompiler(std::string moduleName, AST ast, bool isRoot):
   voidType(llvm::Type::getVoidTy(*context)),
   booleanType(llvm::Type::getInt1Ty(*context)),
   voidPtrType(llvm::PointerType::getUnqual(llvm::IntegerType::get(*context, 8))),
+  unionTagType(llvm::IntegerType::get(*context, 32)),
+  // The allowed types are known statically, from the variable's type
   taggedUnionType(llvm::StructType::create(*context, {
-    voidPtrType, // Pointer to data
-    integerType, // TypeListId with allowed types
-    integerType, // TypeId with currently stored type
+    unionTagType, // Index of the TypeId with currently stored type
+    integerType, // The data if it fits in 8 bytes, otherwise a pointer to it
   }, "tagged_union")),
   taggedUnionPtrType(llvm::PointerType::getUnqual(taggedUnionType)),
+  typeInfoType(llvm::StructType::create(*context, {
+    voidPtrType, // Name
+    integerType, // Size
+    integerType, // Alignment
+  }, "_xyl_TypeInfo")),
   voidTid(TypeId::createBasic("Void", voidType)),
   integerTid(TypeId::createBasic("Integer", integerType)),
   floatTid(TypeId::createBasic("Float", floatType)),
@@ -121,14 +127,12 @@ void ModuleCompiler::insertRuntimeFuncDecls() {
   // Insert declarations for these functions in IR, they are linked in later
   using FT = llvm::FunctionType;
   const std::unordered_map<std::string, llvm::FunctionType*> rtFunMap {
-    {"_xyl_checkTypeCompat",
-      FT::get(booleanType, {taggedUnionPtrType, taggedUnionPtrType}, false)},
     {"_xyl_typeOf", // TODO return string type, not void ptr
       FT::get(voidPtrType, {taggedUnionPtrType}, false)},
-    {"_xyl_typeErrIfIncompatible",
-      FT::get(voidType, {taggedUnionPtrType, taggedUnionPtrType}, false)},
-    {"_xyl_typeErrIfIncompatibleTid",
-      FT::get(voidType, {integerType, taggedUnionPtrType}, false)},
+    {"_xyl_typeErr",
+      FT::get(voidType, {voidPtrType, unionTagType}, false)},
+    {"_xyl_registerTypes",
+      FT::get(voidType, {typeInfoType->getPointerTo(), integerType}, false)},
     {"_xyl_finish", // TODO arg1 should be string type
       FT::get(voidType, {voidPtrType, integerType}, false)},
     {"malloc",
@@ -144,6 +148,10 @@ void ModuleCompiler::insertRuntimeFuncDecls() {
       std::make_shared<FunctionWrapper>(fun, FunctionSignature("", {}), functionTid)
     });
   }
+  // Lets LLVM move the failed type checks out of the way of the code that passes them
+  auto typeErr = module->getFunction("_xyl_typeErr");
+  typeErr->setDoesNotReturn();
+  typeErr->addFnAttr(llvm::Attribute::Cold);
 }
 
 ModuleCompiler::Link ModuleCompiler::create(
@@ -166,11 +174,36 @@ ModuleCompiler::Link ModuleCompiler::create(
 }
 
 void ModuleCompiler::compile() {
-  ast.getRoot()->visit(shared_from_this());
+  resolver.resolve(ast.getRoot().get());
+  visit(ast.getRoot().get());
+  finish();
+}
+
+void ModuleCompiler::startRootBlock() {
+  if (builder->GetInsertBlock() != nullptr) return;
+  builder->SetInsertPoint(
+    llvm::BasicBlock::Create(*context, "block", functionStack.top()->getValue()));
+}
+
+void ModuleCompiler::compileStatement(ASTNode::Link statement) {
+  // The first statement starts the root block, like compileBlock would
+  startRootBlock();
+  // Types and blocks are still looked up through the parents of nodes, so it needs to be in the tree
+  ast.getRoot()->addChild(statement);
+  resolver.resolveStatement(ast.getRoot().get(), statement.get());
+  visit(statement.get());
+  ast.getRoot()->removeChild(-1);
+}
+
+void ModuleCompiler::finish() {
+  // Input with no statements never started it
+  startRootBlock();
   // If the current block, which is the one that exits from main, has no terminator, add one
   if (!builder->GetInsertBlock()->getTerminator()) {
     builder->CreateRet(llvm::ConstantInt::get(integerType, 0));
   }
+  devirtualize();
+  serializeTypeSet(assignTypeTags());
   std::string str;
   llvm::raw_string_ostream rso(str);
   if (llvm::verifyModule(*module, &rso)) {
@@ -181,67 +214,80 @@ void ModuleCompiler::compile() {
       {"error", rso.str()}
     });
   }
-  serializeTypeSet();
 }
 
-void ModuleCompiler::serializeTypeSet() {
-  /*
-    TODO: do we really want all of this?
-    when doing a runtime type check, the type list to compare against should be constant
-    so theoretically, we can hardcode typelists where we do the checks
+llvm::Constant* ModuleCompiler::typeNameString(AbstractId::Link type) {
+  std::string globalName = fmt::format("_xyl_name_{0}", type->getName());
+  auto str = module->getGlobalVariable(globalName, true);
+  if (str == nullptr) {
+    auto init = llvm::ConstantDataArray::getString(*context, type->getName());
+    str = new llvm::GlobalVariable(*module, init->getType(), true,
+      llvm::GlobalValue::PrivateLinkage, init, globalName);
+  }
+  return llvm::ConstantExpr::getPointerCast(str, voidPtrType);
+}
+
+std::unordered_map<UniqueIdentifier, std::size_t> ModuleCompiler::assignTypeTags() {
+  std::unordered_map<UniqueIdentifier, std::size_t> tags;
+  // taggedTypes is ordered by id, which is a hash of the name
+  std::size_t nextTag = 0;
+  for (const auto& tagged : taggedTypes) tags.insert({tagged.first, nextTag++});
+  for (const auto& check : pendingTypeChecks) lowerTypeCheck(check.first, check.second, tags);
+  pendingTypeChecks.clear();
+  if (auto checkPlaceholder = module->getFunction("_xyl_allowsTag")) {
+    checkPlaceholder->eraseFromParent();
+  }
+  for (const auto& tagged : taggedTypes) {
+    std::string globalName = fmt::format("_xyl_tag_{0}", tagged.second->getName());
+    auto placeholder = module->getGlobalVariable(globalName, true);
+    if (placeholder == nullptr) continue;
+    llvm::ConstantExpr::getPtrToInt(placeholder, unionTagType)->replaceAllUsesWith(
+      llvm::ConstantInt::get(unionTagType, tags[tagged.first], false));
+    placeholder->removeDeadConstantUsers();
+    placeholder->eraseFromParent();
+  }
+  return tags;
+}
 
-    is rtti even necessary?
-  */
-  for (auto tid : *types) {
-    // Array is null terminated
-    auto arrayType = llvm::ArrayType::get(integerType, tid->storedTypeCount());
-    // Stores tid value + array of tids in case it's a type list
-    auto rttiInfoType = llvm::StructType::create(*context, {
-      integerType,
-      arrayType
+void ModuleCompiler::serializeTypeSet(const std::unordered_map<UniqueIdentifier, std::size_t>& tags) {
+  // Nothing can ask about a type that was never stored in a union
+  if (!isRoot || taggedTypes.empty()) return;
+  llvm::DataLayout layout(module);
+  std::size_t count = taggedTypes.size();
+  std::vector<llvm::Constant*> entries(count);
+  for (const auto& tagged : taggedTypes) {
+    llvm::Type* type = tagged.second->getAllocaType();
+    entries[tags.at(tagged.first)] = llvm::ConstantStruct::get(typeInfoType, {
+      typeNameString(tagged.second),
+      llvm::ConstantInt::get(integerType, layout.getTypeAllocSize(type)),
+      llvm::ConstantInt::get(integerType, layout.getABITypeAlignment(type))
     });
-    std::vector<llvm::Constant*> containedTys;
-    containedTys.reserve(tid->storedTypeCount() + 1); // +1 for the null termination
-    if (tid->storedTypeCount() > 1) {
-      auto tlid = PtrUtil<TypeListId>::dynPtrCast(tid);
-      std::transform(ALL(tlid->getTypes()), std::begin(containedTys), [&](auto id) {
-        return llvm::ConstantInt::get(integerType, id->getId(), false);
-      });
-    }
-    containedTys.push_back(llvm::ConstantInt::get(integerType, 0, false));
-    auto rtti = new llvm::GlobalVariable(
-      *module,
-      rttiInfoType,
-      true, // Global is constant
-      llvm::GlobalValue::LinkageTypes::ExternalLinkage,
-      nullptr, // Only set initializer if in root
-      fmt::format("_xyl_rtti_{0}", tid->getName()), // TODO: name mangling for collisions
-      nullptr,
-      llvm::GlobalValue::ThreadLocalMode::NotThreadLocal,
-      0,
-      !isRoot // isExternallyInitialized is true for non-roots
-    );
-    if (isRoot) {
-      auto id = llvm::ConstantInt::get(integerType, tid->getId(), false);
-      auto array = llvm::ConstantArray::get(arrayType, containedTys);
-      auto rttiStruct = llvm::ConstantStruct::get(rttiInfoType, id, array);
-      rtti->setInitializer(rttiStruct);
-    }
   }
+  auto tableType = llvm::ArrayType::get(typeInfoType, count);
+  auto table = new llvm::GlobalVariable(*module, tableType, true,
+    llvm::GlobalValue::PrivateLinkage, llvm::ConstantArray::get(tableType, entries), "_xyl_types");
+  // Register the table before any of the program's code runs
+  llvm::BasicBlock& entry = entryPoint->getValue()->getEntryBlock();
+  llvm::IRBuilder<> entryBuilder(&entry, entry.begin());
+  entryBuilder.CreateCall(module->getFunction("_xyl_registerTypes"), {
+    llvm::ConstantExpr::getPointerCast(table, typeInfoType->getPointerTo()),
+    llvm::ConstantInt::get(integerType, count)
+  });
 }
 
-void ModuleCompiler::visitBlock(Node<BlockNode>::Link node) {
+void ModuleCompiler::visitBlock(BlockNode* node) {
   compileBlock(node, "block");
 }
 
-llvm::BasicBlock* ModuleCompiler::compileBlock(Node<BlockNode>::Link node, const std::string& name) {
+llvm::BasicBlock* ModuleCompiler::compileBlock(BlockNode* node, const std::string& name) {
   llvm::BasicBlock* oldBlock = builder->GetInsertBlock();
   llvm::BasicBlock* newBlock = llvm::BasicBlock::Create(*context, name, functionStack.top()->getValue());
   builder->SetInsertPoint(newBlock);
-  for (auto& child : node->getChildren()) child->visit(shared_from_this());
+  for (auto child : node->getChildSpan()) visit(child);
   // TODO: reduce indentation of this if
   // If the block lacks a terminator instruction, add one
-  if (!newBlock->getTerminator()) {
+  // After branches and loops, the code continues in another block than the one it started in
+  if (!builder->GetInsertBlock()->getTerminator()) {
     switch (node->getType()) {
       case ROOT_BLOCK:
         builder->CreateRet(llvm::ConstantInt::get(integerType, 0));
@@ -278,8 +324,8 @@ llvm::BasicBlock* ModuleCompiler::compileBlock(Node<BlockNode>::Link node, const
   return newBlock;
 }
 
-void ModuleCompiler::visitExpression(Node<ExpressionNode>::Link node) {
-  compileExpression(node);
+void ModuleCompiler::visitExpression(ExpressionNode* node) {
+  compileExpression(ASTNode::linkTo(node));
 }
 
 bool ModuleCompiler::canBeBoolean(ValueWrapper::Link val) const {
@@ -287,7 +333,7 @@ bool ModuleCompiler::canBeBoolean(ValueWrapper::Link val) const {
   return val->ty == booleanTid;
 }
 
-llvm::Type* ModuleCompiler::typeFromInfo(TypeInfo ti, ASTNode::Link node) {
+llvm::Type* ModuleCompiler::typeFromInfo(TypeInfo ti, const ASTNode* node) {
   if (ti.isVoid()) return llvm::Type::getVoidTy(*context);
   // TODO: do we even allow no type checking?
   if (ti.isDynamic()) throw InternalError("Not Implemented", {METADATA_PAIRS});
@@ -295,14 +341,27 @@ llvm::Type* ModuleCompiler::typeFromInfo(TypeInfo ti, ASTNode::Link node) {
   return ty->getAllocaType();
 }
 
-AbstractId::Link ModuleCompiler::typeIdFromInfo(TypeInfo ti, ASTNode::Link node) {
+AbstractId::Link ModuleCompiler::typeIdFromInfo(TypeInfo ti, const ASTNode* node) {
+  const TypeList& names = ti.getEvalTypeList();
+  if (names.size() == 1) return typeIdFromName(*names.begin(), node);
+  if (names.empty())
+    throw "Can't find type '{}'"_type(ti.getTypeNameString()) + node->getTrace();
+  // Lists are only found by their types, so the same types always get the same list
+  std::vector<AbstractId::Link> listTypes;
+  listTypes.reserve(names.size());
+  for (auto name : names) listTypes.push_back(typeIdFromName(name, node));
+  auto list = typeLists.get(listTypes, taggedUnionType);
+  types->insert(list);
+  return list;
+}
+
+TypeId::Link ModuleCompiler::typeIdFromName(Symbol name, const ASTNode* node) {
   AbstractId::Link result = nullptr;
   ASTNode::Link defBlock = node->findAbove([&](ASTNode::Link n) {
     auto b = Node<BlockNode>::dynPtrCast(n);
     if (!b) return false;
     auto it = std::find_if(ALL(b->blockTypes), [&](AbstractId::Link id) {
-      if (ti.getEvalTypeList().size() != id->storedTypeCount()) return false;
-      return ti.getEvalTypeList() == id->storedNames();
+      return id->storedTypeCount() == 1 && *id->storedNames().begin() == name;
     });
     if (it != b->blockTypes.end()) {
       result = *it;
@@ -311,207 +370,429 @@ AbstractId::Link ModuleCompiler::typeIdFromInfo(TypeInfo ti, ASTNode::Link node)
     return false;
   });
   if (result == nullptr)
-    throw "Can't find type '{}'"_type(ti.getTypeNameString()) + node->getTrace();
-  return result;
+    throw "Can't find type '{}'"_type(name) + node->getTrace();
+  return PtrUtil<TypeId>::staticPtrCast(result);
 }
 
 ValueWrapper::Link ModuleCompiler::valueFromIdentifier(Node<ExpressionNode>::Link identifier) {
-  auto name = identifier->getToken().data;
   if (identifier->getToken().type != TT::IDENTIFIER)
     throw InternalError("This function takes identifies only", {METADATA_PAIRS});
-  // Check if it's an argument to this function, return it
-  // TODO might have to load it
-  // LLVM arguments count
-  auto llvmFun = functionStack.top()->getValue();
-  auto llvmArgCount = static_cast<std::size_t>(
-    std::distance(llvmFun->arg_begin(), llvmFun->arg_end()));
-  // FunctionSignature arguments
-  auto sigArgList = functionStack.top()->getSignature().getArguments();
-  // Make sure the signature matches the arg list, otherwise something is really wrong
-  if (llvmArgCount != sigArgList.size()) throw InternalError(
-    "LLVM argument count does not match FunctionSignature argument count",
-    {
-      METADATA_PAIRS,
-      {"llvm arg count", std::to_string(llvmArgCount)},
-      {"signature arg count", std::to_string(sigArgList.size())}
+  const NameBinding* binding = identifier->getBinding();
+  if (binding == nullptr) throw InternalError("Identifier was not resolved", {
+    METADATA_PAIRS,
+    {"identifier", std::string(identifier->getToken().data)}
+  });
+  switch (binding->kind) {
+    case NameBinding::ARGUMENT: {
+      // TODO might have to load it
+      auto llvmFun = functionStack.top()->getValue();
+      auto llvmArgCount = static_cast<std::size_t>(
+        std::distance(llvmFun->arg_begin(), llvmFun->arg_end()));
+      // Make sure the argument exists, otherwise something is really wrong
+      if (binding->argument >= llvmArgCount) throw InternalError(
+        "Argument index is past the LLVM argument count",
+        {
+          METADATA_PAIRS,
+          {"llvm arg count", std::to_string(llvmArgCount)},
+          {"argument index", std::to_string(binding->argument)}
+        }
+      );
+      auto arg = std::next(llvmFun->arg_begin(), static_cast<std::ptrdiff_t>(binding->argument));
+      auto fun = static_cast<FunctionNode*>(binding->node);
+      // Constructors and non-static methods take 'this' first, which isn't in their signature
+      std::size_t thisCount = llvmArgCount - fun->getSignature().getArguments().size();
+      if (binding->argument < thisCount) {
+        auto type = static_cast<TypeNode*>(fun->getParent().get());
+        return std::make_shared<ValueWrapper>(
+          &(*arg),
+          typeIdFromInfo(StaticTypeInfo(type->getName()), identifier.get())
+        );
+      }
+      auto sigArg = fun->getSignature().getArguments()[binding->argument - thisCount];
+      return std::make_shared<ValueWrapper>(&(*arg), typeIdFromInfo(sigArg.second, identifier.get()));
     }
-  );
-  // Iterate over them at the same time
-  auto sigArg = sigArgList.begin();
-  for (auto arg = llvmFun->arg_begin(); arg != llvmFun->arg_end(); arg++, sigArg++) {
-    // Complain if arg names aren't the same
-    if (arg->getName() != sigArg->first) {
-      throw InternalError("Func arg name mismatch", {
+    case NameBinding::VARIABLE: {
+      if (binding->value == nullptr) throw InternalError("Variable used before it was compiled", {
         METADATA_PAIRS,
-        {"llvm arg name", arg->getName()},
-        {"func sig arg name", sigArg->first}
+        {"identifier", binding->name.str()}
       });
+      if (!binding->value->isInitialized())
+        throw "Use of uninitialized value '{}'"_ref(binding->name) + identifier->getToken().trace;
+      return binding->value;
     }
-    if (name == sigArg->first) return std::make_shared<ValueWrapper>(
-      &(*arg),
-      typeIdFromInfo(sigArg->second, identifier)
-    );
-  }
-  // Iterate over all the blocks above this identifier
-  for (auto p = identifier->findAbove<BlockNode>(); p != nullptr; p = p->findAbove<BlockNode>()) {
-    // If we find this ident in any of their variable scopes, return what we found
-    auto it = p->blockScope.find(name);
-    if (it != p->blockScope.end()) {
-      ValueWrapper::Link vr = it->second;
-      if (!vr->isInitialized())
-        throw "Use of uninitialized value '{}'"_ref(name) + identifier->getToken().trace;
-      return vr;
+    case NameBinding::FUNCTION: {
+      if (binding->value == nullptr) throw InternalError("Function used before it was compiled", {
+        METADATA_PAIRS,
+        {"identifier", binding->name.str()}
+      });
+      return binding->value;
     }
-    // If it's a function, return it
-    auto fIt = p->blockFuncs.find(name);
-    if (fIt != p->blockFuncs.end()) {
-      return fIt->second;
+    case NameBinding::MEMBER: {
+      // Get the member from the 'this' object of the constructor or method
+      auto type = static_cast<TypeNode*>(binding->node);
+      auto thisObj = getPtrForArgument(type->getTid(), functionStack.top(), 0);
+      InstanceWrapper::Link thisInstance = std::make_shared<InstanceWrapper>(
+        thisObj->val,
+        type->getTid()
+      );
+      return thisInstance->getMember(binding->name);
     }
   }
-  // Maybe the identifier is part of the enclosing type
-  // If we're in a constructor or method, attempt to obtain the 'this' object
-  ASTNode::Link parentFun = identifier->findAbove<ConstructorNode>();
-  if (parentFun == nullptr) parentFun = identifier->findAbove<MethodNode>();
-  if (parentFun != nullptr) {
-    Node<TypeNode>::Link type = Node<TypeNode>::staticPtrCast(parentFun->getParent().lock());
-    auto thisObj = getPtrForArgument(type->getTid(), functionStack.top(), 0);
-    InstanceWrapper::Link thisInstance = std::make_shared<InstanceWrapper>(
-      thisObj->val,
-      type->getTid()
+  throw InternalError("Unknown binding kind", {METADATA_PAIRS});
+}
+
+ValueWrapper::Link ModuleCompiler::compileTerminal(Node<ExpressionNode>::Link node) {
+  Token tok = node->getToken();
+  switch (tok.type) {
+    case TT::INTEGER: return std::make_shared<ValueWrapper>(
+      llvm::ConstantInt::getSigned(integerType, tok.intValue),
+      integerTid
     );
-    try {
-      return thisInstance->getMember(name);
-    } catch (const Error& err) {
-      // getMember throws Error instances only when it can't find the member
-      // So this means the identifier we're looking for isn't here
-      // Which means that this catch block can be safely ignored
-      UNUSED(err);
+    case TT::FLOAT: return std::make_shared<ValueWrapper>(
+      llvm::ConstantFP::get(floatType, tok.floatValue),
+      floatTid
+    );
+    case TT::STRING: throw InternalError("Not Implemented", {METADATA_PAIRS});
+    case TT::BOOLEAN: {
+      auto b = tok.data == "true" ?
+        llvm::ConstantInt::getTrue(booleanType) :
+        llvm::ConstantInt::getFalse(booleanType);
+      return std::make_shared<ValueWrapper>(b, booleanTid);
     }
-  }
-  throw "Cannot find '{}' in this scope"_syntax(name) + identifier->getTrace();
+    case TT::IDENTIFIER: return valueFromIdentifier(node);
+    default: throw InternalError("Unhandled terminal symbol in switch case", {
+      METADATA_PAIRS,
+      {"token", tok.toString()}
+    });
+  };
 }
 
 ValueWrapper::Link ModuleCompiler::compileExpression(Node<ExpressionNode>::Link node, IdentifierHandling how) {
-  Token tok = node->getToken();
-  if (how == AS_POINTER && tok.type != TT::IDENTIFIER && tok.type != TT::OPERATOR)
-    throw "Operator requires a mutable type"_syntax + tok.trace;
-  if (tok.isTerminal()) {
-    switch (tok.type) {
-      case TT::INTEGER: return std::make_shared<ValueWrapper>(
-        llvm::ConstantInt::getSigned(integerType, std::stoll(tok.data)),
-        integerTid
-      );
-      case TT::FLOAT: return std::make_shared<ValueWrapper>(
-        llvm::ConstantFP::get(floatType, tok.data),
-        floatTid
-      );
-      case TT::STRING: throw InternalError("Not Implemented", {METADATA_PAIRS});
-      case TT::BOOLEAN: {
-        auto b = tok.data == "true" ?
-          llvm::ConstantInt::getTrue(booleanType) :
-          llvm::ConstantInt::getFalse(booleanType);
-        return std::make_shared<ValueWrapper>(b, booleanTid);
+  // Operands are compiled before their operators, in order. The operators that wait for
+  // their operands are kept here, instead of on the call stack, because expressions can be
+  // nested very deeply
+  struct Pending {
+    Node<ExpressionNode>::Link node;
+    IdentifierHandling how;
+    /// True if the operands were already scheduled, and are now in values
+    bool hasOperands;
+  };
+  std::vector<Pending> pending {{node, how, false}};
+  std::vector<ValueWrapper::Link> values {};
+  while (!pending.empty()) {
+    Pending current = pending.back();
+    pending.pop_back();
+    Token tok = current.node->getToken();
+    if (current.hasOperands) {
+      bool isCall = tok.op().hasSymbol("()");
+      bool isMemberAccess = tok.op().hasName("Member access");
+      std::size_t operandCount = isCall ?
+        current.node->getChildSpan()[0]->getChildSpan().size() + 1 : current.node->getChildSpan().size();
+      // Only the object and the arguments of the method are operands, the names aren't
+      if (isMemberAccess) operandCount = methodArguments(current.node).size() + 1;
+      std::vector<ValueWrapper::Link> operands(values.end() - static_cast<std::ptrdiff_t>(operandCount), values.end());
+      values.resize(values.size() - operandCount);
+      // Make sure we have the correct amount of operands
+      if (!isCall && !isMemberAccess && static_cast<int>(operands.size()) != tok.op().getArity()) {
+        throw InternalError("Operand count does not match operator arity", {
+          METADATA_PAIRS,
+          {"operator token", tok.toString()},
+          {"operand count", std::to_string(operands.size())}
+        });
       }
-      case TT::IDENTIFIER: return valueFromIdentifier(node);
-      default: throw InternalError("Unhandled terminal symbol in switch case", {
+      // Call the code generating function, and keep its result
+      values.push_back(codegenMap[tok.op().getName()](operands, current.node));
+      continue;
+    }
+    if (current.how == AS_POINTER && tok.type != TT::IDENTIFIER && tok.type != TT::OPERATOR)
+      throw "Operator requires a mutable type"_syntax + tok.trace;
+    if (tok.isTerminal()) {
+      auto value = compileTerminal(current.node);
+      // A union that is known to hold a single type is read as that type
+      if (current.how == AS_VALUE) value = readNarrowed(value);
+      values.push_back(value);
+      continue;
+    }
+    if (!tok.isOp()) {
+      throw InternalError("Malformed expression node", {
         METADATA_PAIRS,
         {"token", tok.toString()}
       });
-    };
-  } else if (tok.isOp()) {
-    std::vector<ValueWrapper::Link> operands {};
+    }
+    pending.push_back({current.node, current.how, true});
+    // The operands are compiled in order, so they are scheduled in reverse
     // Do some magic for function calls
     if (tok.op().hasSymbol("()")) {
+      auto args = current.node->getChildSpan()[0]->getChildSpan();
+      // TODO might need to change these AS_VALUE for complex objects
+      for (std::size_t i = args.size(); i-- > 0;) {
+        pending.push_back({ASTNode::linkTo(static_cast<ExpressionNode*>(args[i])), AS_VALUE, false});
+      }
       // Second arg to calls is the thing being called
       // Should be a pointer
-      operands.push_back(compileExpression(node->at(1), AS_POINTER));
-      auto args = node->at(0);
-      // Add args
-      for (std::size_t i = 0; i < args->getChildren().size(); i++) {
-        // TODO might need to change these AS_VALUE for complex objects
-        operands.push_back(compileExpression(args->at(static_cast<int64_t>(i)), AS_VALUE));
+      pending.push_back({current.node->at(1), AS_POINTER, false});
+    } else if (tok.op().hasName("Member access")) {
+      auto args = methodArguments(current.node);
+      for (std::size_t i = args.size(); i-- > 0;) {
+        pending.push_back({ASTNode::linkTo(static_cast<ExpressionNode*>(args[i])), AS_VALUE, false});
       }
+      // The object is used in place, so its members can be assigned to
+      pending.push_back({current.node->at(0), AS_POINTER, false});
     } else {
-      // Recursively compute all the operands
-      std::size_t idx = 0;
-      for (auto& child : node->getChildren()) {
+      auto children = current.node->getChildSpan();
+      for (std::size_t idx = children.size(); idx-- > 0;) {
         bool requirePointer = tok.op().getRefList()[idx];
-        operands.push_back(compileExpression(Node<ExpressionNode>::staticPtrCast(child), requirePointer ? AS_POINTER : AS_VALUE));
-        idx++;
-      }
-      // Make sure we have the correct amount of operands
-      if (static_cast<int>(operands.size()) != tok.op().getArity()) {
-        throw InternalError("Operand count does not match operator arity", {
-          METADATA_PAIRS,
-          {"operator token", tok.toString()},
-          {"operand count", std::to_string(operands.size())}
+        pending.push_back({
+          ASTNode::linkTo(static_cast<ExpressionNode*>(children[idx])),
+          requirePointer ? AS_POINTER : AS_VALUE,
+          false
         });
       }
     }
-    // Call the code generating function, and return its result
-    return codegenMap[tok.op().getName()](operands, node);
-  } else {
-    throw InternalError("Malformed expression node", {
-      METADATA_PAIRS,
-      {"token", tok.toString()}
-    });
   }
+  return values.back();
 }
 
-// TODO: get rid of this, insertRuntimeTypeCheck should just do manual stuff for those
-ValueWrapper::Link ModuleCompiler::boxPrimitive(ValueWrapper::Link p) {
-  if (p->val->getType()->getPointerElementType() == taggedUnionType) return p;
-  auto box = builder->CreateAlloca(taggedUnionType, nullptr, "boxPrimitive");
-  // TODO: store value into the box
-  return std::make_shared<ValueWrapper>(box, p->ty);
+llvm::Constant* ModuleCompiler::typeTag(TypeId::Link type) {
+  taggedTypes.insert({type->getId(), type});
+  // Tags are only known once every type the module uses is, so use a stand-in until then
+  std::string globalName = fmt::format("_xyl_tag_{0}", type->getName());
+  auto placeholder = module->getGlobalVariable(globalName, true);
+  if (placeholder == nullptr) {
+    placeholder = new llvm::GlobalVariable(*module, llvm::Type::getInt8Ty(*context), true,
+      llvm::GlobalValue::ExternalLinkage, nullptr, globalName);
+  }
+  return llvm::ConstantExpr::getPtrToInt(placeholder, unionTagType);
+}
+
+llvm::Value* ModuleCompiler::loadTypeTag(ValueWrapper::Link value) {
+  if (value->ty->storedTypeCount() == 1) {
+    return typeTag(PtrUtil<TypeId>::staticPtrCast(value->ty));
+  }
+  if (value->val->getType() == taggedUnionPtrType) {
+    return builder->CreateLoad(builder->CreateStructGEP(taggedUnionType, value->val, 0), "tag");
+  }
+  if (value->val->getType() == taggedUnionType) {
+    return builder->CreateExtractValue(value->val, {0}, "tag");
+  }
+  throw InternalError("Illegal argument, expected tagged union as value", {
+    METADATA_PAIRS,
+    {"wrong type", getAddressStringFrom(value->val->getType())}
+  });
 }
 
 void ModuleCompiler::insertRuntimeTypeCheck(
-  ValueWrapper::Link target,
+  AbstractId::Link allowed,
   ValueWrapper::Link newValue
 ) {
+  llvm::Value* tag = loadTypeTag(newValue);
+  // The mask depends on the tags, so the test is put in by assignTypeTags
+  auto checkPlaceholder = module->getFunction("_xyl_allowsTag");
+  if (checkPlaceholder == nullptr) {
+    checkPlaceholder = llvm::Function::Create(
+      llvm::FunctionType::get(booleanType, {unionTagType}, false),
+      llvm::Function::ExternalLinkage, "_xyl_allowsTag", module);
+  }
+  auto isAllowed = builder->CreateCall(checkPlaceholder, {tag}, "isAllowed");
+  pendingTypeChecks.push_back({isAllowed, allowed});
+
+  llvm::Function* function = functionStack.top()->getValue();
+  auto failed = llvm::BasicBlock::Create(*context, "typeErr", function);
+  auto passed = llvm::BasicBlock::Create(*context, "typeOk", function);
+  builder->CreateCondBr(isAllowed, passed, failed);
+  builder->SetInsertPoint(failed);
   builder->CreateCall(
-    module->getFunction("_xyl_typeErrIfIncompatible"),
-    {target->val, boxPrimitive(newValue)->val}
+    module->getFunction("_xyl_typeErr"),
+    {typeNameString(allowed), tag}
   );
+  builder->CreateUnreachable();
+  builder->SetInsertPoint(passed);
 }
 
-void ModuleCompiler::insertRuntimeTypeCheck(
-  AbstractId::Link target,
-  ValueWrapper::Link newValue
+void ModuleCompiler::lowerTypeCheck(
+  llvm::CallInst* placeholder,
+  AbstractId::Link allowed,
+  const std::unordered_map<UniqueIdentifier, std::size_t>& tags
 ) {
-  builder->CreateCall(
-    module->getFunction("_xyl_typeErrIfIncompatibleTid"),
-    {llvm::ConstantInt::get(integerType, target->getId()), boxPrimitive(newValue)->val}
-  );
+  // Tags that never end up in a union can't be checked, so they're left out of the mask
+  TypeMask mask;
+  for (const auto& tagged : taggedTypes) {
+    if (allowed->getMask().test(tagged.second->getIndex())) mask.set(tags.at(tagged.first));
+  }
+  llvm::IRBuilder<> builder(placeholder);
+  llvm::Value* tag = placeholder->getArgOperand(0);
+  llvm::Value* wideTag = builder.CreateZExt(tag, integerType);
+  llvm::Value* wordIdx = builder.CreateLShr(wideTag, 6);
+  llvm::Value* bitIdx = builder.CreateAnd(wideTag, 63);
+  llvm::Value* inMask = builder.CreateICmpULT(
+    wordIdx, llvm::ConstantInt::get(integerType, mask.wordCount()));
+  llvm::Value* word;
+  if (mask.wordCount() == 1) {
+    word = llvm::ConstantInt::get(integerType, mask.getWord(0), false);
+  } else {
+    // Masks of more than one word are constant arrays, indexed by the word the tag is in
+    std::string maskName = fmt::format("_xyl_mask_{0}", allowed->getName());
+    auto maskGlobal = module->getGlobalVariable(maskName, true);
+    if (maskGlobal == nullptr) {
+      std::vector<llvm::Constant*> words;
+      for (std::size_t i = 0; i < mask.wordCount(); i++) {
+        words.push_back(llvm::ConstantInt::get(integerType, mask.getWord(i), false));
+      }
+      auto maskType = llvm::ArrayType::get(integerType, words.size());
+      maskGlobal = new llvm::GlobalVariable(*module, maskType, true,
+        llvm::GlobalValue::PrivateLinkage, llvm::ConstantArray::get(maskType, words), maskName);
+    }
+    // Don't read past the end of the mask, tags there are never allowed
+    llvm::Value* safeIdx = builder.CreateSelect(
+      inMask, wordIdx, llvm::ConstantInt::get(integerType, 0));
+    word = builder.CreateLoad(builder.CreateInBoundsGEP(maskGlobal->getValueType(), maskGlobal,
+      {llvm::ConstantInt::get(integerType, 0), safeIdx}), "maskWord");
+  }
+  llvm::Value* bit = builder.CreateAnd(builder.CreateLShr(word, bitIdx), 1);
+  llvm::Value* isAllowed = builder.CreateAnd(
+    inMask, builder.CreateICmpNE(bit, llvm::ConstantInt::get(integerType, 0)));
+  placeholder->replaceAllUsesWith(isAllowed);
+  // Checks of constant tags fold away, and constants have no name
+  if (!llvm::isa<llvm::Constant>(isAllowed)) isAllowed->takeName(placeholder);
+  placeholder->eraseFromParent();
 }
 
-llvm::Value* ModuleCompiler::insertDynAlloc(uint64_t size, ValueWrapper::Link target) {
+llvm::Value* ModuleCompiler::insertDynAlloc(uint64_t size, llvm::Type* type) {
   auto i8Ptr = builder->CreateCall(
     module->getFunction("malloc"),
     {llvm::ConstantInt::get(integerType, size)}
   );
-  auto properTypePtr = builder->CreateBitCast(
-    i8Ptr, target->ty->getAllocaType()->getPointerTo());
+  auto properTypePtr = builder->CreateBitCast(i8Ptr, type->getPointerTo());
   return properTypePtr;
 }
 
-llvm::Value* ModuleCompiler::storeTypeList(
-  llvm::Value* taggedUnion,
-  UniqueIdentifier typeList
+llvm::AllocaInst* ModuleCompiler::createEntryAlloca(llvm::Type* type, const std::string& name) {
+  llvm::Function* function = functionStack.top()->getValue();
+  if (function->empty()) return builder->CreateAlloca(type, nullptr, name);
+  llvm::BasicBlock& entry = function->getEntryBlock();
+  llvm::IRBuilder<> entryBuilder(&entry, entry.begin());
+  return entryBuilder.CreateAlloca(type, nullptr, name);
+}
+
+void ModuleCompiler::allocateColdStorage(
+  TypeData* tyData,
+  llvm::Value* object,
+  bool onStack,
+  const std::string& name
 ) {
-  if (taggedUnion->getType() != taggedUnionType->getPointerTo()) {
+  auto storageType = tyData->getColdStorageType();
+  if (storageType == nullptr) return;
+  llvm::Value* storage;
+  if (onStack) {
+    storage = createEntryAlloca(storageType, name);
+  } else {
+    llvm::DataLayout d(module);
+    storage = insertDynAlloc(d.getTypeAllocSize(storageType), storageType);
+  }
+  tyData->attachColdStorage(object, storage);
+}
+
+llvm::Value* ModuleCompiler::ownObject(TypeData* tyData, llvm::Value* data, const std::string& name) {
+  auto owned = createEntryAlloca(tyData->getStructTy(), name);
+  allocateColdStorage(tyData, owned, true, name + "_cold");
+  tyData->storeCopy(data, owned);
+  return owned;
+}
+
+llvm::GlobalVariable* ModuleCompiler::returnedColdStorage(TypeData* tyData) {
+  auto storageType = tyData->getColdStorageType();
+  auto name = storageType->getName().str() + "_returned";
+  if (auto existing = module->getGlobalVariable(name, true)) return existing;
+  return new llvm::GlobalVariable(
+    *module,
+    storageType,
+    false,
+    llvm::GlobalValue::InternalLinkage,
+    llvm::ConstantAggregateZero::get(storageType),
+    name
+  );
+}
+
+ValueWrapper::Link ModuleCompiler::callResult(llvm::Value* result, AbstractId::Link ty) {
+  TypeData* tyData = ty->storedTypeCount() == 1 ?
+    PtrUtil<TypeId>::staticPtrCast(ty)->getTyData() : nullptr;
+  if (tyData == nullptr || tyData->getColdStorageType() == nullptr) {
+    return std::make_shared<ValueWrapper>(result, ty);
+  }
+  // The cold members of the returned object only live until the next call, see visitReturn
+  auto owned = ownObject(tyData, result, "returned");
+  return std::make_shared<ValueWrapper>(builder->CreateLoad(owned, "returnedObject"), ty);
+}
+
+llvm::Value* ModuleCompiler::payloadSlot(llvm::Value* taggedUnion, TypeId::Link type) {
+  auto& slots = payloadSlots[taggedUnion];
+  auto it = slots.find(type->getIndex());
+  if (it != slots.end()) return it->second;
+  auto slot = createEntryAlloca(type->getAllocaType(), fmt::format("{}_payload", type->getName()));
+  slots.insert({type->getIndex(), slot});
+  return slot;
+}
+
+bool ModuleCompiler::fitsInUnion(llvm::Type* type) const {
+  llvm::DataLayout d(module);
+  return d.getTypeAllocSize(type) <= d.getTypeAllocSize(integerType);
+}
+
+llvm::Value* ModuleCompiler::unionDataPtr(llvm::Value* taggedUnion, llvm::Type* dataType) {
+  auto dataField = builder->CreateStructGEP(taggedUnionType, taggedUnion, 1);
+  if (fitsInUnion(dataType)) {
+    return builder->CreateBitCast(dataField, dataType->getPointerTo());
+  }
+  return builder->CreateLoad(
+    builder->CreateBitCast(dataField, dataType->getPointerTo()->getPointerTo()),
+    "unionDataPtr"
+  );
+}
+
+void ModuleCompiler::storeInUnion(llvm::Value* taggedUnion, ValueWrapper::Link value, bool onStack) {
+  if (taggedUnion->getType() != taggedUnionPtrType) {
     throw InternalError("Illegal argument, expected tagged union as value", {
       METADATA_PAIRS,
       {"wrong type", getAddressStringFrom(taggedUnion->getType())}
     });
   }
-  return builder->CreateStore(
-    llvm::ConstantInt::get(integerType, typeList, false),
-    builder->CreateBitCast(
-      builder->CreateConstGEP1_32(taggedUnion, 1),
-      integerType->getPointerTo()
-    )
+  // Another union is copied whole, tag and all
+  if (value->val->getType() == taggedUnionPtrType) {
+    builder->CreateStore(builder->CreateLoad(value->val, "unionCopy"), taggedUnion);
+    return;
+  }
+  auto dataType = value->ty->getAllocaType();
+  llvm::Value* data = value->val;
+  // Variables are pointers to their value
+  if (data->getType() == dataType->getPointerTo()) data = builder->CreateLoad(data, "unionData");
+  auto tid = PtrUtil<TypeId>::staticPtrCast(value->ty);
+  auto dataField = builder->CreateStructGEP(taggedUnionType, taggedUnion, 1);
+  llvm::Value* dataPtr;
+  if (fitsInUnion(dataType)) {
+    dataPtr = builder->CreateBitCast(dataField, dataType->getPointerTo());
+  } else {
+    if (onStack) {
+      // Each assignment overwrites the previous value of this type, which nothing else points to
+      dataPtr = payloadSlot(taggedUnion, tid);
+    } else {
+      llvm::DataLayout d(module);
+      dataPtr = insertDynAlloc(d.getTypeAllocSize(dataType), dataType);
+    }
+    builder->CreateStore(
+      dataPtr,
+      builder->CreateBitCast(dataField, dataPtr->getType()->getPointerTo())
+    );
+  }
+  if (auto tyData = tid->getTyData()) {
+    // The payload is a copy of the object, with cold members stored where the payload is
+    allocateColdStorage(tyData, dataPtr, onStack, tid->getName() + "_payload_cold");
+    tyData->storeCopy(data, dataPtr);
+  } else {
+    builder->CreateStore(data, dataPtr);
+  }
+  builder->CreateStore(
+    typeTag(tid),
+    builder->CreateStructGEP(taggedUnionType, taggedUnion, 0)
   );
 }
 
@@ -519,27 +800,46 @@ void ModuleCompiler::assignToUnion(
   ValueWrapper::Link unionWrapper,
   ValueWrapper::Link newValue
 ) {
-  llvm::DataLayout d(module);
-  auto size = d.getTypeAllocSize(newValue->ty->getAllocaType());
-  auto dataPtr = insertDynAlloc(size, newValue);
-  // Store data in memory
-  builder->CreateStore(newValue->val, dataPtr);
-  // Store ptr to data in union
-  builder->CreateStore(
-    dataPtr,
-    builder->CreateBitCast(
-      builder->CreateConstGEP1_32(unionWrapper->val, 0),
-      dataPtr->getType()->getPointerTo()
-    )
-  );
-  // Update union current type
-  builder->CreateStore(
-    llvm::ConstantInt::get(integerType, newValue->ty->getId(), false),
-    builder->CreateBitCast(
-      builder->CreateConstGEP1_32(unionWrapper->val, 2),
-      integerType->getPointerTo()
-    )
-  );
+  storeInUnion(unionWrapper->val, newValue, localUnions.count(unionWrapper->val) > 0);
+  // Until something else is assigned, the union holds what was assigned here
+  if (newValue->ty->storedTypeCount() == 1) {
+    auto known = PtrUtil<TypeId>::staticPtrCast(newValue->ty);
+    narrowed.set(unionWrapper, known, functionStack.top()->getValue());
+  } else {
+    narrowed.forget(unionWrapper.get());
+  }
+}
+
+ValueWrapper::Link ModuleCompiler::readNarrowed(ValueWrapper::Link value) {
+  if (value->ty->storedTypeCount() == 1) return value;
+  auto known = narrowed.get(value.get(), functionStack.top()->getValue());
+  if (known == nullptr) return value;
+  auto data = builder->CreateLoad(unionDataPtr(value->val, known->getAllocaType()), "narrowed");
+  return std::make_shared<NarrowedWrapper>(data, known, value->ty);
+}
+
+void ModuleCompiler::forgetAssignedIn(ASTNode* node) {
+  std::vector<ASTNode*> stack {node};
+  while (!stack.empty()) {
+    ASTNode* current = stack.back();
+    stack.pop_back();
+    // Missing optional children are null
+    if (current == nullptr) continue;
+    if (current->getKind() == NodeKind::EXPRESSION) {
+      auto expr = static_cast<ExpressionNode*>(current);
+      Token tok = expr->getToken();
+      if (tok.isOp() && tok.op().hasSymbol("()")) {
+        // The called function might assign to anything it can see
+        narrowed.forgetAll();
+        return;
+      }
+      if (tok.isOp() && tok.op().getRefList()[0]) {
+        const NameBinding* binding = expr->at(0)->getBinding();
+        if (binding != nullptr && binding->value != nullptr) narrowed.forget(binding->value.get());
+      }
+    }
+    for (auto child : current->getChildSpan()) stack.push_back(child);
+  }
 }
 
 void ModuleCompiler::typeCheck(AbstractId::Link allowedLhs, ValueWrapper::Link rhs, Error err) {
@@ -548,47 +848,57 @@ void ModuleCompiler::typeCheck(AbstractId::Link allowedLhs, ValueWrapper::Link r
   if (isCompat == INCOMPATIBLE) {
     throw err;
   } else if (isCompat == DYNAMIC) {
+    checkStats.dynamic++;
     insertRuntimeTypeCheck(allowedLhs, rhs);
   } else {
     // If they're compatible, great
+    // Without knowing what the union held, this would have been checked at runtime
+    auto narrowedRhs = PtrUtil<NarrowedWrapper>::dynPtrCast(rhs);
+    if (narrowedRhs != nullptr && allowedLhs->isCompat(narrowedRhs->getDeclaredType()) == DYNAMIC) {
+      checkStats.removed++;
+    }
     return;
   }
 }
 
-void ModuleCompiler::visitDeclaration(Node<DeclarationNode>::Link node) {
+void ModuleCompiler::visitDeclaration(DeclarationNode* node) {
   Node<BlockNode>::Link enclosingBlock = node->findAbove<BlockNode>();
+  auto id = typeIdFromInfo(node->getTypeInfo(), node);
   llvm::Value* decl;
   // If this variable allows only one type, allocate it immediately
-  if (node->getTypeInfo().getEvalTypeList().size() == 1) {
-    llvm::Type* ty = typeFromInfo(node->getTypeInfo(), node);
-    decl = builder->CreateAlloca(ty, nullptr, node->getIdentifier());
+  if (id->storedTypeCount() == 1) {
+    decl = createEntryAlloca(id->getAllocaType(), node->getIdentifier());
   } else {
-    std::unordered_set<AbstractId::Link> declTypes;
-    std::for_each(ALL(node->getTypeInfo().getEvalTypeList()), [&](TypeName name) {
-      declTypes.insert(typeIdFromInfo(StaticTypeInfo(name), node));
-    });
-    auto list = TypeListId::create(
-      collate(node->getTypeInfo().getEvalTypeList()),
-      declTypes,
-      taggedUnionType
-    );
-    declTypes.insert(list);
-    enclosingBlock->blockTypes.insert(list);
-    decl = builder->CreateAlloca(taggedUnionType, nullptr, node->getIdentifier());
-    storeTypeList(decl, list->getId());
+    decl = createEntryAlloca(taggedUnionType, node->getIdentifier());
+  }
+  // Variables store their object, so it can't be of a subtype
+  auto declWrap = std::make_shared<ValueWrapper>(decl, id, true);
+  const NameBinding* binding = node->getBinding();
+  if (id->storedTypeCount() > 1 && binding != nullptr && !binding->escapes) {
+    localUnions.insert(decl);
   }
-  auto id = typeIdFromInfo(node->getTypeInfo(), node);
-  auto declWrap = std::make_shared<ValueWrapper>(decl, id);
 
   // Add to scope
   auto inserted =
-    enclosingBlock->blockScope.insert({node->getIdentifier(), declWrap});
+    enclosingBlock->blockScope.insert({node->getSymbol(), declWrap});
   // If it failed, it means the decl already exists
   if (!inserted.second)
     throw "Redefinition of identifier '{}'"_ref(node->getIdentifier()) + node->getTrace();
+  if (node->getBinding() != nullptr) node->getBinding()->value = declWrap;
+
+  TypeData* tyData = id->storedTypeCount() == 1 ?
+    PtrUtil<TypeId>::staticPtrCast(id)->getTyData() : nullptr;
+  // The cold members of an object are on the stack like the object, and reused like it in loops
+  if (tyData != nullptr) allocateColdStorage(tyData, decl, true, node->getIdentifier() + "_cold");
 
   // Handle initialization
-  if (!node->hasInit()) return;
+  if (!node->hasInit()) {
+    // Objects start with their members' initial values, and the vtable of their type
+    if (tyData != nullptr && tyData->getInit().exists()) {
+      builder->CreateCall(tyData->getInit().getInit()->getValue(), {decl});
+    }
+    return;
+  }
   ValueWrapper::Link initValue = compileExpression(node->init());
 
   typeCheck(id, initValue,
@@ -597,31 +907,112 @@ void ModuleCompiler::visitDeclaration(Node<DeclarationNode>::Link node) {
 
   if (decl->getType() == llvm::PointerType::getUnqual(taggedUnionType)) {
     assignToUnion(declWrap, initValue);
+  } else if (tyData != nullptr) {
+    tyData->storeCopy(load(initValue)->val, decl);
   } else {
     builder->CreateStore(initValue->val, decl);
   }
 }
 
-void ModuleCompiler::visitBranch(Node<BranchNode>::Link node) {
+void ModuleCompiler::visitBranch(BranchNode* node) {
   compileBranch(node);
 }
 
-// The BasicBlock surrounding is the block where control returns after dealing with branches, only specified for recursive case
-void ModuleCompiler::compileBranch(Node<BranchNode>::Link node, llvm::BasicBlock* surrounding) {
-  const auto handleBranchExit = [&](llvm::BasicBlock* continueCurrent, llvm::BasicBlock* success, bool usesBranchAfter) -> void {
+void ModuleCompiler::compileBranch(BranchNode* node) {
+  // Each branch of an else-if chain is compiled in order, but the jumps between them are
+  // added afterwards, in reverse, like they would be if the chain was compiled recursively.
+  // The chain can be very long, so it is compiled in a loop
+  struct CompiledBranch {
+    llvm::BasicBlock* current;
+    ValueWrapper::Link cond;
+    llvm::BasicBlock* success;
+    /// Where the success block's code ends, which is another block if it has branches or loops
+    llvm::BasicBlock* successEnd;
+    /// Where to go if cond is false
+    llvm::BasicBlock* failiure;
+    bool usesBranchAfter;
+  };
+  // The blocks of the branches don't end the code like other blocks do, they jump to the
+  // code after the branch, which is added later
+  auto compileArm = [this](BlockNode* block, const std::string& name) {
+    llvm::BasicBlock* arm = llvm::BasicBlock::Create(*context, name, functionStack.top()->getValue());
+    builder->SetInsertPoint(arm);
+    for (auto child : block->getChildSpan()) visit(child);
+    return arm;
+  };
+  std::vector<CompiledBranch> chain;
+  // continueCurrent gets all the current block's instructions after the branch
+  // Unless the branch jumps or returns somewhere, continueCurrent is always executed
+  // All the branches in the chain continue there
+  llvm::BasicBlock* continueCurrent = nullptr;
+  // What is known about the unions at the end of each path through the chain
+  std::vector<NarrowedTypes> outcomes;
+  while (true) {
+    bool usesBranchAfter = false;
+    ValueWrapper::Link cond = compileExpression(node->condition());
+    // The condition's code might not end in the block it started in, if it has type checks
+    llvm::BasicBlock* current = builder->GetInsertBlock();
+    if (!canBeBoolean(cond)) {
+      throw "Expected boolean expression in if condition"_type + node->condition()->getTrace();
+    }
+    NarrowedTypes afterCond = narrowed;
+    llvm::BasicBlock* success = compileArm(node->success().get(), "branchSuccess");
+    llvm::BasicBlock* successEnd = builder->GetInsertBlock();
+    outcomes.push_back(narrowed);
+    // The next branch only runs if this condition was false
+    narrowed = afterCond;
+    if (continueCurrent == nullptr) {
+      continueCurrent = llvm::BasicBlock::Create(*context, "branchAfter", functionStack.top()->getValue());
+    }
+    if (mpark::holds_alternative<std::nullptr_t>(node->failiure())) {
+      // Failiure is nullptr, does not have else clauses
+      chain.push_back({current, cond, success, successEnd, continueCurrent, usesBranchAfter});
+      outcomes.push_back(narrowed);
+      break;
+    } else if (mpark::holds_alternative<Node<BlockNode>::Link>(node->failiure())) {
+      // Failiure is BlockNode, has an else block
+      llvm::BasicBlock* failiure = compileArm(
+        mpark::get<Node<BlockNode>::Link>(node->failiure()).get(),
+        "branchFailiure"
+      );
+      outcomes.push_back(narrowed);
+      // Jump back to continueCurrent after the branch is done, to execute the rest of the block, unless there already is a terminator
+      if (!builder->GetInsertBlock()->getTerminator()) {
+        builder->CreateBr(continueCurrent);
+        usesBranchAfter = true;
+      }
+      chain.push_back({current, cond, success, successEnd, failiure, usesBranchAfter});
+      break;
+    } else if (mpark::holds_alternative<Node<BranchNode>::Link>(node->failiure())) {
+      // Failiure is BranchNode, has else-if
+      llvm::BasicBlock* nextBranch = llvm::BasicBlock::Create(*context, "branchNext", functionStack.top()->getValue());
+      builder->SetInsertPoint(nextBranch);
+      chain.push_back({current, cond, success, successEnd, nextBranch, usesBranchAfter});
+      node = mpark::get<Node<BranchNode>::Link>(node->failiure()).get();
+    } else {
+      throw InternalError("Unhandled type for variant", {METADATA_PAIRS});
+    }
+  }
+  // After the chain, only what is known on every path still holds
+  narrowed = outcomes.front();
+  for (const auto& outcome : outcomes) narrowed.join(outcome);
+  for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+    // Add the branch
+    builder->SetInsertPoint(it->current);
+    builder->CreateCondBr(it->cond->val, it->success, it->failiure);
     // Unless the block already goes somewhere else
     // Jump back to continueCurrent after the branch is done, to execute the rest of the block
-    if (!success->getTerminator()) {
-      builder->SetInsertPoint(success);
+    if (!it->successEnd->getTerminator()) {
+      builder->SetInsertPoint(it->successEnd);
       builder->CreateBr(continueCurrent);
-      usesBranchAfter = true;
+      it->usesBranchAfter = true;
     }
     // If the branchAfter block is not jumped to by anyone, get rid of it
     // Otherwise, the rest of the block's instructions should be added to it
-    // Only for non-recursive case, the recursive calls should not touch continueCurrent
+    // Only for the first branch in the chain, the others should not touch continueCurrent
     if (
-      surrounding == nullptr &&
-      !usesBranchAfter &&
+      it + 1 == chain.rend() &&
+      !it->usesBranchAfter &&
       llvm::pred_begin(continueCurrent) == llvm::pred_end(continueCurrent) &&
       continueCurrent->getParent() != nullptr
     ) {
@@ -629,57 +1020,18 @@ void ModuleCompiler::compileBranch(Node<BranchNode>::Link node, llvm::BasicBlock
     } else {
       builder->SetInsertPoint(continueCurrent);
     }
-    return;
-  };
-  bool usesBranchAfter = false;
-  llvm::BasicBlock* current = builder->GetInsertBlock();
-  ValueWrapper::Link cond = compileExpression(node->condition());
-  if (!canBeBoolean(cond)) {
-    throw "Expected boolean expression in if condition"_type + node->condition()->getTrace();
-  }
-  llvm::BasicBlock* success = compileBlock(node->success(), "branchSuccess");
-  // continueCurrent gets all the current block's instructions after the branch
-  // Unless the branch jumps or returns somewhere, continueCurrent is always executed
-  llvm::BasicBlock* continueCurrent = surrounding != nullptr ?
-    surrounding : llvm::BasicBlock::Create(*context, "branchAfter", functionStack.top()->getValue());
-  if (mpark::holds_alternative<std::nullptr_t>(node->failiure())) {
-    // Failiure is nullptr, does not have else clauses
-    builder->SetInsertPoint(current);
-    builder->CreateCondBr(cond->val, success, continueCurrent);
-    return handleBranchExit(continueCurrent, success, usesBranchAfter);
-  } else if (mpark::holds_alternative<Node<BlockNode>::Link>(node->failiure())) {
-    // Failiure is BlockNode, has an else block
-    llvm::BasicBlock* failiure = compileBlock(
-      mpark::get<Node<BlockNode>::Link>(node->failiure()),
-      "branchFailiure"
-    );
-    // Jump back to continueCurrent after the branch is done, to execute the rest of the block, unless there already is a terminator
-    if (!failiure->getTerminator()) {
-      builder->SetInsertPoint(failiure);
-      builder->CreateBr(continueCurrent);
-      usesBranchAfter = true;
-    }
-    // Add the branch
-    builder->SetInsertPoint(current);
-    builder->CreateCondBr(cond->val, success, failiure);
-    return handleBranchExit(continueCurrent, success, usesBranchAfter);
-  } else if (mpark::holds_alternative<Node<BranchNode>::Link>(node->failiure())) {
-    // Failiure is BranchNode, has else-if
-    llvm::BasicBlock* nextBranch = llvm::BasicBlock::Create(*context, "branchNext", functionStack.top()->getValue());
-    builder->SetInsertPoint(nextBranch);
-    compileBranch(mpark::get<Node<BranchNode>::Link>(node->failiure()), continueCurrent);
-    builder->SetInsertPoint(current);
-    builder->CreateCondBr(cond->val, success, nextBranch);
-    return handleBranchExit(continueCurrent, success, usesBranchAfter);
-  } else {
-    throw InternalError("Unhandled type for variant", {METADATA_PAIRS});
   }
 }
 
-void ModuleCompiler::visitLoop(Node<LoopNode>::Link node) {
+void ModuleCompiler::visitLoop(LoopNode* node) {
   for (auto init : node->inits()) {
     visitDeclaration(init);
   }
+  // The condition and the code run after any iteration, so what they assign isn't known
+  forgetAssignedIn(node->condition().get());
+  forgetAssignedIn(node->code().get());
+  for (auto update : node->updates()) forgetAssignedIn(update);
+  NarrowedTypes beforeLoop = narrowed;
   // Make the block where we go after we're done with the loopBlock
   auto loopAfter = llvm::BasicBlock::Create(*context, "loopAfter", functionStack.top()->getValue());
   // Make sure break statements know where to go
@@ -704,20 +1056,22 @@ void ModuleCompiler::visitLoop(Node<LoopNode>::Link node) {
   }
   // Add the code to the loopBlock
   builder->SetInsertPoint(loopBlock);
-  for (auto& child : node->code()->getChildren()) {
-    child->visit(shared_from_this());
+  for (auto child : node->code()->getChildSpan()) {
+    visit(child);
   }
   // Also add the update exprs at the end of the loopBlock
   for (auto update : node->updates()) {
-    compileExpression(update);
+    compileExpression(ASTNode::linkTo(update));
   }
   // Jump back to the condition to see what we do next
   builder->CreateBr(loopCondition);
   // Keep inserting instructions after the loop
   builder->SetInsertPoint(loopAfter);
+  // Whatever the loop assigned was already forgotten
+  narrowed = beforeLoop;
 }
 
-void ModuleCompiler::visitBreakLoop(Node<BreakLoopNode>::Link node) {
+void ModuleCompiler::visitBreakLoop(BreakLoopNode* node) {
   auto parentLoopNode = node->findAbove([](ASTNode::Link n) {
     if (Node<LoopNode>::dynPtrCast(n) != nullptr) return true;
     return false;
@@ -728,7 +1082,7 @@ void ModuleCompiler::visitBreakLoop(Node<BreakLoopNode>::Link node) {
   builder->CreateBr(exitBlock);
 }
 
-void ModuleCompiler::visitReturn(Node<ReturnNode>::Link node) {
+void ModuleCompiler::visitReturn(ReturnNode* node) {
   static const auto funRetTyMismatch = "Function return type does not match return value";
 
   auto func = node->findAbove<FunctionNode>();
@@ -762,21 +1116,29 @@ void ModuleCompiler::visitReturn(Node<ReturnNode>::Link node) {
       retId->typeNames(), returnedValue->ty->typeNames()) + node->getTrace());
 
   if (functionStack.top()->getValue()->getReturnType() != returnedValue->val->getType()) {
-    bool isUnion = returnedValue->val->getType() == taggedUnionType->getPointerTo();
-    if (isUnion) {
-      returnedValue->val = builder->CreateBitCast(
-        builder->CreateConstGEP1_32(returnedValue->val, 0),
-        functionStack.top()->getValue()->getReturnType()->getPointerTo()
-      );
+    auto returnType = functionStack.top()->getValue()->getReturnType();
+    bool isUnion = returnedValue->val->getType() == taggedUnionPtrType;
+    if (isUnion && returnType != taggedUnionType) {
+      returnedValue->val = unionDataPtr(returnedValue->val, returnType);
     }
     if (returnedValue->hasPointerValue()) {
       returnedValue->val = builder->CreateLoad(returnedValue->val, "loadPtrForReturn");
     }
   }
+  // The cold members can't stay in this function's frame, so they are moved to where the caller
+  // copies them from, right after the call
+  TypeData* retTyData = retId->storedTypeCount() == 1 ?
+    PtrUtil<TypeId>::staticPtrCast(retId)->getTyData() : nullptr;
+  if (retTyData != nullptr && retTyData->getColdStorageType() != nullptr) {
+    auto returned = createEntryAlloca(retTyData->getStructTy(), "returned");
+    retTyData->attachColdStorage(returned, returnedColdStorage(retTyData));
+    retTyData->storeCopy(returnedValue->val, returned);
+    returnedValue->val = builder->CreateLoad(returned, "returnedObject");
+  }
   builder->CreateRet(returnedValue->val);
 }
 
-void ModuleCompiler::visitFunction(Node<FunctionNode>::Link node) {
+void ModuleCompiler::visitFunction(FunctionNode* node) {
   // TODO anon functions
   const FunctionSignature& sig = node->getSignature();
   std::vector<llvm::Type*> argTypes {};
@@ -802,17 +1164,18 @@ void ModuleCompiler::visitFunction(Node<FunctionNode>::Link node) {
   }
   // Add the function to the enclosing block's scope
   Node<BlockNode>::Link enclosingBlock = node->findAbove<BlockNode>();
-  auto inserted = enclosingBlock->blockFuncs.insert({node->getIdentifier(), functionStack.top()});
+  auto inserted = enclosingBlock->blockFuncs.insert({node->getSymbol(), functionStack.top()});
   // If it failed, it means the function already exists
   if (!inserted.second) {
     throw "Redefinition of function '{}'"_syntax(node->getIdentifier()) + node->getTrace();
   }
+  if (node->getBinding() != nullptr) node->getBinding()->value = functionStack.top();
   // Only non-foreign functions have a block after them
-  if (!node->isForeign()) compileBlock(node->code(), fmt::format("fun_{}_entryBlock", node->getIdentifier()));
+  if (!node->isForeign()) compileBlock(node->code().get(), fmt::format("fun_{}_entryBlock", node->getIdentifier()));
   functionStack.pop();
 }
 
-void ModuleCompiler::visitType(Node<TypeNode>::Link node) {
+void ModuleCompiler::visitType(TypeNode* node) {
   auto structTy = module->getTypeByName(node->getName());
   // If it's already defined, get the block where it is stored
   ASTNode::Link defBlock = node->findAbove([=](ASTNode::Link n) {
@@ -831,10 +1194,19 @@ void ModuleCompiler::visitType(Node<TypeNode>::Link node) {
   // TODO: warning, these stupid StructTypes aren't uniqued, but their names are at
   // the context level. So make sure we don't do collisions with names
   structTy = llvm::StructType::create(*context, node->getName());
-  auto tid = TypeId::create(new TypeData(structTy, shared_from_this(), node));
+  auto tid = TypeId::create(new TypeData(structTy, shared_from_this(), ASTNode::linkTo(node)));
   node->setTid(tid);
-  for (auto& child : node->getChildren()) child->visit(shared_from_this());
-  structTy->setBody(tid->getTyData()->getAllocaTypes());
+  auto ancestors = node->getAncestors();
+  if (ancestors.size() > 1)
+    throw "Type '{}' can only inherit from one type"_type(node->getName()) + node->getTrace();
+  if (ancestors.size() == 1) {
+    auto parentId = typeIdFromName(*ancestors.begin(), node);
+    if (parentId->getTyData() == nullptr)
+      throw "Type '{0}' can't inherit from '{1}'"_type(node->getName(), parentId->getName()) + node->getTrace();
+    tid->getTyData()->setParent(parentId->getTyData());
+  }
+  for (auto child : node->getChildSpan()) visit(child);
+  tid->getTyData()->layOut();
   tid->getTyData()->finalize();
   // We already checked for redefinitions above, so we know it's safe to insert
   Node<BlockNode>::Link enclosingBlock = node->findAbove<BlockNode>();
@@ -888,9 +1260,9 @@ ValueWrapper::Link ModuleCompiler::getPtrForArgument(
   return std::make_shared<ValueWrapper>(value, argType);
 }
 
-void ModuleCompiler::visitConstructor(Node<ConstructorNode>::Link node) {
+void ModuleCompiler::visitConstructor(ConstructorNode* node) {
   TypeData* tyData =
-    Node<TypeNode>::staticPtrCast(node->getParent().lock())->getTid()->getTyData();
+    Node<TypeNode>::staticPtrCast(node->getParent())->getTid()->getTyData();
   auto sig = node->getSignature();
   if (!sig.getReturnType().isVoid()) throw InternalError(
     "Constructor return type not void",
@@ -927,17 +1299,17 @@ void ModuleCompiler::visitConstructor(Node<ConstructorNode>::Link node) {
     arg.setName(argNames[nameIdx]);
     nameIdx++;
   }
-  tyData->addConstructor(ConstructorData(node, funWrapper));
+  tyData->addConstructor(ConstructorData(ASTNode::linkTo(node), funWrapper));
 }
 
-void ModuleCompiler::visitMethod(Node<MethodNode>::Link node) {
-  TypeData* tyData = Node<TypeNode>::staticPtrCast(node->getParent().lock())->getTid()->getTyData();
+void ModuleCompiler::visitMethod(MethodNode* node) {
+  TypeData* tyData = Node<TypeNode>::staticPtrCast(node->getParent())->getTid()->getTyData();
   auto sig = node->getSignature();
   std::vector<llvm::Type*> argTypes {};
   std::vector<std::string> argNames {};
   // Non-static methods' first arg is a ptr to their object
   if (!node->isStatic()) {
-    argTypes.push_back(tyData->getStructTy());
+    argTypes.push_back(llvm::PointerType::getUnqual(tyData->getStructTy()));
     argNames.push_back("this");
   }
   for (std::pair<std::string, DefiniteTypeInfo> p : sig.getArguments()) {
@@ -969,18 +1341,18 @@ void ModuleCompiler::visitMethod(Node<MethodNode>::Link node) {
   // Normal methods are done in TypeData::finalize
   if (node->isStatic() && !node->isForeign()) {
     functionStack.push(funWrapper);
-    compileBlock(node->code(), fmt::format("fun_{}_entryBlock", node->getIdentifier()));
+    compileBlock(node->code().get(), fmt::format("fun_{}_entryBlock", node->getIdentifier()));
     functionStack.pop();
   }
-  tyData->addMethod(MethodData(node, node->getIdentifier(), funWrapper), node->isStatic());
+  tyData->addMethod(MethodData(ASTNode::linkTo(node), node->getIdentifier(), funWrapper), node->isStatic());
 }
 
-void ModuleCompiler::visitMember(Node<MemberNode>::Link node) {
-  auto tyNode = Node<TypeNode>::staticPtrCast(node->getParent().lock());
+void ModuleCompiler::visitMember(MemberNode* node) {
+  auto tyNode = Node<TypeNode>::staticPtrCast(node->getParent());
   const auto& tyData = tyNode->getTid()->getTyData();
   // This method also makes sure the members are initialized when appropriate
   tyData->addMember(
-    MemberMetadata(node, typeFromInfo(node->getTypeInfo(), node)),
+    MemberMetadata(ASTNode::linkTo(node), typeFromInfo(node->getTypeInfo(), node)),
     node->isStatic()
   );
 }
@@ -1014,6 +1386,7 @@ void ModuleCompiler::fillCodegenMap() {
     {"Bitshift >>", CodegenFun(objBind(&ModuleCompiler::shiftLeft, this))},
     {"Bitshift <<", CodegenFun(objBind(&ModuleCompiler::shiftRight, this))},
     {"Call", CodegenFun(objBind(&ModuleCompiler::call, this))},
+    {"Member access", CodegenFun(objBind(&ModuleCompiler::memberAccess, this))},
     {"Assignment", CodegenFun(objBind(&ModuleCompiler::assignment, this))}
   };
 }
@@ -1180,20 +1553,43 @@ ValueWrapper::Link ModuleCompiler::call(
       + node->getTrace();
   }
   auto fw = PtrUtil<FunctionWrapper>::staticPtrCast(ops[0]);
+  // We skip the first operand because it is the function itself, not an arg
+  auto args = callArguments(
+    fw->getSignature(),
+    std::vector<ValueWrapper::Link>(ops.begin() + 1, ops.end()),
+    std::string(node->at(1)->getToken().data),
+    node
+  );
+  // TODO: use invoke instead of call in the future, it has exception handling and stuff
+  auto callInstr = builder->CreateCall(
+    fw->getValue(),
+    args,
+    fw->getValue()->getReturnType()->isVoidTy() ? "" : "call"
+  );
+  // The called function might assign to any union it can see
+  narrowed.forgetAll();
+  return callResult(callInstr, returnTypeOf(fw->getSignature(), node.get()));
+}
+
+std::vector<llvm::Value*> ModuleCompiler::callArguments(
+  const FunctionSignature& sig,
+  const std::vector<ValueWrapper::Link>& ops,
+  const std::string& name,
+  Node<ExpressionNode>::Link node
+) {
   // Get a list of arguments to pass to CreateCall
   std::vector<llvm::Value*> args {};
-  // We skip the first operand because it is the function itself, not an arg
-  auto opIt = ops.begin() + 1;
-  auto arguments = fw->getSignature().getArguments();
-  if (ops.size() - 1 != arguments.size()) {
+  auto opIt = ops.begin();
+  auto arguments = sig.getArguments();
+  if (ops.size() != arguments.size()) {
     throw "Expected {0} arguments for function '{1}' ({2} provided)"_ref(
       arguments.size(),
-      node->at(1)->getToken().data,
-      ops.size() - 1
+      name,
+      ops.size()
     );
   }
   for (auto it = arguments.begin(); it != arguments.end(); ++it, ++opIt) {
-    auto argId = typeIdFromInfo(it->second, node);
+    auto argId = typeIdFromInfo(it->second, node.get());
     typeCheck(argId, *opIt,
       "Function argument '{0}' ({1}) has incompatible type with '{2}'"_type(
         it->first,
@@ -1202,18 +1598,83 @@ ValueWrapper::Link ModuleCompiler::call(
       ) + node->getTrace());
     args.push_back((*opIt)->val);
   }
-  AbstractId::Link ret;
-  if (fw->getSignature().getReturnType().isVoid()) ret = voidTid;
-  else ret = typeIdFromInfo(fw->getSignature().getReturnType(), node);
-  // TODO: use invoke instead of call in the future, it has exception handling and stuff
-  return std::make_shared<ValueWrapper>(
-    builder->CreateCall(
-      fw->getValue(),
-      args,
-      fw->getValue()->getReturnType()->isVoidTy() ? "" : "call"
-    ),
-    ret
+  return args;
+}
+
+AbstractId::Link ModuleCompiler::returnTypeOf(const FunctionSignature& sig, const ASTNode* node) {
+  if (sig.getReturnType().isVoid()) return voidTid;
+  return typeIdFromInfo(sig.getReturnType(), node);
+}
+
+NodeSpan<ASTNode> ModuleCompiler::methodArguments(Node<ExpressionNode>::Link access) {
+  auto name = access->at(1);
+  if (name->getToken().type == TT::IDENTIFIER) return NodeSpan<ASTNode>(nullptr, nullptr);
+  Token tok = name->getToken();
+  if (!tok.isOp() || !tok.op().hasSymbol("()") || name->at(1)->getToken().type != TT::IDENTIFIER)
+    throw "Expected member or method name after '.'"_syntax + name->getTrace();
+  return name->at(0)->getChildSpan();
+}
+
+ValueWrapper::Link ModuleCompiler::memberAccess(
+  std::vector<ValueWrapper::Link> ops,
+  Node<ExpressionNode>::Link node
+) {
+  auto tid = PtrUtil<TypeId>::dynPtrCast(ops[0]->ty);
+  if (tid == nullptr || tid->getTyData() == nullptr)
+    throw "Type '{}' has no members"_type(ops[0]->ty->typeNames()) + node->getTrace();
+  llvm::Value* object = ops[0]->val;
+  // Objects returned by calls are values, so they are put somewhere before their members are used
+  if (!object->getType()->isPointerTy()) object = ownObject(tid->getTyData(), object, "object");
+  auto name = node->at(1);
+  if (name->getToken().type == TT::IDENTIFIER) {
+    return InstanceWrapper(object, tid).getMember(std::string(name->getToken().data));
+  }
+  return callMethod(
+    tid->getTyData(),
+    object,
+    ops[0]->exactType,
+    std::vector<ValueWrapper::Link>(ops.begin() + 1, ops.end()),
+    name
+  );
+}
+
+ValueWrapper::Link ModuleCompiler::callMethod(
+  TypeData* tyData,
+  llvm::Value* object,
+  bool exact,
+  std::vector<ValueWrapper::Link> args,
+  Node<ExpressionNode>::Link call
+) {
+  std::string name(call->at(1)->getToken().data);
+  int slot = tyData->findSlot(name);
+  if (slot == -1)
+    throw "Cannot find method '{0}' in type '{1}'"_ref(name, tyData->getName()) + call->getTrace();
+  auto impl = tyData->getSlot(slot).impl->getFunction();
+  auto argValues = callArguments(impl->getSignature(), args, name, call);
+  llvm::Value* callee = exact ? impl->getValue() : tyData->loadFromVtable(object, slot);
+  llvm::FunctionType* calleeType = exact ? impl->getValue()->getFunctionType() : tyData->getSlot(slot).type;
+  argValues.insert(argValues.begin(), builder->CreateBitCast(object, calleeType->getParamType(0)));
+  auto callInstr = builder->CreateCall(
+    callee,
+    argValues,
+    calleeType->getReturnType()->isVoidTy() ? "" : "call"
   );
+  if (!exact) virtualCalls.push_back({callInstr, tyData, static_cast<uint>(slot)});
+  // The method might assign to any union it can see
+  narrowed.forgetAll();
+  return callResult(callInstr, returnTypeOf(impl->getSignature(), call.get()));
+}
+
+void ModuleCompiler::devirtualize() {
+  // All the types are known now, so the slots no subtype overrides always call the same method
+  for (const auto& virtualCall : virtualCalls) {
+    if (virtualCall.type->isOverridden(virtualCall.slot)) continue;
+    auto loaded = virtualCall.call->getCalledValue();
+    auto impl = virtualCall.type->getSlot(virtualCall.slot).impl->getFunction()->getValue();
+    virtualCall.call->setCalledFunction(llvm::ConstantExpr::getBitCast(impl, loaded->getType()));
+    llvm::RecursivelyDeleteTriviallyDeadInstructions(loaded);
+  }
+  virtualCalls.clear();
 }
 
 ValueWrapper::Link ModuleCompiler::assignment(
@@ -1239,6 +1700,9 @@ ValueWrapper::Link ModuleCompiler::assignment(
     // auto oldDataPtrLocation =
     //   mc->builder->CreateConstGEP1_32(operands[0]->getValue(), 0);
     assignToUnion(decl, ops[1]);
+  } else if (auto tyData = PtrUtil<TypeId>::staticPtrCast(decl->ty)->getTyData()) {
+    // The object keeps its cold members, and gets the values of the assigned object's
+    tyData->storeCopy(load(ops[1])->val, decl->val);
   } else {
     // Store into the variable
     builder->CreateStore(ops[1]->val, ops[0]->val);
@@ -0,0 +1,241 @@
+#include "llvm/nameResolver.hpp"
+
+NameBinding* NameResolver::makeBinding(NameBinding::Kind kind, Symbol name, ASTNode* node) {
+  bindings.emplace_back(kind, name, node);
+  return &bindings.back();
+}
+
+NameBinding* NameResolver::lookup(Symbol name) const {
+  // Only the arguments of the innermost function are visible
+  if (!functions.empty()) {
+    auto it = functions.back().arguments.find(name);
+    if (it != functions.back().arguments.end()) return it->second;
+  }
+  for (auto block = blocks.rbegin(); block != blocks.rend(); ++block) {
+    auto it = block->variables.find(name);
+    if (it != block->variables.end()) return it->second;
+    auto fIt = block->functions.find(name);
+    if (fIt != block->functions.end()) return fIt->second;
+  }
+  if (!functions.empty() && functions.back().members != nullptr) {
+    auto members = functions.back().members;
+    auto it = members->find(name);
+    if (it != members->end()) return it->second;
+  }
+  return nullptr;
+}
+
+const std::vector<Symbol>* NameResolver::lookupMembers(Symbol type) const {
+  for (auto block = blocks.rbegin(); block != blocks.rend(); ++block) {
+    auto it = block->typeMembers.find(type);
+    if (it != block->typeMembers.end()) return &it->second;
+  }
+  return nullptr;
+}
+
+void NameResolver::enterRoot(BlockNode* root) {
+  blocks.push_back({});
+  // The runtime's functions are added to the root block before anything is compiled
+  for (const auto& var : root->blockScope) {
+    auto binding = makeBinding(NameBinding::VARIABLE, var.first, root);
+    binding->value = var.second;
+    blocks.back().variables.insert({var.first, binding});
+  }
+  for (const auto& fun : root->blockFuncs) {
+    auto binding = makeBinding(NameBinding::FUNCTION, fun.first, root);
+    binding->value = fun.second;
+    blocks.back().functions.insert({fun.first, binding});
+  }
+}
+
+void NameResolver::resolve(BlockNode* root) {
+  blocks.clear();
+  functions.clear();
+  types.clear();
+  pending.clear();
+  scheduled.clear();
+  streamed = false;
+  enterRoot(root);
+  auto children = root->getChildSpan();
+  for (std::size_t i = children.size(); i-- > 0;) pending.push_back({children[i], Exit::NONE});
+  run();
+  blocks.pop_back();
+}
+
+void NameResolver::resolveStatement(BlockNode* root, ASTNode* statement) {
+  if (blocks.empty()) enterRoot(root);
+  streamed = true;
+  pending.push_back({statement, Exit::NONE});
+  run();
+}
+
+void NameResolver::run() {
+  while (!pending.empty()) {
+    auto task = pending.back();
+    pending.pop_back();
+    switch (task.exit) {
+      case Exit::NONE: break;
+      case Exit::BLOCK: blocks.pop_back(); continue;
+      case Exit::FUNCTION: functions.pop_back(); continue;
+      case Exit::TYPE: types.pop_back(); continue;
+    }
+    // Missing optional children are skipped
+    if (task.node == nullptr) continue;
+    visit(task.node);
+    std::move(scheduled.rbegin(), scheduled.rend(), std::back_inserter(pending));
+    scheduled.clear();
+  }
+}
+
+void NameResolver::enterFunction(FunctionNode* node, bool hasThis, const Names* members) {
+  FunctionScope scope {{}, members};
+  std::size_t argIdx = 0;
+  if (hasThis) {
+    scope.arguments.insert({"this", makeBinding(NameBinding::ARGUMENT, "this", node)});
+    argIdx++;
+  }
+  for (const auto& arg : node->getSignature().getArguments()) {
+    Symbol name = arg.first;
+    auto binding = makeBinding(NameBinding::ARGUMENT, name, node);
+    binding->argument = argIdx++;
+    scope.arguments.insert({name, binding});
+  }
+  functions.push_back(std::move(scope));
+  schedule(node->code().get());
+  scheduleExit(Exit::FUNCTION);
+}
+
+void NameResolver::checkEscape(NameBinding* binding, ExpressionNode* use) const {
+  if (binding->kind != NameBinding::VARIABLE || binding->escapes) return;
+  // Nested functions can run after the function that declared it returned
+  if (binding->depth != functions.size()) {
+    binding->escapes = true;
+    return;
+  }
+  auto parent = use->getParent();
+  switch (parent->getKind()) {
+    case NodeKind::DECLARATION:
+    case NodeKind::RETURN:
+    case NodeKind::MEMBER:
+      binding->escapes = true;
+      return;
+    case NodeKind::EXPRESSION: break;
+    default: return;
+  }
+  auto expr = static_cast<ExpressionNode*>(parent.get());
+  Token tok = expr->getToken();
+  if (!tok.isOp()) return;
+  const Operator& op = tok.op();
+  // Only the right side of an assignment is copied, the left side is written to
+  bool assigned = op.getRefList()[0] && op.getArity() == BINARY && expr->at(1).get() == use;
+  // The result of a conditional might be the variable's value itself
+  if (assigned || op.hasName("Call arguments") || op.hasName("Conditional")) {
+    binding->escapes = true;
+  }
+}
+
+void NameResolver::visitExpression(ExpressionNode* node) {
+  if (node->getToken().type == TT::IDENTIFIER) {
+    auto binding = lookup(node->getSymbol());
+    if (binding == nullptr) throw "Cannot find '{}' in this scope"_syntax(node->getSymbol()) + node->getTrace();
+    node->setBinding(binding);
+    checkEscape(binding, node);
+    return;
+  }
+  Token tok = node->getToken();
+  if (tok.isOp() && tok.op().hasName("Member access")) {
+    // Names after the dot are looked up in the object's type, when it is compiled
+    schedule(node->at(0).get());
+    auto name = node->at(1);
+    if (name->getToken().isOp() && name->getToken().op().hasSymbol("()")) schedule(name->at(0).get());
+    return;
+  }
+  for (auto child : node->getChildSpan()) schedule(child);
+}
+
+void NameResolver::visitDeclaration(DeclarationNode* node) {
+  auto binding = makeBinding(NameBinding::VARIABLE, node->getSymbol(), node);
+  node->setBinding(binding);
+  binding->depth = functions.size();
+  // In the root block, the statements that come later aren't known yet, so they might copy it
+  binding->escapes = streamed && functions.empty() && blocks.size() == 1;
+  // Redefinitions are reported by the compiler, until then the first one is visible
+  blocks.back().variables.insert({node->getSymbol(), binding});
+  // The declaration is in scope for its own initialization
+  if (node->hasInit()) schedule(node->init().get());
+}
+
+void NameResolver::visitBranch(BranchNode* node) {
+  for (auto child : node->getChildSpan()) schedule(child);
+}
+
+void NameResolver::visitLoop(LoopNode* node) {
+  // Initializations are declared in the enclosing block, and updates run after the code
+  for (auto init : node->inits()) schedule(init);
+  schedule(node->condition().get());
+  schedule(node->code().get());
+  for (auto update : node->updates()) schedule(update);
+}
+
+void NameResolver::visitReturn(ReturnNode* node) {
+  for (auto child : node->getChildSpan()) schedule(child);
+}
+
+void NameResolver::visitBlock(BlockNode* node) {
+  blocks.push_back({});
+  for (auto child : node->getChildSpan()) schedule(child);
+  scheduleExit(Exit::BLOCK);
+}
+
+void NameResolver::visitBreakLoop(BreakLoopNode*) {}
+
+void NameResolver::visitFunction(FunctionNode* node) {
+  auto binding = makeBinding(NameBinding::FUNCTION, node->getSymbol(), node);
+  node->setBinding(binding);
+  // Added before the code, so functions can call themselves
+  blocks.back().functions.insert({node->getSymbol(), binding});
+  if (node->isForeign()) return;
+  // Functions inside methods can still see the members
+  enterFunction(node, false, functions.empty() ? nullptr : functions.back().members);
+}
+
+void NameResolver::visitType(TypeNode* node) {
+  // Constructors and methods are compiled after all the members were added, so they see
+  // all of them, regardless of order
+  types.emplace_back();
+  std::vector<Symbol> memberNames {};
+  for (auto child : node->getChildSpan()) {
+    if (child->getKind() != NodeKind::MEMBER) continue;
+    auto name = static_cast<MemberNode*>(child)->getSymbol();
+    types.back().insert({name, makeBinding(NameBinding::MEMBER, name, node)});
+    memberNames.push_back(name);
+  }
+  // Inherited members are found through this type, unless one of its own has the same name
+  for (auto ancestor : node->getAncestors()) {
+    auto inherited = lookupMembers(ancestor);
+    if (inherited == nullptr) continue;
+    for (auto name : *inherited) {
+      if (!types.back().insert({name, makeBinding(NameBinding::MEMBER, name, node)}).second) continue;
+      memberNames.push_back(name);
+    }
+  }
+  blocks.back().typeMembers[node->getName()] = std::move(memberNames);
+  for (auto child : node->getChildSpan()) schedule(child);
+  scheduleExit(Exit::TYPE);
+}
+
+void NameResolver::visitConstructor(ConstructorNode* node) {
+  if (node->isForeign()) return;
+  enterFunction(node, true, &types.back());
+}
+
+void NameResolver::visitMethod(MethodNode* node) {
+  if (node->isForeign()) return;
+  // Static methods have no object to get members from
+  if (node->isStatic()) enterFunction(node, false, nullptr);
+  else enterFunction(node, true, &types.back());
+}
+
+void NameResolver::visitMember(MemberNode* node) {
+  if (node->hasInit()) schedule(node->init().get());
+}
@@ -1,6 +1,8 @@
 #include "llvm/typeData.hpp"
 #include "llvm/compiler.hpp"
 
+#include <numeric>
+
 TypeData::TypeData(llvm::StructType* type, ModuleCompiler::Link mc, Node<TypeNode>::Link tyNode):
   mc(mc),
   node(tyNode),
@@ -24,6 +26,166 @@ std::vector<llvm::Type*> TypeData::getAllocaTypes() const {
   return allocaTypes;
 }
 
+namespace {
+  /// Sort the types by alignment, largest first, and return where each one ended up
+  std::vector<uint> sortByAlignment(std::vector<llvm::Type*>& types, const llvm::DataLayout& layout) {
+    std::vector<uint> order(types.size());
+    std::iota(ALL(order), 0);
+    // Stable, so the members that can go anywhere keep their declaration order
+    std::stable_sort(ALL(order), [&](uint a, uint b) {
+      return layout.getABITypeAlignment(types[a]) > layout.getABITypeAlignment(types[b]);
+    });
+    std::vector<llvm::Type*> sorted {};
+    std::vector<uint> positions(types.size());
+    for (uint pos = 0; pos < order.size(); pos++) {
+      sorted.push_back(types[order[pos]]);
+      positions[order[pos]] = pos;
+    }
+    types = sorted;
+    return positions;
+  }
+}
+
+std::vector<llvm::Type*> TypeData::getLeadingTypes() const {
+  std::vector<llvm::Type*> leading {};
+  if (parent != nullptr) leading.push_back(parent->dataType);
+  if (vtableOwner == this) leading.push_back(llvm::Type::getInt8PtrTy(*mc->context)->getPointerTo());
+  return leading;
+}
+
+void TypeData::layOut() {
+  llvm::DataLayout layout(mc->module);
+  // The vtable pointer is added by the first type in the hierarchy that has methods
+  if (parent != nullptr && parent->vtableOwner != nullptr) {
+    vtableOwner = parent->vtableOwner;
+    vtableField = parent->vtableField;
+  } else if (!methods.empty()) {
+    vtableOwner = this;
+    vtableField = parent == nullptr ? 0 : 1;
+  }
+  auto leading = getLeadingTypes();
+  std::vector<llvm::Type*> hotTypes {};
+  std::vector<llvm::Type*> coldTypes {};
+  // Index of each member in hotTypes or coldTypes
+  std::vector<uint> unsorted {};
+  for (auto mb : members) {
+    auto& types = mb->isCold() ? coldTypes : hotTypes;
+    unsorted.push_back(types.size());
+    types.push_back(mb->getAllocaType());
+  }
+  auto coldPositions = sortByAlignment(coldTypes, layout);
+  if (!coldTypes.empty()) {
+    coldType = llvm::StructType::create(*mc->context, coldTypes, getName() + "_cold");
+    hotTypes.push_back(coldType->getPointerTo());
+  }
+  auto hotPositions = sortByAlignment(hotTypes, layout);
+  // The leading fields aren't sorted, so objects start like the objects of their parent do
+  uint leadingCount = static_cast<uint>(leading.size());
+  if (coldType != nullptr) coldField = leadingCount + hotPositions.back();
+  fieldIndices.clear();
+  for (std::size_t i = 0; i < members.size(); i++) {
+    fieldIndices.push_back(members[i]->isCold() ?
+      coldPositions[unsorted[i]] : leadingCount + hotPositions[unsorted[i]]);
+  }
+  leading.insert(leading.end(), ALL(hotTypes));
+  dataType->setBody(leading);
+  // Types are laid out when they are defined, so the types of the members already were
+  memberTypes.clear();
+  for (auto mb : members) {
+    auto id = mc->typeIdFromInfo(mb->getTypeInfo(), mb->getNode().get());
+    memberTypes.push_back(id->storedTypeCount() == 1 ?
+      PtrUtil<TypeId>::staticPtrCast(id)->getTyData() : nullptr);
+  }
+  coldBlocks.clear();
+  addColdBlocks(coldBlocks, {{dataType, {}}});
+  if (!coldBlocks.empty()) {
+    std::vector<llvm::Type*> blockTypes {};
+    for (auto& block : coldBlocks) blockTypes.push_back(block.type);
+    coldStorageType = llvm::StructType::create(*mc->context, blockTypes, getName() + "_coldStorage");
+  }
+}
+
+uint64_t TypeData::getSize() const {
+  return llvm::DataLayout(mc->module).getTypeAllocSize(dataType);
+}
+
+uint64_t TypeData::getColdSize() const {
+  if (coldType == nullptr) return 0;
+  return llvm::DataLayout(mc->module).getTypeAllocSize(coldType);
+}
+
+uint64_t TypeData::getDeclaredSize() const {
+  auto fields = getLeadingTypes();
+  auto memberTypes = getAllocaTypes();
+  fields.insert(fields.end(), ALL(memberTypes));
+  auto declared = llvm::StructType::get(*mc->context, fields);
+  return llvm::DataLayout(mc->module).getTypeAllocSize(declared);
+}
+
+void TypeData::addColdBlocks(std::vector<ColdBlock>& blocks, ColdBlock::Steps steps) const {
+  // The parent's struct is the first field
+  if (parent != nullptr) {
+    auto parentSteps = steps;
+    parentSteps.back().second.push_back(0);
+    parent->addColdBlocks(blocks, parentSteps);
+  }
+  // Objects in the cold block are reached through it, so it comes before their blocks
+  if (coldType != nullptr) {
+    auto ownSteps = steps;
+    ownSteps.back().second.push_back(coldField);
+    blocks.push_back({coldType, ownSteps});
+  }
+  for (std::size_t i = 0; i < members.size(); i++) {
+    if (memberTypes[i] == nullptr) continue;
+    auto memberSteps = steps;
+    if (members[i]->isCold()) {
+      memberSteps.back().second.push_back(coldField);
+      memberSteps.push_back({coldType, {fieldIndices[i]}});
+    } else {
+      memberSteps.back().second.push_back(fieldIndices[i]);
+    }
+    memberTypes[i]->addColdBlocks(blocks, memberSteps);
+  }
+}
+
+llvm::Value* TypeData::coldPointerIn(llvm::Value* object, const ColdBlock& block) {
+  llvm::Value* ptr = object;
+  for (std::size_t i = 0; i < block.steps.size(); i++) {
+    if (i > 0) ptr = mc->builder->CreateLoad(ptr, "coldMembers");
+    std::vector<llvm::Value*> indices {mc->builder->getInt32(0)};
+    for (uint idx : block.steps[i].second) indices.push_back(mc->builder->getInt32(idx));
+    ptr = mc->builder->CreateInBoundsGEP(block.steps[i].first, ptr, indices, "coldPtr");
+  }
+  return ptr;
+}
+
+llvm::StructType* TypeData::getColdStorageType() const {
+  return coldStorageType;
+}
+
+void TypeData::attachColdStorage(llvm::Value* object, llvm::Value* storage) {
+  for (std::size_t i = 0; i < coldBlocks.size(); i++) {
+    auto block = mc->builder->CreateStructGEP(coldStorageType, storage, static_cast<uint>(i));
+    mc->builder->CreateStore(block, coldPointerIn(object, coldBlocks[i]));
+  }
+}
+
+void TypeData::storeCopy(llvm::Value* data, llvm::Value* dest) {
+  std::vector<llvm::Value*> ownStorage {};
+  for (auto& block : coldBlocks) {
+    ownStorage.push_back(mc->builder->CreateLoad(coldPointerIn(dest, block), "ownColdMembers"));
+  }
+  // This also overwrites dest's cold pointers with the original's, which are put back after
+  mc->builder->CreateStore(data, dest);
+  for (std::size_t i = 0; i < coldBlocks.size(); i++) {
+    // The outer blocks were already copied and put back, so this finds the original's pointer
+    auto pointerInDest = coldPointerIn(dest, coldBlocks[i]);
+    auto original = mc->builder->CreateLoad(pointerInDest, "originalColdMembers");
+    mc->builder->CreateStore(mc->builder->CreateLoad(original, "coldCopy"), ownStorage[i]);
+    mc->builder->CreateStore(ownStorage[i], pointerInDest);
+  }
+}
+
 void TypeData::validateName(std::string name) const {
   // TODO look for functions too
   Trace t = defaultTrace;
@@ -69,12 +231,126 @@ std::string TypeData::getName() const {
   return node->getName();
 }
 
+TypeData* TypeData::getParent() const {
+  return parent;
+}
+
+void TypeData::setParent(TypeData* parent) {
+  this->parent = parent;
+  parent->subtypes.push_back(this);
+}
+
+bool TypeData::hasMember(std::string name) const {
+  bool isOwn = std::any_of(ALL(members), [&](MemberMetadata::Link m) {
+    return m->getName() == name;
+  });
+  return isOwn || (parent != nullptr && parent->hasMember(name));
+}
+
+int TypeData::findSlot(std::string name) const {
+  for (std::size_t i = 0; i < vtableSlots.size(); i++) {
+    if (vtableSlots[i].impl->getName() == name) return static_cast<int>(i);
+  }
+  return -1;
+}
+
+const TypeData::VirtualMethod& TypeData::getSlot(uint slot) const {
+  return vtableSlots[slot];
+}
+
+bool TypeData::isOverridden(uint slot) const {
+  for (auto subtype : subtypes) {
+    if (subtype->vtableSlots[slot].impl != vtableSlots[slot].impl) return true;
+    if (subtype->isOverridden(slot)) return true;
+  }
+  return false;
+}
+
+llvm::Value* TypeData::loadFromVtable(llvm::Value* object, uint slot) {
+  auto& builder = mc->builder;
+  auto slotPtrType = llvm::Type::getInt8PtrTy(*mc->context);
+  // Objects start with the fields of their ancestors, so the vtable pointer is in the same place
+  auto owner = builder->CreateBitCast(object, vtableOwner->dataType->getPointerTo());
+  auto table = builder->CreateLoad(
+    builder->CreateStructGEP(vtableOwner->dataType, owner, vtableField),
+    "vtable"
+  );
+  auto impl = builder->CreateLoad(
+    builder->CreateConstInBoundsGEP1_32(slotPtrType, table, slot),
+    "vtableSlot"
+  );
+  return builder->CreateBitCast(impl, vtableSlots[slot].type->getPointerTo());
+}
+
+void TypeData::buildVtable() {
+  if (vtableOwner == nullptr) return;
+  if (parent != nullptr) vtableSlots = parent->vtableSlots;
+  for (auto method : methods) {
+    llvm::FunctionType* type = method->getFunction()->getValue()->getFunctionType();
+    int slot = findSlot(method->getName());
+    if (slot == -1) {
+      vtableSlots.push_back({method, type});
+      continue;
+    }
+    // Everything but 'this' must be the same, since it can be called like the overridden method
+    llvm::FunctionType* overridden = vtableSlots[slot].type;
+    bool matches = type->getReturnType() == overridden->getReturnType() &&
+      type->getNumParams() == overridden->getNumParams() &&
+      std::equal(type->param_begin() + 1, type->param_end(), overridden->param_begin() + 1);
+    if (!matches) {
+      throw "Method '{0}' in type '{1}' does not match the method it overrides"_type(
+        method->getName(), getName()) + method->getTrace();
+    }
+    vtableSlots[slot].impl = method;
+  }
+  auto slotPtrType = llvm::Type::getInt8PtrTy(*mc->context);
+  std::vector<llvm::Constant*> entries {};
+  for (const auto& slot : vtableSlots) {
+    entries.push_back(llvm::ConstantExpr::getBitCast(slot.impl->getFunction()->getValue(), slotPtrType));
+  }
+  auto tableType = llvm::ArrayType::get(slotPtrType, entries.size());
+  vtable = new llvm::GlobalVariable(
+    *mc->module,
+    tableType,
+    true,
+    llvm::GlobalValue::PrivateLinkage,
+    llvm::ConstantArray::get(tableType, entries),
+    "vtable_" + getName()
+  );
+}
+
 void TypeData::finalize() {
-  std::for_each(ALL(members), [&](MemberMetadata::Link mb) {
-    if (!mb->hasInit()) return;
+  buildVtable();
+  // The inherited members are initialized by the parent's initializer, which also stores its vtable
+  if (parent != nullptr && parent->normalTi.exists()) normalTi.insertCode([=](TypeInitializer& ref) {
+    mc->builder->CreateCall(parent->normalTi.getInit()->getValue(), {
+      mc->builder->CreateStructGEP(dataType, ref.getInitInstance()->val, 0, "base")
+    });
+  });
+  if (vtable != nullptr) normalTi.insertCode([=](TypeInitializer& ref) {
+    auto slotPtrType = llvm::Type::getInt8PtrTy(*mc->context);
+    auto owner = mc->builder->CreateBitCast(
+      ref.getInitInstance()->val, vtableOwner->dataType->getPointerTo());
+    mc->builder->CreateStore(
+      llvm::ConstantExpr::getBitCast(vtable, slotPtrType->getPointerTo()),
+      mc->builder->CreateStructGEP(vtableOwner->dataType, owner, vtableField)
+    );
+  });
+  for (std::size_t i = 0; i < members.size(); i++) {
+    auto mb = members[i];
+    TypeData* memberType = memberTypes[i];
+    if (!mb->hasInit()) {
+      // Objects in members start like declared objects do, with their cold storage in this object's
+      if (memberType == nullptr || !memberType->normalTi.exists()) continue;
+      normalTi.insertCode([=](TypeInitializer& ref) {
+        auto memberDecl = ref.getInitInstance()->getMember(mb->getName());
+        mc->builder->CreateCall(memberType->normalTi.getInit()->getValue(), {memberDecl->val});
+      });
+      continue;
+    }
     normalTi.insertCode([=](TypeInitializer& ref) {
       auto initValue = mc->compileExpression(mb->getInit());
-      auto memberId = mc->typeIdFromInfo(mb->getTypeInfo(), mb->getInit());
+      auto memberId = mc->typeIdFromInfo(mb->getTypeInfo(), mb->getInit().get());
       mc->typeCheck(memberId, initValue,
         "Member '{0}' initialization ({1}) does not match its type ({2})"_type(
           mb->getName(),
@@ -82,15 +358,19 @@ void TypeData::finalize() {
           memberId->typeNames()
         ) + mb->getInit()->getTrace());
       auto memberDecl = ref.getInitInstance()->getMember(mb->getName());
-      mc->builder->CreateStore(initValue->val, memberDecl->val);
+      if (memberType != nullptr) {
+        memberType->storeCopy(mc->load(initValue)->val, memberDecl->val);
+      } else {
+        mc->builder->CreateStore(initValue->val, memberDecl->val);
+      }
       memberDecl->ty = initValue->ty;
     });
-  });
+  }
   normalTi.finalize();
   std::for_each(ALL(staticMembers), [&](MemberMetadata::Link mb) {
     llvm::GlobalVariable* staticVar = new llvm::GlobalVariable(
       *mc->module,
-      mc->typeFromInfo(mb->getTypeInfo(), mb->getNode()),
+      mc->typeFromInfo(mb->getTypeInfo(), mb->getNode().get()),
       false,
       llvm::GlobalValue::InternalLinkage,
       nullptr,
@@ -98,20 +378,37 @@ void TypeData::finalize() {
     );
     if (!mb->hasInit()) return;
     auto initValue = mc->compileExpression(mb->getInit());
-    auto sMemberId = mc->typeIdFromInfo(mb->getTypeInfo(), mb->getInit());
+    auto sMemberId = mc->typeIdFromInfo(mb->getTypeInfo(), mb->getInit().get());
     mc->typeCheck(sMemberId, initValue,
       "Static member '{0}' initialization ({1}) does not match its type ({2})"_type(
         mb->getName(),
         initValue->ty->typeNames(),
         sMemberId->typeNames()
       ) + mb->getInit()->getTrace());
-    mc->builder->CreateStore(initValue->val, staticVar);
+    TypeData* memberType = sMemberId->storedTypeCount() == 1 ?
+      PtrUtil<TypeId>::staticPtrCast(sMemberId)->getTyData() : nullptr;
+    if (memberType == nullptr) {
+      mc->builder->CreateStore(initValue->val, staticVar);
+      return;
+    }
+    // Static objects keep their cold members in a global too
+    if (auto storageType = memberType->getColdStorageType()) {
+      memberType->attachColdStorage(staticVar, new llvm::GlobalVariable(
+        *mc->module,
+        storageType,
+        false,
+        llvm::GlobalValue::InternalLinkage,
+        llvm::ConstantAggregateZero::get(storageType),
+        nameFrom("static_member_cold", mb->getName())
+      ));
+    }
+    memberType->storeCopy(mc->load(initValue)->val, staticVar);
   });
   staticTi.finalize();
   for (auto method : methods) {
     if (!method->isForeign()) {
       mc->functionStack.push(method->getFunction());
-      mc->compileBlock(method->getCodeBlock(), fmt::format("method_{}_entryBlock", method->getName()));
+      mc->compileBlock(method->getCodeBlock().get(), fmt::format("method_{}_entryBlock", method->getName()));
       mc->functionStack.pop();
     }
   }
@@ -134,7 +431,7 @@ void TypeData::finalize() {
           {thisPtrRef->val}
         );
       }
-      for (auto& child : constr->getCodeBlock()->getChildren()) child->visit(mc);
+      for (auto child : constr->getCodeBlock()->getChildSpan()) mc->visit(child);
       mc->builder->CreateRetVoid();
       mc->functionStack.pop();
       mc->builder->SetInsertPoint(oldBlock);
@@ -269,6 +566,10 @@ std::string MemberMetadata::getName() const {
   return mem->getIdentifier();
 }
 
+bool MemberMetadata::isCold() const {
+  return mem->isCold();
+}
+
 bool MemberMetadata::hasInit() const {
   return mem->hasInit();
 }
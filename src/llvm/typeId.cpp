@@ -1,11 +1,73 @@
 #include "llvm/typeId.hpp"
 #include "llvm/typeData.hpp"
 
-TypeId::TypeId(TypeData* tyData): tyData(tyData) {
-  name = tyData->getName();
+#include <mutex>
+
+namespace {
+  /// The ids and indices given to each name, shared by all the compilers
+  class IdRegistry {
+  private:
+    std::mutex lock;
+    std::unordered_map<TypeName, UniqueIdentifier> ids {};
+    std::unordered_set<UniqueIdentifier> usedIds {};
+    std::unordered_map<TypeName, std::size_t> indices {};
+
+    /// 64-bit FNV-1a, which doesn't change between runs or platforms, unlike std::hash
+    static uint64_t stableHash(const TypeName& name) {
+      uint64_t hash = 0xcbf29ce484222325;
+      for (unsigned char c : name) {
+        hash ^= c;
+        hash *= 0x100000001b3;
+      }
+      return hash;
+    }
+  public:
+    UniqueIdentifier idFor(const TypeName& name) {
+      std::lock_guard<std::mutex> guard(lock);
+      auto it = ids.find(name);
+      if (it != ids.end()) return it->second;
+      UniqueIdentifier id = stableHash(name);
+      // Probe for a free id on collisions, skipping 0
+      while (id == 0 || usedIds.count(id) != 0) id++;
+      usedIds.insert(id);
+      ids.insert({name, id});
+      return id;
+    }
+
+    std::size_t indexFor(const TypeName& name) {
+      std::lock_guard<std::mutex> guard(lock);
+      auto inserted = indices.insert({name, indices.size()});
+      return inserted.first->second;
+    }
+  };
+
+  IdRegistry& registry() {
+    static IdRegistry reg;
+    return reg;
+  }
+}
+
+UniqueIdentifier AbstractId::idFor(const TypeName& qualifiedName) {
+  return registry().idFor(qualifiedName);
+}
+
+std::size_t TypeId::indexFor(const TypeName& qualifiedName) {
+  return registry().indexFor(qualifiedName);
+}
+
+TypeId::TypeId(TypeData* tyData):
+  AbstractId(tyData->getName()),
+  tyData(tyData),
+  index(indexFor(name)) {
+  names = {name};
+  mask.set(index);
 }
-TypeId::TypeId(TypeName name, llvm::Type* ty): basicTy(ty) {
-  this->name = name;
+TypeId::TypeId(TypeName name, llvm::Type* ty):
+  AbstractId(name),
+  basicTy(ty),
+  index(indexFor(name)) {
+  names = {name};
+  mask.set(index);
 }
 
 std::shared_ptr<TypeId> TypeId::create(TypeData* tyData) {
@@ -25,20 +87,19 @@ TypeCompat TypeId::isCompat(AbstractId::Link rhs) const noexcept {
   if (rhs->storedTypeCount() == 1) {
     return *rhs == *this ? COMPATIBLE : INCOMPATIBLE;
   }
-  auto typeList = PtrUtil<TypeListId>::staticPtrCast(rhs);
   // If the type list doesn't have lhs type in it, it's decidely incompatible
-  bool possibleCompat = includes(typeList->getTypes(), [=](auto ty) {
-    return *this == *ty;
-  });
-  return possibleCompat ? DYNAMIC : INCOMPATIBLE;
+  return rhs->getMask().test(index) ? DYNAMIC : INCOMPATIBLE;
 }
 
 TypeListId::TypeListId(
   TypeName name,
   std::unordered_set<AbstractId::Link> types,
   llvm::StructType* taggedUnionType
-): taggedUnionType(taggedUnionType), types(types) {
-  this->name = name;
+): AbstractId(name), taggedUnionType(taggedUnionType), types(types) {
+  for (auto id : types) {
+    names.insert(id->getName());
+    mask |= id->getMask();
+  }
   if (types.size() <= 1) {
     throw InternalError(
       "Trying to make a list of 1 or less elements (use TypeId for 1 element)",
@@ -55,33 +116,33 @@ TypeListId::Link TypeListId::create(
   return std::make_shared<TypeListId>(TypeListId(n, v, t));
 }
 
-TypeList TypeListId::storedNames() const noexcept {
-  TypeList names;
-  std::for_each(ALL(types), [&](AbstractId::Link id) {
-    names.insert(id->getName());
-  });
-  return names;
-}
-
 llvm::Type* TypeListId::getAllocaType() const noexcept {
   return taggedUnionType;
 }
 
 TypeCompat TypeListId::isCompat(AbstractId::Link rhs) const noexcept {
+  // A single type's mask is just its own bit
   if (rhs->storedTypeCount() == 1) {
-    return includes(types, rhs) ? COMPATIBLE : INCOMPATIBLE;
+    return mask.intersects(rhs->getMask()) ? COMPATIBLE : INCOMPATIBLE;
   }
-  auto typeList = PtrUtil<TypeListId>::staticPtrCast(rhs);
-  bool possibleCompat = false;
-  // O(n * m) in theory, too small to care in practice
-  for (auto lhsTy : types) {
-    for (auto rhsTy : typeList->types) {
-      if (rhsTy == lhsTy) {
-        possibleCompat = true;
-        goto breakLoop;
-      }
-    }
-  }
-  breakLoop:
-  return possibleCompat ? DYNAMIC : INCOMPATIBLE;
+  // If they share any type, it depends on what the list currently stores
+  return mask.intersects(rhs->getMask()) ? DYNAMIC : INCOMPATIBLE;
+}
+
+TypeListId::Link TypeListTable::get(
+  std::vector<AbstractId::Link> types,
+  llvm::StructType* taggedUnionType
+) {
+  std::sort(ALL(types), [](AbstractId::Link a, AbstractId::Link b) {
+    return a->getId() < b->getId();
+  });
+  types.erase(std::unique(ALL(types)), types.end());
+  auto it = lists.find(types);
+  if (it != lists.end()) return it->second;
+  auto name = collate(types, [](AbstractId::Link id) {
+    return id->getName();
+  });
+  auto list = TypeListId::create(name, std::unordered_set<AbstractId::Link>(ALL(types)), taggedUnionType);
+  lists.insert({std::move(types), list});
+  return list;
 }
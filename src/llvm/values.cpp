@@ -40,19 +40,34 @@ ValueWrapper::Link InstanceWrapper::getMember(std::string name) {
     idx++;
     return m->getName() == name;
   });
-  if (member == tyd->members.end())
-    throw "Cannot find member '{0}' in type '{1}'"_syntax(name, ty->getName()) + tyd->node->getTrace();
+  if (member == tyd->members.end()) {
+    if (!tyd->hasMember(name))
+      throw "Cannot find member '{0}' in type '{1}'"_syntax(name, ty->getName()) + tyd->node->getTrace();
+    // Inherited members are in the parent's fields, at the start of the object
+    if (base == nullptr) {
+      auto baseGep = tyd->mc->builder->CreateStructGEP(tyd->dataType, this->val, 0, "base");
+      base = std::make_shared<InstanceWrapper>(baseGep, tyd->parent->node->getTid());
+    }
+    return base->getMember(name);
+  }
   auto declMember = members.find(name);
   if (declMember == members.end()) {
     // Add it if it isn't there
-    auto gep = tyd->mc->builder->CreateStructGEP(
-      tyd->dataType,
-      this->val,
-      static_cast<uint>(idx),
-      "gep_" + name
-    );
-    auto id = tyd->mc->typeIdFromInfo((*member)->getTypeInfo(), tyd->node);
-    return members[name] = std::make_shared<ValueWrapper>(gep, id);
+    auto& builder = tyd->mc->builder;
+    uint field = tyd->fieldIndices[idx];
+    llvm::Value* gep;
+    if ((*member)->isCold()) {
+      auto coldPtr = builder->CreateLoad(
+        builder->CreateStructGEP(tyd->dataType, this->val, tyd->coldField),
+        "cold_" + name
+      );
+      gep = builder->CreateStructGEP(tyd->coldType, coldPtr, field, "gep_" + name);
+    } else {
+      gep = builder->CreateStructGEP(tyd->dataType, this->val, field, "gep_" + name);
+    }
+    auto id = tyd->mc->typeIdFromInfo((*member)->getTypeInfo(), tyd->node.get());
+    // The object is stored in the member, so it can't be of a subtype
+    return members[name] = std::make_shared<ValueWrapper>(gep, id, true);
   } else {
     return members[name];
   }
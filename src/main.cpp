@@ -10,6 +10,7 @@
 #include "parser/tokenParser.hpp"
 #include "parser/xmlParser.hpp"
 #include "llvm/compiler.hpp"
+#include "llvm/typeData.hpp"
 #include "llvm/runner.hpp"
 
 enum ExitCodes: int {
@@ -40,14 +41,16 @@ std::unique_ptr<AST> parseXML(fs::path filePath, std::string cliEval) {
   }
 }
 
-std::vector<Token> tokenize(fs::path filePath, std::string cliEval) {
-  if (!filePath.empty()) {
-    std::ifstream file(filePath);
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return Lexer::tokenize(buffer.str(), filePath)->getTokens();
-  }
-  return Lexer::tokenize(cliEval, "<cli-eval>")->getTokens();
+/// Files are mapped, so the returned Lexer must outlive its tokens
+std::unique_ptr<Lexer> tokenize(fs::path filePath, std::string cliEval, unsigned lexThreads) {
+  if (!filePath.empty()) return Lexer::tokenizeFile(filePath, lexThreads);
+  return Lexer::tokenize(cliEval, "<cli-eval>");
+}
+
+/// Like tokenize, but nothing is lexed until the parser asks for it
+std::unique_ptr<Lexer> openLexer(fs::path filePath, std::string cliEval) {
+  if (!filePath.empty()) return Lexer::openFile(filePath);
+  return Lexer::open(cliEval, "<cli-eval>");
 }
 
 /// Throw if the assertion is false
@@ -67,6 +70,7 @@ int notReallyMain(int argc, const char* argv[]) {
     TCLAP::SwitchArg printTokens("", "tokens", "Print token list (if applicable)", cmd);
     TCLAP::SwitchArg printAST("", "ast", "Print AST (if applicable)", cmd);
     TCLAP::SwitchArg printIR("", "ir", "Print LLVM IR (if applicable)", cmd);
+    TCLAP::SwitchArg printStats("", "stats", "Print how many type checks are left to runtime, and the size of each type", cmd);
 
     TCLAP::SwitchArg doNotParse("", "no-parse", "Don't parse the token list", cmd);
     TCLAP::SwitchArg doNotRun("", "no-run", "Don't execute the AST", cmd);
@@ -82,6 +86,9 @@ int notReallyMain(int argc, const char* argv[]) {
       false, std::string(), "path", cmd, nullptr);
     TCLAP::ValueArg<std::string> outPath("o", "output", "Write exe to this file",
       false, std::string(), "path", cmd, nullptr);
+    TCLAP::ValueArg<unsigned> lexThreads("", "lex-threads",
+      "Lex large files in this many parallel chunks, before parsing them", false,
+      1, "count", cmd, nullptr);
     cmd.parse(argc, argv);
 
     // There must be at least one input
@@ -100,27 +107,64 @@ int notReallyMain(int argc, const char* argv[]) {
     assertCliIntegrity(cmd, printAST.getValue() && doNotParse.getValue(),
       "--no-parse and --ast are incompatible");
 
+    // The XML parser does not use the lexer
+    assertCliIntegrity(cmd, asXML.getValue() && lexThreads.getValue() > 1,
+      "--lex-threads and --xml are incompatible");
+
     // Can't print IR without parsing the AST
     assertCliIntegrity(cmd, printIR.getValue() && doNotParse.getValue(),
       "--no-parse and --ir are incompatible");
 
+    // Nothing is type checked without compiling
+    assertCliIntegrity(cmd, printStats.getValue() && doNotParse.getValue(),
+      "--no-parse and --stats are incompatible");
+
     std::unique_ptr<AST> ast;
+    // If the tokens and the AST aren't needed as a whole, compile statements as they are parsed
+    // Lexing in parallel also needs the whole input at once
+    bool isStreamed = !asXML.getValue() && !printTokens.getValue() &&
+      !printAST.getValue() && !doNotParse.getValue() && lexThreads.getValue() <= 1;
 
     if (asXML.getValue()) {
       ast = parseXML(filePath.getValue(), code.getValue());
-    } else {
-      auto tokens = tokenize(filePath.getValue(), code.getValue());
-      if (printTokens.getValue()) for (auto tok : tokens) println(tok);
+    } else if (!isStreamed) {
+      auto lexer = tokenize(filePath.getValue(), code.getValue(), lexThreads.getValue());
+      if (printTokens.getValue()) for (auto tok : lexer->getTokens()) println(tok);
 
       if (doNotParse.getValue()) return NORMAL_EXIT;
-      ast = std::make_unique<AST>(TokenParser::parse(tokens));
+      ast = std::make_unique<AST>(TokenParser::parse(lexer->getTokenStore()));
     }
 
     if (printAST.getValue()) ast->print();
 
-    auto mc = ModuleCompiler::create({}, "Command Line Module", *ast, true);
-    mc->compile();
+    ModuleCompiler::Link mc;
+    if (isStreamed) {
+      mc = ModuleCompiler::create({}, "Command Line Module", AST(Node<BlockNode>::make(ROOT_BLOCK)), true);
+      auto lexer = openLexer(filePath.getValue(), code.getValue());
+      TokenParser::parseStatements(*lexer, [&mc](ASTNode::Link statement) {
+        mc->compileStatement(statement);
+      });
+      mc->finish();
+    } else {
+      mc = ModuleCompiler::create({}, "Command Line Module", *ast, true);
+      mc->compile();
+    }
     if (printIR.getValue()) mc->getModule()->print(llvm::outs(), nullptr);;
+    if (printStats.getValue()) {
+      const auto& stats = mc->getTypeCheckStats();
+      println("Runtime type checks:", stats.dynamic);
+      println("Runtime type checks removed:", stats.removed);
+      std::vector<TypeData*> userTypes {};
+      for (auto type : *mc->getTypeSetPtr()) {
+        auto tid = PtrUtil<TypeId>::dynPtrCast(type);
+        if (tid && tid->getTyData() != nullptr) userTypes.push_back(tid->getTyData());
+      }
+      std::sort(ALL(userTypes), [](auto a, auto b) { return a->getName() < b->getName(); });
+      for (auto tyData : userTypes) {
+        println(fmt::format("Size of type '{0}': {1} bytes, {2} in declaration order, {3} cold",
+          tyData->getName(), tyData->getSize(), tyData->getDeclaredSize(), tyData->getColdSize()));
+      }
+    }
 
     if (doNotRun.getValue()) return NORMAL_EXIT;
 
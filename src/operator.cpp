@@ -113,6 +113,72 @@ const std::unordered_set<char> Operator::operatorCharacters = std::accumulate(
   }
 );
 
+namespace {
+  /**
+    \brief Trie of all the symbols in Operator::list.
+    
+    Built once, the first time it's used.
+  */
+  class SymbolTrie {
+  private:
+    /// Symbols are ASCII, so the other characters can't be in the trie
+    static constexpr std::size_t alphabetSize = 128;
+    struct TrieNode {
+      /// Index of the child node for each character, 0 for none (0 is the root)
+      std::array<uint16_t, alphabetSize> next {};
+      Operator::SymbolMatch match;
+    };
+    std::vector<TrieNode> nodes {TrieNode()};
+  public:
+    SymbolTrie() {
+      for (Operator::Index idx = 0; idx < Operator::list.size(); ++idx) {
+        auto symbol = Operator::list[idx].getSymbol();
+        std::size_t node = 0;
+        for (char c : symbol) {
+          auto ch = static_cast<unsigned char>(c);
+          if (ch >= alphabetSize) throw InternalError("Operator symbols must be ASCII", {
+            METADATA_PAIRS,
+            {"symbol", symbol}
+          });
+          if (nodes[node].next[ch] == 0) {
+            nodes[node].next[ch] = static_cast<uint16_t>(nodes.size());
+            nodes.emplace_back();
+          }
+          node = nodes[node].next[ch];
+        }
+        auto& match = nodes[node].match;
+        if (match.candidateCount == match.candidates.size()) {
+          throw InternalError("Too many operators with the same symbol", {
+            METADATA_PAIRS,
+            {"symbol", symbol}
+          });
+        }
+        match.length = symbol.length();
+        match.candidates[match.candidateCount++] = idx;
+      }
+    }
+    
+    Operator::SymbolMatch longestMatch(const char* begin, const char* end) const noexcept {
+      Operator::SymbolMatch longest;
+      std::size_t node = 0;
+      for (auto it = begin; it != end; ++it) {
+        auto ch = static_cast<unsigned char>(*it);
+        if (ch >= alphabetSize || nodes[node].next[ch] == 0) break;
+        node = nodes[node].next[ch];
+        if (nodes[node].match.candidateCount != 0) longest = nodes[node].match;
+      }
+      return longest;
+    }
+  };
+  
+  constexpr std::size_t SymbolTrie::alphabetSize;
+}
+
+Operator::SymbolMatch Operator::matchSymbol(const char* begin, const char* end) noexcept {
+  static const SymbolTrie trie;
+  return trie.longestMatch(begin, end);
+}
+
 Operator::Index Operator::find(Operator::Name name) {
   int idx = -1;
   auto it = std::find_if(ALL(Operator::list), [&](auto op) {
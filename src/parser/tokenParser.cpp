@@ -1,211 +1,220 @@
 #include "parser/tokenParser.hpp"
 
-AST TokenParser::parse(std::vector<Token> list) {
-  TokenParser tp = TokenParser();
-  tp.input = list;
+AST TokenParser::parse(const TokenStore& input) {
+  ASTArena::Scope arena;
+  TokenParser tp(input);
   return AST(tp.block(ROOT_BLOCK));
 }
 
+AST TokenParser::parse(const std::vector<Token>& input) {
+  return parse(TokenStore::fromTokens(input));
+}
+
+void TokenParser::parseStatements(Lexer& lexer, std::function<void(ASTNode::Link)> onStatement) {
+  lexer.lexMore();
+  TokenParser tp(TokenCursor(lexer.getTokenStore(), [&lexer]() {
+    return lexer.lexMore();
+  }));
+  // Same loop as for ROOT_BLOCK in block
+  while (!tp.accept(TT::END) && !tp.accept(TT::FILE_END)) {
+    // Each statement gets its own arena, so it can be freed as soon as it is not needed
+    ASTArena::Scope arena;
+    auto statement = tp.statement();
+    // Only the current token is still needed
+    tp.input.rebase(lexer.discardTokensBefore(tp.input.getPosition()));
+    onStatement(statement);
+  }
+}
+
 Node<ExpressionNode>::Link TokenParser::exprFromCurrent() {
   auto e = Node<ExpressionNode>::make(current());
-  e->setTrace(current().trace);
+  e->setTrace(currentTrace());
   return e;
 }
 
-Node<ExpressionNode>::Link TokenParser::parseCircumfixGroup(Token begin) {
-  const TokenType end =
-    begin.type == TT::PAREN_LEFT ? TT::PAREN_RIGHT :
-    begin.type == TT::CALL_BEGIN ? TT::CALL_END :
-    begin.type == TT::SQPAREN_LEFT ? TT::SQPAREN_RIGHT :
-      TT::UNPROCESSED;
-  if (end == TT::UNPROCESSED)
-    throw InternalError("Wrong token passed to parseCircumfixGroup", {
-      METADATA_PAIRS,
-      {"begin", begin.toString()}
-    });
-  // Allow empty expression only for calls
-  bool throwIfEmpty = begin.type != TT::CALL_BEGIN;
-  // Circumfix groups are guaranteed to be matched correctly by the lexer, so we only
-  // need to keep track of how many times is our group opened. When we close
-  // begin's group, beginOccurrences will be 0, because the begin token is skipped
-  unsigned beginOccurrences = 1;
-  const int beginPos = static_cast<int>(pos);
-  std::size_t tokensInGroup = 0;
-  while (beginOccurrences > 0) {
-    if (accept(begin.type)) {
-      beginOccurrences++;
-    }
-    if (accept(end)) {
-      beginOccurrences--;
-    }
-    tokensInGroup++;
-    skip();
-  } // At this point the end token is already skipped
-  // No tokens means empty expression
-  if (tokensInGroup - 1 == 0) {
-    if (throwIfEmpty) throw InternalError("Empty expression", {
-      METADATA_PAIRS,
-      {"circumfix group begin", begin.toString()}
-    });
-    return nullptr;
+void TokenParser::addPostfix(PendingExpression& expr, Node<ExpressionNode>::Link postfix) {
+  if (expr.postfixes == nullptr) {
+    postfix->addChild(expr.terminal);
+  } else {
+    postfix->addChild(expr.postfixes);
   }
-  // This is like recursively calling expression(), but it has to be isolated from
-  // the parent parser because it wouldn't know where to stop. Copying the correct
-  // tokens ensures that only those are parsed, and doesn't mess with the parent's
-  // internal state
-  TokenParser recursive = TokenParser();
-  // Copy everything between the beginning of the group and the end in the recursive
-  // parser. beginPos is already after begin, but tokensInGroup counts the end, so -1
-  recursive.input = std::vector<Token>(
-    std::begin(input) + beginPos,
-    std::begin(input) + beginPos + static_cast<int>(tokensInGroup) - 1
-  );
-  // Throw in a TT::FILE_END if there isn't any, so acceptEndOfExpression works
-  if (recursive.input.back().type != TT::FILE_END)
-    recursive.input.push_back(Token(TT::FILE_END, "", nullptr));
-  return recursive.expression(throwIfEmpty);
+  expr.postfixes = postfix;
 }
 
-Node<ExpressionNode>::Link TokenParser::parsePostfix(Node<ExpressionNode>::Link terminal) {
-  Node<ExpressionNode>::Link base;
-  // Check if there are any postfix operators around (function calls are postfix ops)
-  while (accept(POSTFIX) || accept(TT::CALL_BEGIN)) {
-    Node<ExpressionNode>::Link newOp;
-    if (accept(POSTFIX)) {
-      newOp = exprFromCurrent();
-      skip();
-    } else {
-      newOp = Node<ExpressionNode>::make(
-        Token(TT::OPERATOR, Operator::find("Call"), current().trace));
-      Token begin = current();
-      skip(); // Skip TT::CALL_BEGIN
-      auto insideCall = parseCircumfixGroup(begin);
-      auto args = Node<ExpressionNode>::make(
-        Token(TT::OPERATOR, Operator::find("Call arguments"), current().trace));
-      auto lastNode = insideCall;
-      // Don't add any arguments to the call if the expression is empty
-      // 0 args
-      if (insideCall == nullptr) {
-        newOp->addChild(args);
-      } else if (!(lastNode->getToken().isOp() && lastNode->getToken().op().hasSymbol(","))) {
-        // If it's not an comma, it means this func call only has one argument
-        // 1 arg
-        args->addChild(lastNode);
-        newOp->addChild(args);
-      } else {
-        // 2+ arguments
-        std::vector<Node<ExpressionNode>::Link> argList;
-        while (lastNode->getToken().op().hasSymbol(",")) {
-          argList.push_back(lastNode->at(1));
-          auto tok = lastNode->at(0)->getToken();
-          if (tok.type != TT::OPERATOR || !tok.op().hasSymbol(",")) break;
-          lastNode = lastNode->at(0);
-        }
-        // The last comma's arg 2 is not processed in the loop
-        argList.push_back(lastNode->at(0));
-        // They come in reverse order due to depth-first above
-        std::reverse(ALL(argList));
-        for (auto arg : argList) {
-          args->addChild(arg);
-        }
-        newOp->addChild(args);
-      }
+void TokenParser::addCallArguments(Node<ExpressionNode>::Link call, Node<ExpressionNode>::Link insideCall) {
+  static const Operator::Index callArguments = Operator::find("Call arguments");
+  auto args = Node<ExpressionNode>::make(Token(TT::OPERATOR, callArguments, currentTrace()));
+  auto lastNode = insideCall;
+  // Don't add any arguments to the call if the expression is empty
+  // 0 args
+  if (insideCall == nullptr) {
+    call->addChild(args);
+  } else if (!(lastNode->getToken().isOp() && lastNode->getToken().op().hasSymbol(","))) {
+    // If it's not an comma, it means this func call only has one argument
+    // 1 arg
+    args->addChild(lastNode);
+    call->addChild(args);
+  } else {
+    // 2+ arguments
+    std::vector<Node<ExpressionNode>::Link> argList;
+    while (lastNode->getToken().op().hasSymbol(",")) {
+      argList.push_back(lastNode->at(1));
+      auto tok = lastNode->at(0)->getToken();
+      if (tok.type != TT::OPERATOR || !tok.op().hasSymbol(",")) break;
+      lastNode = lastNode->at(0);
     }
-    if (base == nullptr) {
-      base = newOp;
-      base->addChild(terminal);
-    } else {
-      newOp->addChild(base);
-      base = newOp;
+    // The last comma's arg 2 is not processed in the loop
+    argList.push_back(lastNode->at(0));
+    // They come in reverse order due to depth-first above
+    std::reverse(ALL(argList));
+    for (auto arg : argList) {
+      args->addChild(arg);
     }
+    call->addChild(args);
   }
-  return base == nullptr ? terminal : base;
 }
 
-Node<ExpressionNode>::Link TokenParser::parseExpressionPrimary() {
-  if (acceptEndOfExpression()) return nullptr; // Empty expression
-  Node<ExpressionNode>::Link expr;
-  if (accept(TT::CALL_BEGIN) || accept(TT::SQPAREN_LEFT))
-    throw InternalError("The grammar does not allow this to be here", {
-      METADATA_PAIRS,
-      {"token", current().toString()}
-    });
-  if (accept(TT::PAREN_LEFT)) {
+Node<ExpressionNode>::Link TokenParser::expression(bool throwIfEmpty) {
+  // The expressions that contain the circumfix group currently being parsed
+  std::vector<PendingExpression> outer;
+  PendingExpression expr(input, throwIfEmpty);
+  Node<ExpressionNode>::Link operand = nullptr;
+  // Enter the group that starts at the current token
+  const auto beginGroup = [&](bool isCall) -> bool {
     Token begin = current();
-    skip();
-    expr = parseCircumfixGroup(begin);
-    return parsePostfix(expr);
-  } else if (acceptTerminal()) {
-    expr = exprFromCurrent();
-    skip();
-    return parsePostfix(expr);
-  // Prefix operators
-  } else if (accept(PREFIX)) {
-    auto lastNode = expr = exprFromCurrent();
-    skip();
-    while (accept(PREFIX)) {
-      lastNode->addChild(exprFromCurrent());
-      lastNode = lastNode->at(-1);
-      skip();
+    // The lexer already found where the group is closed
+    std::size_t endPos = input.matchingParen();
+    if (endPos == TokenStore::unmatched)
+      throw InternalError("Unmatched circumfix group", {
+        METADATA_PAIRS,
+        {"circumfix group begin", begin.toString()}
+      });
+    skip(); // Skip the begin token
+    const std::size_t beginPos = input.getPosition();
+    skip(static_cast<int>(endPos + 1 - beginPos)); // Skip the group and its end token
+    // No tokens means empty expression, which is allowed only for calls
+    if (endPos == beginPos) {
+      if (!isCall) throw InternalError("Empty expression", {
+        METADATA_PAIRS,
+        {"circumfix group begin", begin.toString()}
+      });
+      return false;
     }
-    auto terminalAndPostfix = parseExpressionPrimary();
-    lastNode->addChild(terminalAndPostfix);
-    return expr;
-  }
-  throw "Illegal token '{}' in expression"_syntax(current().data) + current().trace;
-}
-
-Node<ExpressionNode>::Link TokenParser::expressionImpl(Node<ExpressionNode>::Link lhs, int minPrecedence) {
-  Node<ExpressionNode>::Link base = nullptr;
-  
-  Node<ExpressionNode>::Link lastExpr = nullptr;
-  Token tok = current();
-  if (acceptEndOfExpression()) return lhs;
-  while (tok.isOp() && tok.op().hasArity(BINARY) && tok.op().getPrec() >= minPrecedence) {
-    auto tokExpr = Node<ExpressionNode>::make(tok);
-    tokExpr->setTrace(tok.trace);
-    tokExpr->addChild(lhs);
-    skip();
-    auto rhs = parseExpressionPrimary();
-    tok = current();
-    while (tok.isOp() && tok.op().hasArity(BINARY) &&
-      (
-        tok.op().getPrec() <= tokExpr->getToken().op().getPrec() ||
-        (tok.op().getPrec() == tokExpr->getToken().op().getPrec() && tok.op().hasAsoc(ASSOCIATE_FROM_RIGHT))
-      )
-    ) {
-      tokExpr->addChild(rhs);
-      tokExpr = expressionImpl(tokExpr, tok.op().getPrec());
-      rhs = nullptr;
-      tok = current();
-    }
-    lhs = rhs;
-    if (base == nullptr) {
-      base = lastExpr = tokExpr;
+    expr.after = input;
+    outer.push_back(std::move(expr));
+    // The inside of the group is read in place, and its end looks like a TT::FILE_END, so
+    // acceptEndOfExpression works
+    input = input.range(beginPos, endPos);
+    expr = PendingExpression(input, !isCall);
+    return true;
+  };
+  enum class Step {PRIMARY, POSTFIX, OPERATOR};
+  Step step = Step::PRIMARY;
+  while (true) {
+    if (step == Step::PRIMARY) {
+      step = Step::OPERATOR;
+      operand = nullptr;
+      if (acceptEndOfExpression()) {
+        // Example of empty expressions: "" or ";"
+        if (expr.operators.empty() && expr.throwIfEmpty) throw InternalError("Empty expression", {
+          METADATA_PAIRS,
+          {"token", current().toString()}
+        });
+        continue;
+      }
+      if (accept(PREFIX)) {
+        expr.prefixes = expr.lastPrefix = exprFromCurrent();
+        skip();
+        while (accept(PREFIX)) {
+          auto prefix = exprFromCurrent();
+          expr.lastPrefix->addChild(prefix);
+          expr.lastPrefix = prefix;
+          skip();
+        }
+        if (acceptEndOfExpression()) {
+          operand = expr.prefixes;
+          expr.prefixes = expr.lastPrefix = nullptr;
+          continue;
+        }
+      }
+      if (accept(TT::CALL_BEGIN) || accept(TT::SQPAREN_LEFT))
+        throw InternalError("The grammar does not allow this to be here", {
+          METADATA_PAIRS,
+          {"token", current().toString()}
+        });
+      if (accept(TT::PAREN_LEFT)) {
+        beginGroup(false);
+        step = Step::PRIMARY;
+      } else if (acceptTerminal()) {
+        expr.terminal = exprFromCurrent();
+        skip();
+        step = Step::POSTFIX;
+      } else {
+        throw "Illegal token '{}' in expression"_syntax(currentData()) + currentTrace();
+      }
+    } else if (step == Step::POSTFIX) {
+      // Function calls are postfix ops too
+      if (accept(POSTFIX)) {
+        auto postfix = exprFromCurrent();
+        skip();
+        addPostfix(expr, postfix);
+      } else if (accept(TT::CALL_BEGIN)) {
+        static const Operator::Index callOperator = Operator::find("Call");
+        auto call = Node<ExpressionNode>::make(Token(TT::OPERATOR, callOperator, currentTrace()));
+        if (beginGroup(true)) {
+          outer.back().call = call;
+          step = Step::PRIMARY;
+        } else {
+          addCallArguments(call, nullptr);
+          addPostfix(expr, call);
+        }
+      } else {
+        operand = expr.postfixes == nullptr ? expr.terminal : expr.postfixes;
+        if (expr.prefixes != nullptr) {
+          expr.lastPrefix->addChild(operand);
+          operand = expr.prefixes;
+        }
+        expr.prefixes = expr.lastPrefix = expr.terminal = expr.postfixes = nullptr;
+        step = Step::OPERATOR;
+      }
     } else {
-      lastExpr->addChild(tokExpr);
-      lastExpr = tokExpr;
+      // Operators are compared only to the last pending one: if it binds tighter, or as tight,
+      // it gets the operand and becomes the left operand of the current one
+      if (input.isOp() && input.op().hasArity(BINARY)) {
+        auto binary = exprFromCurrent();
+        if (!expr.operators.empty() &&
+          binary->getToken().op().getPrec() <= expr.operators.back()->getToken().op().getPrec()) {
+          if (operand != nullptr) expr.operators.back()->addChild(operand);
+          operand = expr.operators.back();
+          expr.operators.pop_back();
+        }
+        binary->addChild(operand);
+        expr.operators.push_back(binary);
+        skip();
+        step = Step::PRIMARY;
+        continue;
+      }
+      // The expression is over, so every operator is the right operand of the previous one
+      while (!expr.operators.empty()) {
+        if (operand != nullptr) expr.operators.back()->addChild(operand);
+        operand = expr.operators.back();
+        expr.operators.pop_back();
+      }
+      if (outer.empty()) return operand;
+      // Continue with the primary that the group was part of
+      input = outer.back().after;
+      expr = std::move(outer.back());
+      outer.pop_back();
+      if (expr.call != nullptr) {
+        addCallArguments(expr.call, operand);
+        addPostfix(expr, expr.call);
+        expr.call = nullptr;
+      } else {
+        expr.terminal = operand;
+      }
+      step = Step::POSTFIX;
     }
-    if (acceptEndOfExpression()) break;
-  }
-  if (base == nullptr) {
-    base = lhs;
-  } else if (lhs != nullptr) {
-    lastExpr->addChild(lhs);
-  }
-  return base;
-}
-
-Node<ExpressionNode>::Link TokenParser::expression(bool throwIfEmpty) {
-  auto primary = parseExpressionPrimary();
-  if (primary == nullptr) {
-    if (throwIfEmpty) throw InternalError("Empty expression", {
-      METADATA_PAIRS,
-      {"token", current().toString()}
-    });
-    else return nullptr;
   }
-  return expressionImpl(primary, 0);
 }
 
 Node<DeclarationNode>::Link TokenParser::declarationFromTypes(TypeList typeList) {
@@ -232,7 +241,7 @@ Node<DeclarationNode>::Link TokenParser::declaration(bool throwIfEmpty) {
     expect(TT::IDENTIFIER, "Unexpected token after define keyword");
     return declarationFromTypes({});
   } else if (accept(TT::IDENTIFIER)) {
-    auto ident = current().data;
+    auto ident = currentData().symbol();
     skip();
     // Single-type declaration
     if (accept(TT::IDENTIFIER)) {
@@ -244,40 +253,50 @@ Node<DeclarationNode>::Link TokenParser::declaration(bool throwIfEmpty) {
       do {
         skip();
         expect(TT::IDENTIFIER, "Expected identifier in type list");
-        types.insert(current().data);
+        types.insert(currentData().symbol());
         skip();
       } while (accept(","));
       expect(TT::IDENTIFIER);
       return declarationFromTypes(types);
     }
   }
-  throw "Invalid declaration"_syntax + current().trace;
+  throw "Invalid declaration"_syntax + currentTrace();
 }
 
 Node<BranchNode>::Link TokenParser::ifStatement() {
-  auto branch = Node<BranchNode>::make();
-  branch->setTrace(current().trace);
-  auto condition = expression(false);
-  if (condition == nullptr) {
-    throw "If statement requires condition expression"_syntax + branch->getTrace();
-  }
-  branch->condition(condition);
-  branch->success(block(IF_BLOCK));
-  skip(-1); // Go back to the block termination token
-  if (accept(TT::ELSE)) {
+  // Else-if chains are parsed in a loop, because they can be very long
+  Node<BranchNode>::Link first = nullptr;
+  Node<BranchNode>::Link last = nullptr;
+  while (true) {
+    auto branch = Node<BranchNode>::make();
+    branch->setTrace(currentTrace());
+    auto condition = expression(false);
+    if (condition == nullptr) {
+      throw "If statement requires condition expression"_syntax + branch->getTrace();
+    }
+    branch->condition(condition);
+    branch->success(block(IF_BLOCK));
+    if (last == nullptr) {
+      first = branch;
+    } else {
+      last->failiure<BranchNode>(branch);
+    }
+    last = branch;
+    skip(-1); // Go back to the block termination token
+    if (!accept(TT::ELSE)) break;
     skip();
     // Else-if structure
     if (accept(TT::IF)) {
       skip();
-      branch->failiure<BranchNode>(ifStatement());
     // Simple else block
     } else if (accept(TT::DO)) {
       branch->failiure<BlockNode>(block(CODE_BLOCK));
+      break;
     } else {
-      throw "'else' must be followed by a 'do' or 'if'"_syntax + current().trace;
+      throw "'else' must be followed by a 'do' or 'if'"_syntax + currentTrace();
     }
   }
-  return branch;
+  return first;
 }
 
 TypeList TokenParser::getTypeList() {
@@ -286,7 +305,7 @@ TypeList TokenParser::getTypeList() {
   do {
     skip(1); // Skips the comma
     expect(TT::IDENTIFIER, "Expected identifier in type list");
-    types.insert(current().data);
+    types.insert(currentData().symbol());
     skip();
   } while (accept(","));
   return types;
@@ -297,14 +316,14 @@ FunctionSignature::Arguments TokenParser::getSigArgs() {
   while (true) {
     expect(TT::IDENTIFIER, "Expected identifier in function arguments");
     TypeList tl = getTypeList();
-    args.push_back(std::make_pair(current().data, tl));
+    args.push_back(std::make_pair(currentData(), tl));
     skip(); // Skip the argument name
     if (accept(TT::SQPAREN_RIGHT)) {
       skip();
       break;
     }
     if (!accept(",")) {
-      throw "Expected comma after function argument '{}'"_syntax(current().data) + current().trace;
+      throw "Expected comma after function argument '{}'"_syntax(currentData()) + currentTrace();
     }
     skip(); // The comma
   }
@@ -313,14 +332,14 @@ FunctionSignature::Arguments TokenParser::getSigArgs() {
 
 Node<FunctionNode>::Link TokenParser::function(bool isForeign) {
   if (isForeign) skip(); // Skip "foreign"
-  Trace trace = current().trace;
+  Trace trace = currentTrace();
   skip(); // Skip "function" or "method"
   std::string ident = "";
   FunctionSignature::Arguments args {};
   std::unique_ptr<TypeInfo> returnType;
   // Is not anon func
   if (accept(TT::IDENTIFIER)) {
-    ident = current().data;
+    ident = currentData();
     skip();
   }
   if (isForeign && ident.empty()) {
@@ -346,7 +365,7 @@ Node<FunctionNode>::Link TokenParser::function(bool isForeign) {
 }
 
 Node<ConstructorNode>::Link TokenParser::constructor(Visibility vis, bool isForeign) {
-  Trace constrTrace = current().trace;
+  Trace constrTrace = currentTrace();
   skip(); // Skip "constructor"
   FunctionSignature::Arguments args {};
   // Has arguments
@@ -365,7 +384,7 @@ Node<ConstructorNode>::Link TokenParser::constructor(Visibility vis, bool isFore
 }
 
 Node<MethodNode>::Link TokenParser::method(Visibility vis, bool isStatic, bool isForeign) {
-  Trace methTrace = current().trace;
+  Trace methTrace = currentTrace();
   auto parsedAsFunc = function(isForeign);
   auto methNode = Node<MethodNode>::make(parsedAsFunc->getIdentifier(), parsedAsFunc->getSignature(), vis, isStatic);
   methNode->setTrace(methTrace);
@@ -377,12 +396,12 @@ Node<MethodNode>::Link TokenParser::method(Visibility vis, bool isStatic, bool i
   return methNode;
 }
 
-Node<MemberNode>::Link TokenParser::member(Visibility vis, bool isStatic) {
-  Trace mbTrace = current().trace;
+Node<MemberNode>::Link TokenParser::member(Visibility vis, bool isStatic, bool isCold) {
+  Trace mbTrace = currentTrace();
   auto parsedAsDecl = declaration();
-  auto mbNode = Node<MemberNode>::make(parsedAsDecl->getIdentifier(), parsedAsDecl->getTypeInfo().getEvalTypeList(), isStatic, vis == INVALID ? PRIVATE : vis);
+  auto mbNode = Node<MemberNode>::make(parsedAsDecl->getIdentifier(), parsedAsDecl->getTypeInfo().getEvalTypeList(), isStatic, vis == INVALID ? PRIVATE : vis, isCold);
   mbNode->setTrace(mbTrace);
-  if (parsedAsDecl->getChildren().size() > 0)
+  if (parsedAsDecl->hasInit())
     mbNode->init(parsedAsDecl->init());
   return mbNode;
 }
@@ -406,47 +425,58 @@ Node<TypeNode>::Link TokenParser::type() {
   while (!accept(TT::END)) {
     if (accept(TT::FILE_END)) {
       skip(-1); // Go back to get a prettier trace
-      throw "Type '{}' body is not closed by 'end'"_syntax(identTok.data) + current().trace;
+      throw "Type '{}' body is not closed by 'end'"_syntax(identTok.data) + currentTrace();
     }
     bool isStatic = false;
     bool isForeign = false;
+    bool isCold = false;
     Visibility visibility = INVALID;
-    // Expect to see a visibility_specifier or static or foreign
-    while (accept(TT::PUBLIC) || accept(TT::PRIVATE) || accept(TT::PROTECT) || accept(TT::STATIC) || accept(TT::FOREIGN)) {
+    // Expect to see a visibility_specifier or static or foreign or cold
+    while (accept(TT::PUBLIC) || accept(TT::PRIVATE) || accept(TT::PROTECT) || accept(TT::STATIC) || accept(TT::FOREIGN) || accept(TT::COLD)) {
       if (accept(TT::STATIC)) {
         if (isStatic == true) {
-          throw "Cannot specify 'static' more than once"_syntax + current().trace;
+          throw "Cannot specify 'static' more than once"_syntax + currentTrace();
         }
         isStatic = true;
       } else if (accept(TT::FOREIGN)) {
         if (isForeign == true) {
-          throw "Cannot specify 'foreign' more than once"_syntax + current().trace;
+          throw "Cannot specify 'foreign' more than once"_syntax + currentTrace();
         }
         isForeign = true;
+      } else if (accept(TT::COLD)) {
+        if (isCold == true) {
+          throw "Cannot specify 'cold' more than once"_syntax + currentTrace();
+        }
+        isCold = true;
       } else {
         if (visibility != INVALID) {
-          throw "Cannot have more than one visibility specifier"_syntax + current().trace;
+          throw "Cannot have more than one visibility specifier"_syntax + currentTrace();
         }
         visibility = fromToken(current());
       }
       skip();
     }
     // Handle things that go in the body
+    if (isCold && (accept(TT::CONSTR) || accept(TT::METHOD)))
+      throw "Only member fields can be cold"_syntax + currentTrace();
     if (accept(TT::CONSTR)) {
       if (isStatic)
-        throw "Constructors can't be static"_syntax + current().trace;
+        throw "Constructors can't be static"_syntax + currentTrace();
       tn->addChild(constructor(visibility, isForeign));
     } else if (accept(TT::METHOD)) {
       if (visibility == INVALID)
-        throw "Methods require a visibility specifier"_syntax + current().trace;
+        throw "Methods require a visibility specifier"_syntax + currentTrace();
       tn->addChild(method(visibility, isStatic, isForeign));
     } else {
       if (isForeign)
-        throw "Member fields can't be foreign"_syntax + current().trace;
-      tn->addChild(member(visibility, isStatic));
+        throw "Member fields can't be foreign"_syntax + currentTrace();
+      if (isStatic && isCold)
+        throw "Static members can't be cold"_syntax + currentTrace();
+      tn->addChild(member(visibility, isStatic, isCold));
       expectSemi();
     }
   }
+  skip(); // Skip "end"
   return tn;
 }
 
@@ -458,7 +488,7 @@ ASTNode::Link TokenParser::statement() {
     return ifStatement();
   } else if (accept(TT::FOR)) {
     auto loop = Node<LoopNode>::make();
-    loop->setTrace(current().trace);
+    loop->setTrace(currentTrace());
     skip(); // Skip "for"
     // TODO: multiple decls
     loop->addInit(declaration(false));
@@ -495,7 +525,7 @@ ASTNode::Link TokenParser::statement() {
   } if (accept(TT::WHILE)) {
     skip(); // Skip "while"
     auto loop = Node<LoopNode>::make();
-    loop->setTrace(current().trace);
+    loop->setTrace(currentTrace());
     loop->condition(expression());
     loop->code(block(CODE_BLOCK));
     return loop;
@@ -524,7 +554,7 @@ ASTNode::Link TokenParser::statement() {
   } else if (accept(TT::CONTINUE)) {
     throw InternalError("Unimplemented", {METADATA_PAIRS, {"token", "loop continue"}});
   } else if (accept(TT::RETURN)) {
-    auto trace = current().trace;
+    auto trace = currentTrace();
     skip(); // Skip "return"
     auto retValue = expression(false);
     expectSemi();
@@ -549,7 +579,7 @@ Node<BlockNode>::Link TokenParser::block(BlockType type) {
     skip();
   }
   Node<BlockNode>::Link block = Node<BlockNode>::make(type);
-  block->setTrace(current().trace);
+  block->setTrace(currentTrace());
   while (!accept(TT::END)) {
     if (type == IF_BLOCK && accept(TT::ELSE)) break;
     if (type == ROOT_BLOCK && accept(TT::FILE_END)) break;
@@ -11,6 +11,7 @@ XMLParseError::XMLParseError(std::string msg, ErrorData data):
   InternalError("XMLParseError", msg, data) {}
 
 AST XMLParser::parse(char* str) {
+  ASTArena::Scope arena;
   XMLParser xpx = XMLParser();
   rapidxml::xml_document<char> doc;
   try {
@@ -122,6 +123,18 @@ ASTNode::Link XMLParser::parseXMLNode(rapidxml::xml_node<>* node) {
     if (tokenType == TT::OPERATOR) {
       content = std::make_unique<Token>(
         tokenType, Operator::find(data), defaultTrace);
+    } else if (tokenType == TT::INTEGER) {
+      int64_t value;
+      if (!parseInteger(data.data(), data.data() + data.length(), 10, value)) {
+        throw XMLParseError("Invalid integer", {METADATA_PAIRS, {"value", data}});
+      }
+      content = std::make_unique<Token>(data, value, defaultTrace);
+    } else if (tokenType == TT::FLOAT) {
+      double value;
+      if (!parseFloat(data.data(), data.data() + data.length(), value)) {
+        throw XMLParseError("Invalid float", {METADATA_PAIRS, {"value", data}});
+      }
+      content = std::make_unique<Token>(data, value, defaultTrace);
     } else {
       content = std::make_unique<Token>(tokenType, data, defaultTrace);
     }
@@ -203,7 +216,7 @@ ASTNode::Link XMLParser::parseXMLNode(rapidxml::xml_node<>* node) {
     std::string ident = requiredAttr("ident");
     std::vector<std::string> types = split(safeAttr("types"), ' ');
     auto member = Node<MemberNode>::make(
-      ident, TypeList(ALL(types)), boolAttr("static"), getVisibility());
+      ident, TypeList(ALL(types)), boolAttr("static"), getVisibility(), boolAttr("cold"));
     auto init = node->first_node("expr");
     if (init != nullptr) {
       member->init(Node<ExpressionNode>::staticPtrCast(parseXMLNode(init)));
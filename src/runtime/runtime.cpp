@@ -1,35 +1,32 @@
 #include "runtime/runtime.hpp"
 
-void _xyl_finish(const char* message, int exitCode) {
-  println(message);
-  std::exit(exitCode);
-}
+namespace {
+  const _xyl_TypeInfo* typeTable = nullptr;
+  uint64_t typeCount = 0;
 
-void _xyl_typeErrIfIncompatible(_xyl_Value* val, _xyl_Value* newVal) {
-  bool compat = _xyl_checkTypeCompat(val, newVal);
-  if (!compat) {
-    std::stringstream err;
-    err << "TypeError: Incompatible types";
-    err << " \"" << _xyl_typeOf(val) << "\" and \"" << _xyl_typeOf(newVal) << "\"";
-    _xyl_finish(err.str().c_str(), -1);
+  const char* typeName(uint32_t index) {
+    if (index >= typeCount || typeTable[index].name == nullptr) return "<unknown type>";
+    return typeTable[index].name;
   }
 }
 
-void _xyl_typeErrIfIncompatibleTid(UniqueIdentifier allowed, _xyl_Value* newVal) {
-  // TODO
-  UNUSED(allowed);
-  UNUSED(newVal);
-  return;
+void _xyl_registerTypes(const _xyl_TypeInfo* types, uint64_t count) {
+  typeTable = types;
+  typeCount = count;
+}
+
+void _xyl_finish(const char* message, int exitCode) {
+  println(message);
+  std::exit(exitCode);
 }
 
-bool _xyl_checkTypeCompat(_xyl_Value* val, _xyl_Value* newVal) {
-  // TODO
-  UNUSED(val);
-  UNUSED(newVal);
-  return true;
+void _xyl_typeErr(const char* allowed, uint32_t actualType) {
+  std::stringstream err;
+  err << "TypeError: Incompatible types";
+  err << " \"" << allowed << "\" and \"" << typeName(actualType) << "\"";
+  _xyl_finish(err.str().c_str(), -1);
 }
 
 const char* _xyl_typeOf(_xyl_Value* val) {
-  // TODO
-  return std::to_string(val->currentType).c_str();
+  return typeName(val->currentType);
 }
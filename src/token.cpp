@@ -8,12 +8,81 @@ TokenType TT::findConstruct(char c) noexcept {
   else return *it;
 }
 
-TokenType TT::findKeyword(std::string s) noexcept {
-  auto it = std::find_if(ALL(TT::keywords), [=](Keyword t) {
-    return s == t.getKeyword();
-  });
-  if (it == std::end(TT::keywords)) return TT::UNPROCESSED;
-  else return *it;
+namespace {
+  constexpr std::size_t keywordTableSize = 128;
+  
+  /**
+    \brief Find the slot of a keyword in keywordTable.
+    
+    The constants were picked so that every keyword gets a different slot.
+  */
+  constexpr std::size_t keywordHash(const char* str, std::size_t length) noexcept {
+    return (
+      static_cast<unsigned char>(str[0]) * 34u +
+      static_cast<unsigned char>(str[length - 1]) * 11u +
+      length
+    ) % keywordTableSize;
+  }
+  
+  constexpr std::size_t constexprLength(const char* str) noexcept {
+    std::size_t length = 0;
+    while (str[length] != '\0') length++;
+    return length;
+  }
+  
+  /// Perfect hash table of TT::keywords
+  struct KeywordTable {
+    /// Index in TT::keywords, or -1 if the slot is empty
+    int slots[keywordTableSize];
+    bool hasCollisions;
+  };
+  
+  constexpr KeywordTable makeKeywordTable() noexcept {
+    KeywordTable table {{}, false};
+    for (std::size_t slot = 0; slot < keywordTableSize; slot++) table.slots[slot] = -1;
+    for (std::size_t idx = 0; idx < TT::keywords.size(); idx++) {
+      const char* keyword = TT::keywords[idx].getPrettyName();
+      auto slot = keywordHash(keyword, constexprLength(keyword));
+      if (table.slots[slot] != -1) table.hasCollisions = true;
+      table.slots[slot] = static_cast<int>(idx);
+    }
+    return table;
+  }
+  
+  constexpr KeywordTable keywordTable = makeKeywordTable();
+  static_assert(!keywordTable.hasCollisions, "Keywords must have unique keywordHash slots");
+}
+
+TokenType TT::findKeyword(const TokenText& s) noexcept {
+  if (s.empty()) return TT::UNPROCESSED;
+  int idx = keywordTable.slots[keywordHash(s.begin(), s.length())];
+  if (idx == -1) return TT::UNPROCESSED;
+  auto keyword = TT::keywords[static_cast<std::size_t>(idx)];
+  if (s != keyword.getPrettyName()) return TT::UNPROCESSED;
+  return keyword;
+}
+
+namespace {
+  /// Largest index of a TokenType
+  constexpr std::size_t maxTokenTypeIndex = 999;
+  
+  struct TagTable {
+    TT::Tag tags[maxTokenTypeIndex + 1];
+  };
+  
+  constexpr TagTable makeTagTable() noexcept {
+    TagTable table {{}};
+    for (std::size_t tag = 0; tag < TT::all.size(); tag++) {
+      table.tags[static_cast<int>(TT::all[tag])] = static_cast<TT::Tag>(tag);
+    }
+    return table;
+  }
+  
+  constexpr TagTable tagTable = makeTagTable();
+}
+
+TT::Tag TT::toTag(TokenType type) noexcept {
+  return tagTable.tags[static_cast<int>(type)];
 }
 
 TokenType TT::findByPrettyName(std::string prettyName) {
@@ -38,6 +107,6 @@ Operator Token::op() const {
 std::string Token::toString() const noexcept {
   std::string tokData = isOp() ?
     "operator " + op().getName() :
-    "data \"" + data + "\"";
+    "data \"" + data.str() + "\"";
   return fmt::format("Token {0}, {1}, {2}", type, tokData, trace);
 }
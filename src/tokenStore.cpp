@@ -0,0 +1,199 @@
+#include "tokenStore.hpp"
+
+#include <cstring>
+
+TokenStore::TokenStore(const char* code, FileId file, bool viewText) noexcept:
+  code(code), file(file), viewText(viewText) {}
+
+TokenStore TokenStore::fromTokens(const std::vector<Token>& tokens) {
+  TokenStore store(nullptr, tokens.empty() ? Trace::noFile : tokens[0].trace.getFile(), false);
+  store.reserve(tokens.size());
+  std::vector<std::size_t> openParens;
+  for (const auto& tok : tokens) {
+    if (tok.type == TT::PAREN_RIGHT || tok.type == TT::CALL_END || tok.type == TT::SQPAREN_RIGHT) {
+      if (!openParens.empty()) {
+        store.setMatchingParen(openParens.back(), store.size());
+        openParens.pop_back();
+      }
+    } else if (tok.type == TT::PAREN_LEFT || tok.type == TT::CALL_BEGIN || tok.type == TT::SQPAREN_LEFT) {
+      openParens.push_back(store.size());
+    }
+    store.push(tok);
+  }
+  return store;
+}
+
+void TokenStore::reserve(std::size_t tokenCount) {
+  types.reserve(tokenCount);
+  aux.reserve(tokenCount);
+  offsets.reserve(tokenCount);
+  lengths.reserve(tokenCount);
+}
+
+TokenText TokenStore::text(std::size_t at) const {
+  if (isOp(at)) return TokenText();
+  // Parens are always the same, and stores made from other tokens don't have their source
+  if (auxKind(at) == AuxKind::PAREN_BEGIN) {
+    return TokenText::view(type(at) == TT::SQPAREN_LEFT ? "[" : "(", 1);
+  }
+  TokenText text;
+  uint32_t literal = literalIndex(at);
+  if (literal == sourceText) {
+    // The traces of strings start with the opening quote, and end before the closing one
+    uint32_t quote = type(at) == TT::STRING ? 1 : 0;
+    text = TokenText::view(code + offsets[at] + quote, lengths[at] - quote);
+  } else {
+    uint32_t start = literalStarts[literal];
+    text = TokenText::view(literalPool.data() + start, literalStarts[literal + 1] - start);
+  }
+  if (!viewText) text.detach();
+  return text;
+}
+
+int64_t TokenStore::intValue(std::size_t at) const noexcept {
+  int64_t value;
+  std::memcpy(&value, &numbers[aux[at]].bits, sizeof value);
+  return value;
+}
+
+double TokenStore::floatValue(std::size_t at) const noexcept {
+  double value;
+  std::memcpy(&value, &numbers[aux[at]].bits, sizeof value);
+  return value;
+}
+
+Token TokenStore::operator[](std::size_t at) const {
+  if (isOp(at)) return Token(TT::OPERATOR, opIndex(at), trace(at));
+  if (type(at) == TT::INTEGER) return Token(text(at), intValue(at), trace(at));
+  if (type(at) == TT::FLOAT) return Token(text(at), floatValue(at), trace(at));
+  return Token(type(at), text(at), trace(at));
+}
+
+std::vector<Token> TokenStore::toTokens() const {
+  std::vector<Token> tokens;
+  tokens.reserve(size());
+  for (std::size_t i = 0; i < size(); i++) tokens.push_back((*this)[i]);
+  return tokens;
+}
+
+void TokenStore::pushFields(TokenType type, uint32_t auxValue, Trace trace) {
+  types.push_back(TT::toTag(type));
+  aux.push_back(auxValue);
+  offsets.push_back(trace.getOffset());
+  lengths.push_back(trace.getLength());
+}
+
+void TokenStore::push(TokenType type, Trace trace) {
+  pushFields(type, sourceText, trace);
+}
+
+uint32_t TokenStore::pushLiteral(const TokenText& text) {
+  auto literal = static_cast<uint32_t>(literalStarts.size() - 1);
+  literalPool.append(text.begin(), text.length());
+  literalStarts.push_back(static_cast<uint32_t>(literalPool.length()));
+  return literal;
+}
+
+void TokenStore::push(TokenType type, Trace trace, const TokenText& text) {
+  pushFields(type, pushLiteral(text), trace);
+}
+
+void TokenStore::pushNumber(TokenType type, Trace trace, uint64_t bits, uint32_t literal) {
+  pushFields(type, static_cast<uint32_t>(numbers.size()), trace);
+  numbers.push_back({bits, literal});
+}
+
+void TokenStore::pushInteger(Trace trace, int64_t value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof bits);
+  pushNumber(TT::INTEGER, trace, bits, sourceText);
+}
+
+void TokenStore::pushFloat(Trace trace, double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof bits);
+  pushNumber(TT::FLOAT, trace, bits, sourceText);
+}
+
+void TokenStore::pushOperator(Operator::Index idx, Trace trace) {
+  pushFields(TT::OPERATOR, static_cast<uint32_t>(idx), trace);
+}
+
+void TokenStore::push(const Token& tok) {
+  if (tok.isOp()) {
+    pushOperator(tok.idx, tok.trace);
+  } else if (tok.type == TT::INTEGER || tok.type == TT::FLOAT) {
+    uint64_t bits;
+    std::memcpy(&bits, &tok.intValue, sizeof bits);
+    pushNumber(tok.type, tok.trace, bits, pushLiteral(tok.data));
+  } else if (tok.type == TT::PAREN_LEFT || tok.type == TT::CALL_BEGIN || tok.type == TT::SQPAREN_LEFT) {
+    pushFields(tok.type, unmatched, tok.trace);
+  } else {
+    push(tok.type, tok.trace, tok.data);
+  }
+}
+
+void TokenStore::append(const TokenStore& other) {
+  auto literalBase = static_cast<uint32_t>(literalStarts.size() - 1);
+  auto poolBase = static_cast<uint32_t>(literalPool.length());
+  auto numberBase = static_cast<uint32_t>(numbers.size());
+  auto tokenBase = static_cast<uint32_t>(size());
+  types.insert(types.end(), ALL(other.types));
+  offsets.insert(offsets.end(), ALL(other.offsets));
+  lengths.insert(lengths.end(), ALL(other.lengths));
+  aux.reserve(aux.size() + other.aux.size());
+  for (std::size_t i = 0; i < other.size(); i++) {
+    uint32_t value = other.aux[i];
+    switch (other.auxKind(i)) {
+      case AuxKind::OPERATOR: break;
+      case AuxKind::NUMBER: value += numberBase; break;
+      case AuxKind::PAREN_BEGIN: if (value != unmatched) value += tokenBase; break;
+      case AuxKind::TEXT: if (value != sourceText) value += literalBase; break;
+    }
+    aux.push_back(value);
+  }
+  numbers.reserve(numbers.size() + other.numbers.size());
+  for (auto number : other.numbers) {
+    if (number.literal != sourceText) number.literal += literalBase;
+    numbers.push_back(number);
+  }
+  literalPool += other.literalPool;
+  literalStarts.reserve(literalStarts.size() + other.literalStarts.size() - 1);
+  for (std::size_t i = 1; i < other.literalStarts.size(); i++) {
+    literalStarts.push_back(other.literalStarts[i] + poolBase);
+  }
+}
+
+void TokenStore::discardBefore(std::size_t count) {
+  // Literals are added in the same order as their tokens, so the discarded ones come first
+  uint32_t literalCount = 0;
+  uint32_t numberCount = 0;
+  for (std::size_t i = 0; i < count; i++) {
+    if (auxKind(i) == AuxKind::NUMBER) numberCount++;
+    if (!isOp(i) && literalIndex(i) != sourceText) literalCount++;
+  }
+  auto discard = [=](auto& vec) {
+    vec.erase(vec.begin(), vec.begin() + static_cast<std::ptrdiff_t>(count));
+  };
+  discard(types);
+  discard(aux);
+  discard(offsets);
+  discard(lengths);
+  for (std::size_t i = 0; i < size(); i++) {
+    switch (auxKind(i)) {
+      case AuxKind::OPERATOR: break;
+      case AuxKind::NUMBER: aux[i] -= numberCount; break;
+      // Parens are closed after they are opened, so the closing paren is still here
+      case AuxKind::PAREN_BEGIN: if (aux[i] != unmatched) aux[i] -= static_cast<uint32_t>(count); break;
+      case AuxKind::TEXT: if (aux[i] != sourceText) aux[i] -= literalCount; break;
+    }
+  }
+  numbers.erase(numbers.begin(), numbers.begin() + numberCount);
+  for (auto& number : numbers) {
+    if (number.literal != sourceText) number.literal -= literalCount;
+  }
+  uint32_t poolStart = literalStarts[literalCount];
+  literalPool.erase(0, poolStart);
+  literalStarts.erase(literalStarts.begin(), literalStarts.begin() + literalCount);
+  for (auto& start : literalStarts) start -= poolStart;
+}
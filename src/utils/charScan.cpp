@@ -0,0 +1,168 @@
+#include "utils/charScan.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+  #define XYLENE_SIMD_X86 1
+  #include <immintrin.h>
+  #ifdef _MSC_VER
+    #include <intrin.h>
+  #endif
+#else
+  #define XYLENE_SIMD_X86 0
+#endif
+
+namespace {
+  inline unsigned countTrailingZeros(uint32_t mask) noexcept {
+  #ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return static_cast<unsigned>(idx);
+  #else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+  #endif
+  }
+
+  bool cpuHasAVX2() noexcept {
+  #if !XYLENE_SIMD_X86
+    return false;
+  #elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    // The OS must save the AVX registers too
+    bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && (info[1] & (1 << 5)) != 0;
+  #else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+  #endif
+  }
+}
+
+CharSet::CharSet(const std::string& characters) noexcept {
+  for (char c : characters) {
+    if (contains(c)) continue;
+    members[static_cast<unsigned char>(c)] = true;
+    chars += c;
+  }
+  // Give a bit to each distinct high nibble
+  std::array<uint8_t, 16> highNibbleBits {};
+  unsigned usedBits = 0;
+  for (char c : chars) {
+    auto byte = static_cast<unsigned char>(c);
+    auto high = byte >> 4;
+    if (highNibbleBits[high] == 0) {
+      if (usedBits == 8) return;
+      highNibbleBits[high] = static_cast<uint8_t>(1 << usedBits++);
+    }
+    lowNibbleMasks[byte & 0xF] |= highNibbleBits[high];
+  }
+  highNibbleMasks = highNibbleBits;
+  canUseNibbleTables = true;
+}
+
+CharSet::Implementation& CharSet::selectedImplementation() noexcept {
+  static Implementation impl =
+    isSupported(AVX2) ? AVX2 :
+    isSupported(SSE2) ? SSE2 : SCALAR;
+  return impl;
+}
+
+bool CharSet::isSupported(Implementation impl) noexcept {
+  switch (impl) {
+    case SCALAR: return true;
+    // Every x86-64 CPU has SSE2
+    case SSE2: return XYLENE_SIMD_X86;
+    case AVX2: return cpuHasAVX2();
+  }
+  return false;
+}
+
+CharSet::Implementation CharSet::getImplementation() noexcept {
+  return selectedImplementation();
+}
+
+void CharSet::setImplementation(Implementation impl) noexcept {
+  selectedImplementation() = impl;
+}
+
+const char* CharSet::find(const char* begin, const char* end, bool wanted) const noexcept {
+  switch (selectedImplementation()) {
+    case AVX2: return findAVX2(begin, end, wanted);
+    case SSE2: return findSSE2(begin, end, wanted);
+    case SCALAR: return findScalar(begin, end, wanted);
+  }
+  return findScalar(begin, end, wanted);
+}
+
+const char* CharSet::findScalar(const char* begin, const char* end, bool wanted) const noexcept {
+  for (auto it = begin; it != end; ++it) {
+    if (contains(*it) == wanted) return it;
+  }
+  return end;
+}
+
+#if XYLENE_SIMD_X86
+
+const char* CharSet::findSSE2(const char* begin, const char* end, bool wanted) const noexcept {
+  auto it = begin;
+  for (; end - it >= 16; it += 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+    __m128i isMember = _mm_setzero_si128();
+    for (char c : chars) {
+      isMember = _mm_or_si128(isMember, _mm_cmpeq_epi8(block, _mm_set1_epi8(c)));
+    }
+    auto mask = static_cast<uint32_t>(_mm_movemask_epi8(isMember));
+    if (!wanted) mask = ~mask & 0xFFFF;
+    if (mask != 0) return it + countTrailingZeros(mask);
+  }
+  return findScalar(it, end, wanted);
+}
+
+__attribute__((target("avx2")))
+const char* CharSet::findAVX2(const char* begin, const char* end, bool wanted) const noexcept {
+  auto it = begin;
+  if (canUseNibbleTables) {
+    const __m256i lowTable = _mm256_broadcastsi128_si256(
+      _mm_load_si128(reinterpret_cast<const __m128i*>(lowNibbleMasks.data())));
+    const __m256i highTable = _mm256_broadcastsi128_si256(
+      _mm_load_si128(reinterpret_cast<const __m128i*>(highNibbleMasks.data())));
+    const __m256i lowNibble = _mm256_set1_epi8(0xF);
+    for (; end - it >= 32; it += 32) {
+      __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(it));
+      __m256i low = _mm256_shuffle_epi8(lowTable, _mm256_and_si256(block, lowNibble));
+      __m256i high = _mm256_shuffle_epi8(
+        highTable, _mm256_and_si256(_mm256_srli_epi16(block, 4), lowNibble));
+      __m256i isNotMember = _mm256_cmpeq_epi8(
+        _mm256_and_si256(low, high), _mm256_setzero_si256());
+      auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(isNotMember));
+      if (wanted) mask = ~mask;
+      if (mask != 0) return it + countTrailingZeros(mask);
+    }
+  } else {
+    for (; end - it >= 32; it += 32) {
+      __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(it));
+      __m256i isMember = _mm256_setzero_si256();
+      for (char c : chars) {
+        isMember = _mm256_or_si256(isMember, _mm256_cmpeq_epi8(block, _mm256_set1_epi8(c)));
+      }
+      auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(isMember));
+      if (!wanted) mask = ~mask;
+      if (mask != 0) return it + countTrailingZeros(mask);
+    }
+  }
+  return findSSE2(it, end, wanted);
+}
+
+#else
+
+const char* CharSet::findSSE2(const char* begin, const char* end, bool wanted) const noexcept {
+  return findScalar(begin, end, wanted);
+}
+
+const char* CharSet::findAVX2(const char* begin, const char* end, bool wanted) const noexcept {
+  return findScalar(begin, end, wanted);
+}
+
+#endif
@@ -0,0 +1,54 @@
+#include "utils/mappedFile.hpp"
+
+#ifdef _MSC_VER
+
+#include <fstream>
+
+MappedFile::MappedFile(fs::path path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) throw "Cannot open file '{}'"_ref(path.string());
+  buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  contents = buffer.data();
+  length = buffer.size();
+}
+
+MappedFile::~MappedFile() {}
+
+#else
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+MappedFile::MappedFile(fs::path path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) throw "Cannot open file '{0}': {1}"_ref(path.string(), std::strerror(errno));
+  struct stat info;
+  if (fstat(fd, &info) == -1) {
+    close(fd);
+    throw "Cannot stat file '{0}': {1}"_ref(path.string(), std::strerror(errno));
+  }
+  length = static_cast<std::size_t>(info.st_size);
+  // Zero-length mappings are invalid, and an empty file needs no memory anyway
+  if (length > 0) {
+    void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      close(fd);
+      throw "Cannot map file '{0}': {1}"_ref(path.string(), std::strerror(errno));
+    }
+    // The lexer reads the file once, front to back
+    madvise(mapping, length, MADV_SEQUENTIAL);
+    contents = static_cast<const char*>(mapping);
+  }
+  // The mapping stays valid after the descriptor is closed
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (contents != nullptr) munmap(const_cast<char*>(contents), length);
+}
+
+#endif
@@ -0,0 +1,69 @@
+#include "utils/numbers.hpp"
+
+#include <cstdlib>
+#include <limits>
+
+namespace {
+  /// Value of a digit in radixes up to 16, or 16 if it isn't a digit
+  unsigned digitValue(char c) noexcept {
+    if (c >= '0' && c <= '9') return static_cast<unsigned>(c - '0');
+    if (c >= 'a' && c <= 'f') return static_cast<unsigned>(c - 'a' + 10);
+    if (c >= 'A' && c <= 'F') return static_cast<unsigned>(c - 'A' + 10);
+    return 16;
+  }
+
+  /// Powers of 10 that can be represented exactly as doubles
+  constexpr double exactPowersOf10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  constexpr int maxExactPowerOf10 = 22;
+  /// Integers up to this can be represented exactly as doubles
+  constexpr uint64_t maxExactMantissa = static_cast<uint64_t>(1) << 53;
+}
+
+bool parseInteger(const char* begin, const char* end, unsigned radix, int64_t& value) noexcept {
+  if (begin == end) return false;
+  constexpr auto max = static_cast<uint64_t>(std::numeric_limits<int64_t>::max());
+  uint64_t result = 0;
+  for (auto it = begin; it != end; ++it) {
+    unsigned digit = digitValue(*it);
+    if (digit >= radix) return false;
+    if (result > (max - digit) / radix) return false;
+    result = result * radix + digit;
+  }
+  value = static_cast<int64_t>(result);
+  return true;
+}
+
+bool parseFloat(const char* begin, const char* end, double& value) {
+  if (begin == end) return false;
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  bool seenPoint = false;
+  bool isExact = true;
+  for (auto it = begin; it != end; ++it) {
+    if (*it == '.') {
+      if (seenPoint) return false;
+      seenPoint = true;
+      continue;
+    }
+    if (*it < '0' || *it > '9') return false;
+    auto digit = static_cast<unsigned>(*it - '0');
+    if (mantissa > (maxExactMantissa - digit) / 10) {
+      isExact = false;
+      continue;
+    }
+    mantissa = mantissa * 10 + digit;
+    if (seenPoint) exponent--;
+  }
+  if (isExact && -exponent <= maxExactPowerOf10) {
+    // Both the mantissa and the power of 10 are exact, and IEEE division rounds correctly
+    value = static_cast<double>(mantissa) / exactPowersOf10[-exponent];
+    return true;
+  }
+  // std::strtod needs a terminator
+  std::string number(begin, end);
+  value = std::strtod(number.c_str(), nullptr);
+  return true;
+}
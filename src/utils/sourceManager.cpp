@@ -0,0 +1,72 @@
+#include "utils/sourceManager.hpp"
+
+#include <cstring>
+#include <limits>
+
+#include "utils/error.hpp"
+
+constexpr FileId Trace::nullFile;
+constexpr FileId Trace::noFile;
+
+SourceManager::SourceManager() {
+  // These don't have any lines, so all their positions are 0:0
+  files.push_back(File {"", {}});
+  files.push_back(File {"<none>", {}});
+}
+
+SourceManager& SourceManager::get() noexcept {
+  static SourceManager instance;
+  return instance;
+}
+
+FileId SourceManager::addFile(std::string name, const char* contents, std::size_t length) {
+  if (length > std::numeric_limits<uint32_t>::max()) {
+    throw "File '{}' is too large"_ref(name);
+  }
+  File file {name, {0}};
+  const char* end = contents + length;
+  for (const char* it = contents; it != end; ++it) {
+    it = static_cast<const char*>(std::memchr(it, '\n', static_cast<std::size_t>(end - it)));
+    if (it == nullptr) break;
+    file.lineStarts.push_back(static_cast<uint32_t>(it - contents + 1));
+  }
+  std::lock_guard<std::mutex> lock(filesMutex);
+  files.push_back(std::move(file));
+  return static_cast<FileId>(files.size() - 1);
+}
+
+std::string SourceManager::getFileName(FileId file) const {
+  std::lock_guard<std::mutex> lock(filesMutex);
+  return files.at(file).name;
+}
+
+uint64_t SourceManager::getLineCount(FileId file) const {
+  std::lock_guard<std::mutex> lock(filesMutex);
+  return files.at(file).lineStarts.size();
+}
+
+Position SourceManager::getPosition(FileId file, uint32_t offset) const {
+  std::lock_guard<std::mutex> lock(filesMutex);
+  const auto& lineStarts = files.at(file).lineStarts;
+  if (lineStarts.empty()) return Position(0, 0);
+  // Find the last line that starts before the offset
+  auto line = std::upper_bound(ALL(lineStarts), offset) - 1;
+  return Position(
+    static_cast<uint64_t>(line - lineStarts.begin() + 1),
+    offset - *line
+  );
+}
+
+Range Trace::getRange() const noexcept {
+  auto& sm = SourceManager::get();
+  return Range(sm.getPosition(file, offset), sm.getPosition(file, offset + length));
+}
+
+std::string Trace::getFileName() const noexcept {
+  return SourceManager::get().getFileName(file);
+}
+
+std::string Trace::toString() const noexcept {
+  if (file == nullFile) return "";
+  else return fmt::format("found {0} in {1}", getRange(), getFileName());
+}
@@ -0,0 +1,46 @@
+#include "utils/symbol.hpp"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+  /// The names of all the symbols, looked up by text or by id
+  class SymbolTable {
+  private:
+    std::mutex lock;
+    std::unordered_map<std::string, Symbol::Id> ids {{"", 0}};
+    /// The keys of ids, which don't move when it grows
+    std::vector<const std::string*> names {&ids.begin()->first};
+  public:
+    Symbol::Id intern(const char* text, std::size_t length) {
+      // Most names were already interned, so looking them up shouldn't allocate
+      thread_local std::string key;
+      key.assign(text, length);
+      std::lock_guard<std::mutex> guard(lock);
+      auto it = ids.find(key);
+      if (it != ids.end()) return it->second;
+      auto id = static_cast<Symbol::Id>(names.size());
+      auto inserted = ids.insert({key, id});
+      names.push_back(&inserted.first->first);
+      return id;
+    }
+
+    const std::string& name(Symbol::Id id) {
+      std::lock_guard<std::mutex> guard(lock);
+      return *names[id];
+    }
+  };
+
+  SymbolTable& table() {
+    static SymbolTable symbols;
+    return symbols;
+  }
+}
+
+Symbol::Id Symbol::intern(const char* text, std::size_t length) {
+  return table().intern(text, length);
+}
+
+const std::string& Symbol::str() const {
+  return table().name(id);
+}
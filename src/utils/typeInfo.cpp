@@ -22,7 +22,7 @@ StaticTypeInfo::StaticTypeInfo(std::string type): DefiniteTypeInfo({type}) {}
 StaticTypeInfo::StaticTypeInfo(const char* type): StaticTypeInfo(std::string(type)) {}
 
 std::string StaticTypeInfo::toString() const noexcept {
-  return "StaticTypeInfo: " + *std::begin(evalValue);
+  return "StaticTypeInfo: " + std::begin(evalValue)->str();
 }
 
 DefiniteTypeInfo::DefiniteTypeInfo(TypeList evalValue): TypeInfo(evalValue) {}
@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <sys/resource.h>
 
 #include "test.hpp"
 #include "llvm/runner.hpp"
@@ -12,3 +13,43 @@ TEST_F(E2ETest, PrintAlphabet) {
     ProgramResult({0, "abcdefghijklmnopqrstuvwxyz", ""})
   );
 }
+
+TEST_F(E2ETest, UnionReassignmentMemory) {
+  if (!spawnProcs) return;
+  EXPECT_EQ(
+    compileAndRun("data/end-to-end/union_reassignment.xylene"),
+    ProgramResult({0, "A", ""})
+  );
+  // Putting 10M pairs on the heap would take hundreds of megabytes
+  rusage usage;
+  ASSERT_EQ(getrusage(RUSAGE_CHILDREN, &usage), 0);
+  EXPECT_LT(usage.ru_maxrss, 200 * 1024); // In kilobytes
+}
+
+TEST_F(E2ETest, VirtualDispatch) {
+  if (spawnProcs) EXPECT_EQ(
+    compileAndRun("data/end-to-end/virtual_dispatch.xylene"),
+    ProgramResult({0, "AB", ""})
+  );
+}
+
+TEST_F(E2ETest, ColdMemberCopies) {
+  if (spawnProcs) EXPECT_EQ(
+    compileAndRun("data/end-to-end/cold_members.xylene"),
+    ProgramResult({0, "BCCEBBB", ""})
+  );
+}
+
+TEST_F(E2ETest, ColdMemberReturns) {
+  if (spawnProcs) EXPECT_EQ(
+    compileAndRun("data/end-to-end/cold_member_returns.xylene"),
+    ProgramResult({0, "CDEF", ""})
+  );
+}
+
+TEST_F(E2ETest, ColdMemberNesting) {
+  if (spawnProcs) EXPECT_EQ(
+    compileAndRun("data/end-to-end/cold_member_nesting.xylene"),
+    ProgramResult({0, "CBCBDEG", ""})
+  );
+}
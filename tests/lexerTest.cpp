@@ -42,9 +42,14 @@ TEST_F(LexerTest, CommentsMultiLine) {
 
 TEST_F(LexerTest, IntegerLiterals) {
   ASSERT_EQ(getTokens("123")[0], Token(TT::INTEGER, "123", defaultTrace));
-  ASSERT_EQ(getTokens("0xA")[0], Token(TT::INTEGER, "10", defaultTrace));
-  ASSERT_EQ(getTokens("0o10")[0], Token(TT::INTEGER, "8", defaultTrace));
-  ASSERT_EQ(getTokens("0b10")[0], Token(TT::INTEGER, "2", defaultTrace));
+  ASSERT_EQ(getTokens("123")[0].intValue, 123);
+  ASSERT_EQ(getTokens("0xA")[0], Token(TT::INTEGER, "0xA", defaultTrace));
+  ASSERT_EQ(getTokens("0xA")[0].intValue, 10);
+  ASSERT_EQ(getTokens("0o10")[0].intValue, 8);
+  ASSERT_EQ(getTokens("0b10")[0].intValue, 2);
+  ASSERT_EQ(getTokens("9223372036854775807")[0].intValue, INT64_MAX);
+  ASSERT_THROW(getTokens("9223372036854775808"), Error);
+  ASSERT_THROW(getTokens("0b102"), Error);
   ASSERT_THROW(getTokens("123abc"), Error);
   ASSERT_NO_THROW(getTokens("123+1"));
 }
@@ -58,6 +63,7 @@ TEST_F(LexerTest, Radix) {
 
 TEST_F(LexerTest, FloatLiterals) {
   ASSERT_EQ(getTokens("12.3")[0], Token(TT::FLOAT, "12.3", defaultTrace));
+  ASSERT_EQ(getTokens("12.3")[0].floatValue, 12.3);
   ASSERT_THROW(getTokens("12.")[0], Error);
   ASSERT_THROW(getTokens("12.123.")[0], Error);
   ASSERT_THROW(getTokens("0x12.123")[0], Error);
@@ -103,12 +109,23 @@ TEST_F(LexerTest, Operators) {
   ASSERT_EQ(at(2), Token(TT::OPERATOR, Operator::find("Add"), defaultTrace));
   EXPECT_EQ(getTokens("1++ + ++2")[3], Token(TT::OPERATOR, Operator::find("Prefix ++"), defaultTrace));
   ASSERT_EQ(at(2), Token(TT::OPERATOR, Operator::find("Add"), defaultTrace));
+  EXPECT_EQ(getTokens("a<<=b")[1], Token(TT::OPERATOR, Operator::find("<<Assignment"), defaultTrace));
+  EXPECT_EQ(getTokens("a<<b")[1], Token(TT::OPERATOR, Operator::find("Bitshift <<"), defaultTrace));
+  EXPECT_EQ(getTokens("a<b")[1], Token(TT::OPERATOR, Operator::find("Less"), defaultTrace));
+  EXPECT_EQ(getTokens("a..b")[1], Token(TT::OPERATOR, Operator::find("Range"), defaultTrace));
+  EXPECT_EQ(getTokens("a--")[1], Token(TT::OPERATOR, Operator::find("Postfix --"), defaultTrace));
+  EXPECT_EQ(getTokens("a-=b")[1], Token(TT::OPERATOR, Operator::find("-Assignment"), defaultTrace));
 }
 
 TEST_F(LexerTest, Keywords) {
   ASSERT_EQ(getTokens("define")[0], Token(TT::DEFINE, "define", defaultTrace));
   ASSERT_EQ(getTokens("function")[0], Token(TT::FUNCTION, "function", defaultTrace));
   ASSERT_EQ(getTokens("protected")[0], Token(TT::PROTECT, "protected", defaultTrace));
+  for (auto keyword : TT::keywords) {
+    EXPECT_EQ(getTokens(keyword.getKeyword())[0], Token(keyword, keyword.getKeyword(), defaultTrace));
+  }
+  EXPECT_EQ(getTokens("definex")[0], Token(TT::IDENTIFIER, "definex", defaultTrace));
+  EXPECT_EQ(getTokens("d")[0], Token(TT::IDENTIFIER, "d", defaultTrace));
 }
 
 TEST_F(LexerTest, Expression) {
@@ -121,3 +138,97 @@ TEST_F(LexerTest, Expression) {
   ASSERT_EQ(at(8), Token(TT::FLOAT, "1.5", defaultTrace));
   ASSERT_EQ(at(10), Token(TT::INTEGER, "1", defaultTrace));
 }
+
+TEST_F(LexerTest, MappedFile) {
+  fs::path file = fs::path(DATA_PARENT_DIR) / "data/end-to-end/alphabet.xylene";
+  auto mapped = Lexer::tokenizeFile(file);
+  auto tokens = mapped->getTokens();
+  ASSERT_EQ(tokens, getTokens(mapped->getCode()));
+  for (auto tok : tokens) {
+    if (tok.isTerminal()) {
+      ASSERT_TRUE(tok.data.isView());
+    }
+  }
+  ASSERT_THROW(Lexer::tokenizeFile(fs::path(DATA_PARENT_DIR) / "data/missing.xyl"), Error);
+}
+
+TEST_F(LexerTest, Traces) {
+  getTokens("a\n  bc // x\nd");
+  ASSERT_EQ(at(1).trace.getRange().getStart().line, 2);
+  ASSERT_EQ(at(1).trace.getRange().getStart().col, 2);
+  ASSERT_EQ(at(1).trace.getRange().getEnd().col, 4);
+  ASSERT_EQ(at(2).trace.getRange().getStart().line, 3);
+  ASSERT_EQ(at(2).trace.getFileName(), "<lexer-test>");
+  ASSERT_EQ(sizeof(Trace), 3 * sizeof(uint32_t));
+}
+
+TEST_F(LexerTest, TokenStore) {
+  auto tokens = getTokens("f(0x10, \"a\\tb\", \"c\") + a++ - 1.5; if true do end");
+  const auto& store = lx->getTokenStore();
+  ASSERT_EQ(store.size(), tokens.size());
+  ASSERT_EQ(store.text(2), "0x10");
+  ASSERT_EQ(store.intValue(2), 16);
+  ASSERT_EQ(store.text(4), "a\tb");
+  ASSERT_EQ(store.text(6), "c");
+  ASSERT_EQ(store.type(7), TT::CALL_END);
+  ASSERT_TRUE(store.isOp(8));
+  ASSERT_EQ(store.opIndex(8), tokens[8].idx);
+  auto copy = TokenStore::fromTokens(tokens);
+  ASSERT_EQ(copy.toTokens(), tokens);
+  ASSERT_EQ(copy.intValue(2), 16);
+  ASSERT_EQ(copy.floatValue(12), 1.5);
+  ASSERT_EQ(store.matchingParen(1), 7u);
+  ASSERT_EQ(copy.matchingParen(1), 7u);
+  auto group = TokenCursor(store).range(2, 7);
+  group.skip(4);
+  ASSERT_EQ(group.text(), "c");
+  group.skip(100);
+  ASSERT_EQ(group.type(), TT::FILE_END);
+  ASSERT_EQ(group.trace().getOffset(), tokens[7].trace.getOffset());
+}
+
+TEST_F(LexerTest, Chunks) {
+  std::string code = "#! hashbang\n";
+  for (int i = 0; i < 30; i++) {
+    code +=
+      "define a = f(b,\n  c) - 1\n"
+      "a\n++ - b\n"
+      "f(x)\n++\n-(y)\n"
+      "\"multi\nline \\\" string\"\n"
+      "/* multi\nline\n comment */ [x\n]\n"
+      "g\n(h)\n"
+      "   \t\n\n// comment\n";
+  }
+  auto expected = getTokens(code);
+  const auto& expectedStore = lx->getTokenStore();
+  for (unsigned chunkCount = 1; chunkCount <= 64; chunkCount++) {
+    auto chunkLexer = Lexer::tokenize(code, "<lexer-test>", chunkCount);
+    auto tokens = chunkLexer->getTokens();
+    ASSERT_EQ(tokens, expected);
+    for (std::size_t i = 0; i < tokens.size(); i++) {
+      ASSERT_EQ(tokens[i].trace.getOffset(), expected[i].trace.getOffset());
+      ASSERT_EQ(tokens[i].trace.getLength(), expected[i].trace.getLength());
+      if (tokens[i].type == TT::PAREN_LEFT || tokens[i].type == TT::CALL_BEGIN) {
+        ASSERT_EQ(chunkLexer->getTokenStore().matchingParen(i), expectedStore.matchingParen(i));
+      }
+    }
+  }
+  // Errors must be the same as the ones without chunks, even if there are several
+  for (std::string bad : {"(\n\n\n\n\n\n)\n]", "a\n\n\n\n\n\n]\n\"unclosed", "a\n\n\n\n)\n\n\n/*", "(\n\n\n\n1a"}) {
+    std::string expectedError;
+    try {
+      getTokens(bad);
+    } catch (const Error& err) {
+      expectedError = err.what();
+    }
+    ASSERT_NE(expectedError, "");
+    for (unsigned chunkCount = 2; chunkCount <= 8; chunkCount++) {
+      try {
+        Lexer::tokenize(bad, "<lexer-test>", chunkCount);
+        FAIL();
+      } catch (const Error& err) {
+        ASSERT_EQ(err.what(), expectedError);
+      }
+    }
+  }
+}
@@ -1,10 +1,13 @@
+#include <thread>
 #include <sstream>
 #include <gtest/gtest.h>
 #include <rapidxml_utils.hpp>
 
 #include "test.hpp"
+#include "lexer.hpp"
 #include "llvm/compiler.hpp"
 #include "llvm/runner.hpp"
+#include "parser/tokenParser.hpp"
 #include "parser/xmlParser.hpp"
 
 class LLVMCompilerTest: public ::testing::Test, public ExternalProcessCompiler {
@@ -33,6 +36,15 @@ protected:
       mc->getModule()->print(llvm::outs(), nullptr);
     }
   }
+
+  /// Lex, parse and compile some code as the root module
+  inline ModuleCompiler::Link compileCode(std::string code) {
+    auto ast = TokenParser::parse(Lexer::tokenize(code, "<llvm-test>")->getTokenStore());
+    auto mc = ModuleCompiler::create({}, "<llvm-test>", ast, true);
+    mc->compile();
+    if (printIr) mc->getModule()->print(llvm::outs(), nullptr);
+    return mc;
+  }
 };
 
 TEST_F(LLVMCompilerTest, Loops) {
@@ -85,3 +97,266 @@ TEST_F(LLVMCompilerTest, UserTypes) {
   noThrowOnCompile("data/llvm/types/simple_type.xml");
   noThrowOnCompile("data/llvm/types/static_method.xml");
 }
+
+TEST_F(LLVMCompilerTest, DeepNesting) {
+  // Machine-generated code can nest much deeper than the call stack would allow
+  constexpr std::size_t depth = 1000000;
+  std::string code = "Integer x = 1;\nx = x";
+  for (std::size_t i = 0; i < depth; i++) code += " + x";
+  code += ";\nif x == 0 do\n";
+  for (std::size_t i = 0; i < depth; i++) code += "else if x == 1 do\n";
+  code += "else do\nend\n";
+  EXPECT_NO_THROW(compileCode(code));
+}
+
+TEST_F(LLVMCompilerTest, StreamedStatements) {
+  auto compileStreamed = [](std::string code) {
+    auto mc = ModuleCompiler::create({}, "<llvm-test>", AST(Node<BlockNode>::make(ROOT_BLOCK)), true);
+    auto lexer = Lexer::open(code, "<llvm-test>");
+    TokenParser::parseStatements(*lexer, [&mc](ASTNode::Link statement) {
+      mc->compileStatement(statement);
+    });
+    mc->finish();
+  };
+  EXPECT_NO_THROW(compileStreamed("Integer a = 1;\nInteger b = a + 1;\n"));
+  // Main still gets its block and its return when there is nothing to compile
+  EXPECT_NO_THROW(compileStreamed(""));
+  EXPECT_NO_THROW(compileStreamed("/* only a comment */\n"));
+}
+
+TEST_F(LLVMCompilerTest, NameResolution) {
+  // Arguments shadow variables, and functions can call themselves
+  EXPECT_NO_THROW(compileCode(
+    "Integer x = 1;\n"
+    "function f [Integer x] => Integer do\n  return f(x);\nend\n"
+  ));
+  // Declarations are only visible after them, in their own block
+  EXPECT_THROW(compileCode("Integer x = y;\nInteger y = 1;\n"), Error);
+  EXPECT_THROW(compileCode("function f do\n  Integer y = 1;\nend\nInteger z = y;\n"), Error);
+}
+
+TEST_F(LLVMCompilerTest, TypeLists) {
+  ModuleCompiler::Link mc;
+  ASSERT_NO_THROW(mc = compileCode("Integer, Float a = 1;\nFloat, Integer b = 2;\n"));
+  // Both declarations share one list
+  std::size_t lists = 0;
+  for (auto type : *mc->getTypeSetPtr()) {
+    if (type->storedTypeCount() > 1) lists++;
+  }
+  EXPECT_EQ(lists, 1u);
+}
+
+TEST_F(LLVMCompilerTest, TypeCompat) {
+  auto a = TypeId::createBasic("A", nullptr);
+  auto b = TypeId::createBasic("B", nullptr);
+  auto c = TypeId::createBasic("C", nullptr);
+  TypeListTable lists;
+  auto ab = lists.get({a, b}, nullptr);
+  auto bc = lists.get({b, c}, nullptr);
+  EXPECT_EQ(a->isCompat(a), COMPATIBLE);
+  EXPECT_EQ(a->isCompat(b), INCOMPATIBLE);
+  EXPECT_EQ(a->isCompat(ab), DYNAMIC);
+  EXPECT_EQ(c->isCompat(ab), INCOMPATIBLE);
+  EXPECT_EQ(ab->isCompat(b), COMPATIBLE);
+  EXPECT_EQ(ab->isCompat(c), INCOMPATIBLE);
+  EXPECT_EQ(ab->isCompat(bc), DYNAMIC);
+  EXPECT_EQ(ab->isCompat(lists.get({c, TypeId::createBasic("D", nullptr)}, nullptr)), INCOMPATIBLE);
+  // Types past the first word of the mask work the same
+  std::vector<AbstractId::Link> many;
+  for (int i = 0; i < 100; i++) many.push_back(TypeId::createBasic("T" + std::to_string(i), nullptr));
+  auto manyList = lists.get(many, nullptr);
+  EXPECT_GT(manyList->getMask().wordCount(), 1u);
+  EXPECT_EQ(manyList->isCompat(many.back()), COMPATIBLE);
+  EXPECT_EQ(manyList->isCompat(a), INCOMPATIBLE);
+  EXPECT_EQ(manyList->isCompat(lists.get({a, many.back()}, nullptr)), DYNAMIC);
+}
+
+TEST_F(LLVMCompilerTest, TypeIds) {
+  // Ids only depend on the name, even for types made on other threads
+  auto id = TypeId::createBasic("Integer", nullptr);
+  UniqueIdentifier threadId = 0;
+  std::thread([&threadId]() {
+    threadId = TypeId::createBasic("Integer", nullptr)->getId();
+  }).join();
+  EXPECT_EQ(threadId, id->getId());
+  EXPECT_EQ(TypeId::createBasic("Integer", nullptr)->getMask(), id->getMask());
+  EXPECT_NE(TypeId::createBasic("Float", nullptr)->getId(), id->getId());
+}
+
+TEST_F(LLVMCompilerTest, TypeNarrowing) {
+  // The union holds what was last assigned to it
+  auto stats = compileCode(
+    "function f => Integer do\n  Integer, Float a = 1;\n  return a;\nend\n")->getTypeCheckStats();
+  EXPECT_EQ(stats.removed, 1u);
+  EXPECT_EQ(stats.dynamic, 0u);
+  // Both paths through the branch assign an Integer
+  stats = compileCode(
+    "function f => Integer do\n  Integer, Float a = 1.0;\n"
+    "  if true do\n    a = 1;\n  else do\n    a = 2;\n  end\n  return a;\nend\n")->getTypeCheckStats();
+  EXPECT_EQ(stats.removed, 1u);
+  EXPECT_EQ(stats.dynamic, 0u);
+  // Only one of them does
+  stats = compileCode(
+    "function f => Integer do\n  Integer, Float a = 1.0;\n"
+    "  if true do\n    a = 1;\n  else do\n  end\n  return a;\nend\n")->getTypeCheckStats();
+  EXPECT_EQ(stats.removed, 0u);
+  EXPECT_EQ(stats.dynamic, 1u);
+  // The loop might have assigned a Float before getting here
+  stats = compileCode(
+    "function f => Integer do\n  Integer, Float a = 1;\n"
+    "  for Integer i = 0; i < 3; ++i do\n    a = 2.0;\n  end\n  return a;\nend\n")->getTypeCheckStats();
+  EXPECT_EQ(stats.removed, 0u);
+  EXPECT_EQ(stats.dynamic, 1u);
+}
+
+TEST_F(LLVMCompilerTest, UnionLayout) {
+  ModuleCompiler::Link mc;
+  ASSERT_NO_THROW(mc = compileCode("Integer, Float, Boolean a = 1;\na = 2.0;\na = true;\n"));
+  auto module = mc->getModule();
+  llvm::DataLayout layout(module);
+  EXPECT_EQ(layout.getTypeAllocSize(module->getTypeByName("tagged_union")), 16u);
+  // Primitives are stored in the union itself, not on the heap
+  EXPECT_TRUE(module->getFunction("malloc")->use_empty());
+}
+
+TEST_F(LLVMCompilerTest, InlineTypeChecks) {
+  ModuleCompiler::Link mc;
+  ASSERT_NO_THROW(mc = compileCode(
+    "function f => Integer do\n  Integer, Float a = 1;\n"
+    "  for Integer i = 0; i < 3; ++i do\n    a = 2.0;\n  end\n  return a;\nend\n"));
+  auto typeErr = mc->getModule()->getFunction("_xyl_typeErr");
+  EXPECT_TRUE(typeErr->doesNotReturn());
+  EXPECT_TRUE(typeErr->hasFnAttribute(llvm::Attribute::Cold));
+  // The tag is tested inline, the runtime is only called if that fails
+  std::size_t calls = 0;
+  for (auto& block : *mc->getModule()->getFunction("f")) {
+    for (auto& inst : block) {
+      auto call = llvm::dyn_cast<llvm::CallInst>(&inst);
+      if (call == nullptr) continue;
+      EXPECT_EQ(call->getCalledFunction(), typeErr);
+      EXPECT_TRUE(llvm::isa<llvm::UnreachableInst>(call->getNextNode()));
+      calls++;
+    }
+  }
+  EXPECT_EQ(calls, 1u);
+}
+
+TEST_F(LLVMCompilerTest, TypeTable) {
+  ModuleCompiler::Link mc;
+  ASSERT_NO_THROW(mc = compileCode("Integer, Float, Boolean a = 1;\na = 2.0;\n"));
+  auto table = mc->getModule()->getGlobalVariable("_xyl_types", true);
+  ASSERT_NE(table, nullptr);
+  auto entries = llvm::cast<llvm::ConstantArray>(table->getInitializer());
+  // Only the stored types have entries, and their tags follow the order of their ids
+  EXPECT_EQ(entries->getNumOperands(), 2u);
+  auto integerId = TypeId::createBasic("Integer", nullptr)->getId();
+  auto floatId = TypeId::createBasic("Float", nullptr)->getId();
+  auto integerTag = integerId < floatId ? 0 : 1;
+  auto integerEntry = entries->getAggregateElement(integerTag);
+  auto name = llvm::cast<llvm::GlobalVariable>(integerEntry->getOperand(0)->stripPointerCasts());
+  EXPECT_EQ(llvm::cast<llvm::ConstantDataArray>(name->getInitializer())->getAsCString(), "Integer");
+  EXPECT_EQ(llvm::cast<llvm::ConstantInt>(integerEntry->getOperand(1))->getZExtValue(), 8u);
+  // No placeholders are left for the tags
+  EXPECT_EQ(mc->getModule()->getGlobalVariable("_xyl_tag_Integer", true), nullptr);
+  EXPECT_EQ(mc->getModule()->getFunction("_xyl_allowsTag"), nullptr);
+  // The runtime finds names in the table it was given
+  _xyl_TypeInfo types[] = {{nullptr, 0, 0}, {"Integer", 8, 8}};
+  _xyl_registerTypes(types, 2);
+  _xyl_Value value {1, 0};
+  EXPECT_STREQ(_xyl_typeOf(&value), "Integer");
+  value.currentType = 5;
+  EXPECT_STREQ(_xyl_typeOf(&value), "<unknown type>");
+  _xyl_registerTypes(nullptr, 0);
+}
+
+TEST_F(LLVMCompilerTest, TypeLayout) {
+  ModuleCompiler::Link mc;
+  ASSERT_NO_THROW(mc = compileCode(
+    "type T do\n  Boolean a = true;\n  Integer b = 1;\n  Boolean c = false;\n  Integer d = 2;\n"
+    "  cold Integer e = 3;\n  public constructor do\n    e = b + d;\n  end\nend\n"));
+  auto module = mc->getModule();
+  llvm::DataLayout layout(module);
+  // The booleans are packed together after the integers and the pointer to the cold members
+  EXPECT_EQ(layout.getTypeAllocSize(module->getTypeByName("T")), 32u);
+  auto cold = module->getTypeByName("T_cold");
+  ASSERT_NE(cold, nullptr);
+  EXPECT_EQ(layout.getTypeAllocSize(cold), 8u);
+  // A cold member can't be static
+  EXPECT_THROW(TokenParser::parse(Lexer::tokenize(
+    "type U do\n  static cold Integer a = 1;\nend\n", "<llvm-test>")->getTokenStore()), Error);
+}
+
+TEST_F(LLVMCompilerTest, ColdMemberStorage) {
+  using Counts = std::pair<std::size_t, std::size_t>;
+  // How many cold storage structs main allocates on the stack, and how many times it calls malloc
+  auto countStorage = [](ModuleCompiler::Link mc) {
+    auto cold = mc->getModule()->getTypeByName("T_coldStorage");
+    Counts allocasAndMallocs {0, 0};
+    for (auto& block : *mc->getModule()->getFunction("main")) {
+      for (auto& inst : block) {
+        auto alloca = llvm::dyn_cast<llvm::AllocaInst>(&inst);
+        if (alloca != nullptr && alloca->getAllocatedType() == cold) allocasAndMallocs.first++;
+        auto call = llvm::dyn_cast<llvm::CallInst>(&inst);
+        auto callee = call == nullptr ? nullptr : call->getCalledFunction();
+        if (callee != nullptr && callee->getName() == "malloc") allocasAndMallocs.second++;
+      }
+    }
+    return allocasAndMallocs;
+  };
+  std::string type = "type T do\n  Integer a = 1;\n  cold Integer b = 2;\nend\n";
+  ModuleCompiler::Link mc;
+  // An object declared in a loop reuses its cold members, like it reuses its own stack slot
+  ASSERT_NO_THROW(mc = compileCode(type + "for Integer i = 0; i < 10; i++ do\n  T t;\nend\n"));
+  EXPECT_EQ(countStorage(mc), Counts(1, 0));
+  // Copies get cold members of their own, and assigning to an object keeps the ones it has
+  ASSERT_NO_THROW(mc = compileCode(type + "T t;\nT copy = t;\nT other;\nother = copy;\n"));
+  EXPECT_EQ(countStorage(mc), Counts(3, 0));
+  // A union that stays in its function keeps the copy's cold members on the stack as well
+  ASSERT_NO_THROW(mc = compileCode(type + "T t;\nT, Integer u = t;\n"));
+  EXPECT_EQ(countStorage(mc), Counts(2, 0));
+}
+
+TEST_F(LLVMCompilerTest, Devirtualization) {
+  using Counts = std::pair<std::size_t, std::size_t>;
+  auto countCalls = [](llvm::Function* fun) {
+    Counts directAndIndirect {0, 0};
+    for (auto& block : *fun) {
+      for (auto& inst : block) {
+        auto call = llvm::dyn_cast<llvm::CallInst>(&inst);
+        if (call == nullptr) continue;
+        if (call->getCalledFunction() == nullptr) directAndIndirect.second++;
+        else directAndIndirect.first++;
+      }
+    }
+    return directAndIndirect;
+  };
+  std::string base =
+    "type A do\n"
+    "  public method get => Integer do\n    return 1;\n  end\n"
+    "  public method twice => Integer do\n    return this.get() * 2;\n  end\n"
+    "end\n";
+  // No type overrides get, so 'this' calls it directly
+  ModuleCompiler::Link mc;
+  ASSERT_NO_THROW(mc = compileCode(base + "A a;\nInteger x = a.twice();\n"));
+  EXPECT_EQ(countCalls(mc->getModule()->getFunction("method_A_twice")), Counts(1, 0));
+  // B overrides it, so it goes through the vtable
+  ASSERT_NO_THROW(mc = compileCode(base +
+    "type B inherits from A do\n  public method get => Integer do\n    return 2;\n  end\nend\n"
+    "B b;\nInteger x = b.twice();\n"));
+  EXPECT_EQ(countCalls(mc->getModule()->getFunction("method_A_twice")), Counts(0, 1));
+  ASSERT_NE(mc->getModule()->getGlobalVariable("vtable_B", true), nullptr);
+  // A variable holds exactly its type, so calls on it are direct
+  auto main = mc->getModule()->getFunction("main");
+  EXPECT_EQ(countCalls(main).second, 0u);
+  // Parameters might be of a subtype, so calls on them stay virtual like the ones on 'this'
+  ASSERT_NO_THROW(mc = compileCode(
+    "type A do\n"
+    "  public method get => Integer do\n    return 1;\n  end\n"
+    "  public method getFrom [A other] => Integer do\n    return other.get();\n  end\n"
+    "end\n"
+    "type B inherits from A do\n  public method get => Integer do\n    return 2;\n  end\nend\n"));
+  EXPECT_EQ(countCalls(mc->getModule()->getFunction("method_A_getFrom")), Counts(0, 1));
+  // Overrides must be callable like the method they override
+  EXPECT_THROW(compileCode(base +
+    "type C inherits from A do\n  public method get => Float do\n    return 2.0;\n  end\nend\n"), Error);
+}
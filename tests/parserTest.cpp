@@ -132,3 +132,84 @@ TEST_F(ParserCompareTest, Type) {
     end
   )code", "data/parser/type_complete.xml");
 }
+
+TEST_F(ParserTest, Statements) {
+  // Big enough to need several calls to Lexer::lexMore
+  std::string code;
+  for (int i = 0; i < 2000; i++) {
+    code +=
+      "define a = 0x1F - f(b,\n  c);\n"
+      "/* multi\nline comment */ Integer i = 2;\n"
+      "function g [Integer x] => Integer do\n  return x * 2.5;\nend\n"
+      "\"string\\twith escapes\";\n"
+      "for define x = 1; x < 6; ++x, --x do\n  (x + 1) * -x;\nend\n";
+  }
+  auto wholeLexer = Lexer::tokenize(code, "<parser-test>");
+  auto expected = TokenParser::parse(wholeLexer->getTokenStore());
+  auto expectedStatements = expected.getRoot()->getChildren();
+  auto lexer = Lexer::open(code, "<parser-test>");
+  std::size_t statementCount = 0;
+  std::size_t maxTokens = 0;
+  TokenParser::parseStatements(*lexer, [&](ASTNode::Link statement) {
+    ASSERT_LT(statementCount, expectedStatements.size());
+    EXPECT_EQ(*statement, *expectedStatements[statementCount]);
+    statementCount++;
+    maxTokens = std::max(maxTokens, lexer->getTokenStore().size());
+  });
+  EXPECT_EQ(statementCount, expectedStatements.size());
+  // Tokens are dropped after being parsed, so they are never all kept at once
+  EXPECT_LT(maxTokens, wholeLexer->getTokenStore().size() / 2);
+  EXPECT_THROW(TokenParser::parseStatements(*Lexer::open("a;\nb = (c;", "<parser-test>"),
+    [](ASTNode::Link) {}), Error);
+  // Input without statements never calls back
+  for (std::string empty : {"", "/* only a comment */\n"}) {
+    TokenParser::parseStatements(*Lexer::open(empty, "<parser-test>"), [](ASTNode::Link) {
+      ADD_FAILURE() << "Unexpected statement";
+    });
+  }
+}
+
+TEST_F(ParserTest, DeepNesting) {
+  // Machine-generated code can nest much deeper than the call stack would allow
+  constexpr std::size_t depth = 1000000;
+  const auto parseCode = [](const std::string& code) {
+    return TokenParser::parse(Lexer::tokenize(code, "<parser-test>")->getTokenStore());
+  };
+  const auto repeat = [](const std::string& str, std::size_t times) {
+    std::string result;
+    result.reserve(str.length() * times);
+    for (std::size_t i = 0; i < times; i++) result += str;
+    return result;
+  };
+  const auto nestingOf = [](ASTNode::Link node, std::function<ASTNode::Link(ASTNode::Link)> inner) {
+    std::size_t nesting = 0;
+    for (; node != nullptr; node = inner(node)) nesting++;
+    return nesting;
+  };
+  const auto leftOperand = [](ASTNode::Link node) -> ASTNode::Link {
+    return node->getChildren().empty() ? nullptr : node->getChildren()[0];
+  };
+  
+  auto chain = parseCode("if a do\n" + repeat("else if a do\n", depth) + "else do\nend\n");
+  EXPECT_EQ(nestingOf(chain.getRoot()->getChildren()[0], [](ASTNode::Link node) -> ASTNode::Link {
+    auto failiure = Node<BranchNode>::staticPtrCast(node)->failiure();
+    if (!mpark::holds_alternative<Node<BranchNode>::Link>(failiure)) return nullptr;
+    return mpark::get<Node<BranchNode>::Link>(failiure);
+  }), depth + 1);
+  
+  auto parens = parseCode(repeat("(", depth) + "1" + repeat(")", depth) + ";");
+  EXPECT_EQ(Node<ExpressionNode>::staticPtrCast(parens.getRoot()->getChildren()[0])->getToken().intValue, 1);
+  
+  auto sum = parseCode("1" + repeat(" + 1", depth) + ";");
+  EXPECT_EQ(nestingOf(sum.getRoot()->getChildren()[0], leftOperand), depth + 1);
+  
+  auto prefixes = parseCode(repeat("- ", depth) + "1;");
+  EXPECT_EQ(nestingOf(prefixes.getRoot()->getChildren()[0], leftOperand), depth + 1);
+  
+  auto calls = parseCode(repeat("f(", depth) + "1" + repeat(")", depth) + ";");
+  EXPECT_EQ(nestingOf(calls.getRoot()->getChildren()[0], [](ASTNode::Link node) -> ASTNode::Link {
+    if (node->getChildren().empty()) return nullptr;
+    // The argument of the call
+    return node->getChildren()[0]->getChildren()[0];
+  }), depth + 1);
+}
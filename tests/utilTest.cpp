@@ -1,8 +1,13 @@
 #include <vector>
 #include <string>
+#include <random>
+#include <cstdlib>
+#include <stdexcept>
 #include <gtest/gtest.h>
 
 #include "utils/util.hpp"
+#include "utils/charScan.hpp"
+#include "utils/numbers.hpp"
 
 class TestObj {
 private:
@@ -61,3 +66,90 @@ TEST(UtilTest, ObjBind) {
   auto bound = objBind(&TestObj::getInt, obj);
   EXPECT_EQ(bound(), 67);
 }
+
+TEST(UtilTest, CharScan) {
+  std::vector<CharSet> sets {
+    CharSet("\n"),
+    CharSet(" \t\n\v\f\r"),
+    // Too many distinct high nibbles for the shuffle tables
+    CharSet("\x01\x12#4EVgx\x89\x9A\xAB\xBC\xCD\xDE\xEF\xF0")
+  };
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<int> byteDist(0, 255);
+  std::string buffer(200, '\0');
+  auto defaultImpl = CharSet::getImplementation();
+  for (int round = 0; round < 200; ++round) {
+    // Make some rounds mostly members, so long runs get scanned
+    for (char& c : buffer) {
+      c = round % 2 ? static_cast<char>(byteDist(rng)) : ' ';
+    }
+    buffer[static_cast<std::size_t>(byteDist(rng)) % buffer.size()] = 'a';
+    auto begin = buffer.data() + byteDist(rng) % 40;
+    auto end = begin + byteDist(rng) % (buffer.data() + buffer.size() - begin);
+    for (const auto& set : sets) {
+      CharSet::setImplementation(CharSet::SCALAR);
+      auto in = set.findFirstIn(begin, end);
+      auto notIn = set.findFirstNotIn(begin, end);
+      for (auto impl : {CharSet::SSE2, CharSet::AVX2}) {
+        if (!CharSet::isSupported(impl)) continue;
+        CharSet::setImplementation(impl);
+        ASSERT_EQ(set.findFirstIn(begin, end), in);
+        ASSERT_EQ(set.findFirstNotIn(begin, end), notIn);
+      }
+    }
+  }
+  CharSet::setImplementation(defaultImpl);
+}
+
+TEST(UtilTest, ParseInteger) {
+  auto parse = [](std::string digits, unsigned radix) {
+    int64_t value = -1;
+    if (!parseInteger(digits.data(), digits.data() + digits.length(), radix, value)) {
+      throw std::invalid_argument(digits);
+    }
+    return value;
+  };
+  EXPECT_EQ(parse("0", 10), 0);
+  EXPECT_EQ(parse("123", 10), 123);
+  EXPECT_EQ(parse("fF", 16), 255);
+  EXPECT_EQ(parse("17", 8), 15);
+  EXPECT_EQ(parse("101", 2), 5);
+  EXPECT_EQ(parse("9223372036854775807", 10), INT64_MAX);
+  EXPECT_THROW(parse("9223372036854775808", 10), std::invalid_argument);
+  EXPECT_THROW(parse("10000000000000000", 16), std::invalid_argument);
+  EXPECT_THROW(parse("2", 2), std::invalid_argument);
+  EXPECT_THROW(parse("", 10), std::invalid_argument);
+}
+
+TEST(UtilTest, ParseFloat) {
+  std::mt19937_64 rng(1234);
+  for (int round = 0; round < 10000; ++round) {
+    // Vary the length so both the exact path and the fallback get used
+    auto digits = std::to_string(rng() >> (round % 64));
+    auto point = rng() % digits.length();
+    std::string number = digits.substr(0, point) + "." + digits.substr(point);
+    if (point == 0) number = "0" + number;
+    double value;
+    ASSERT_TRUE(parseFloat(number.data(), number.data() + number.length(), value));
+    ASSERT_EQ(value, std::strtod(number.c_str(), nullptr)) << number;
+  }
+  double value;
+  std::string bad = "1.2.3";
+  EXPECT_FALSE(parseFloat(bad.data(), bad.data() + bad.length(), value));
+}
+
+TEST(UtilTest, Symbols) {
+  Symbol a = "Integer";
+  EXPECT_EQ(a, Symbol(std::string("Integer")));
+  EXPECT_NE(a, Symbol("Float"));
+  EXPECT_EQ(a.str(), "Integer");
+  EXPECT_TRUE(Symbol().empty());
+  EXPECT_EQ(Symbol(""), Symbol());
+  // Sets don't depend on insertion order, and have no duplicates
+  SymbolSet set1 {"Integer", "Float", "Integer"};
+  SymbolSet set2 {"Float", "Integer"};
+  EXPECT_EQ(set1.size(), 2u);
+  EXPECT_EQ(set1, set2);
+  EXPECT_TRUE(set1.contains("Float"));
+  EXPECT_FALSE(set1.contains("Boolean"));
+}